@@ -0,0 +1,56 @@
+/* generate.cpp - generator of large Ramsey programs for the benchmarks
+
+   usage: bench-generate program N > FILE.ram
+
+   'program' writes N functions of loops, branches, calls and every type and
+   operator; each function is about 137 tokens, so N=7300 gives a program of
+   1,000,099 tokens (3.2 MB). The output depends only on N. */
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+namespace
+{
+    void generate_program(ostream& out,int n)
+    {
+        for (int i = 0;i < n;++i) {
+            if (i > 0)
+                out << '\n';
+            out << "# generated function " << i << "\n"
+                "fun f" << i << "(in a, in b, boo c) as in\n"
+                "    in x <- a + b * 2 - (a mod 7)\n"
+                "    in y <- 0\n"
+                "    small s <- 3\n"
+                "    big bg <- 100000\n"
+                "    while (y < 10 and not c)\n"
+                "        if (x > y or a = b)\n"
+                "            x <- x - 1\n"
+                "        elf (x = y)\n"
+                "            smash\n"
+                "        else\n"
+                "            y <- y + s\n"
+                "        endif\n"
+                "        y <- y + 1\n"
+                "    endwhile\n"
+                "    if (c)\n"
+                "        toss f" << (i > 0 ? i-1 : 0) << "(x, y, false) + bg / 3\n"
+                "    endif\n"
+                "    toss x * y + a / (b + 1)\n"
+                "endfun\n";
+        }
+    }
+}
+
+int main(int argc,const char* argv[])
+{
+    char* end = NULL;
+    long n = argc == 3 ? strtol(argv[2],&end,10) : -1;
+    if (argc!=3 || *argv[2]=='\0' || *end!='\0' || n<0 || n>10000000 || strcmp(argv[1],"program")!=0) {
+        cerr << "usage: " << argv[0] << " program N\n";
+        return 1;
+    }
+    ios::sync_with_stdio(false);
+    generate_program(cout,int(n));
+    return cout ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+/* keywords.cpp - micro-benchmark of keyword/identifier classification
+
+   usage: bench-keywords FILE.ram [REPS]
+
+   Every identifier-like word of FILE is classified by lexer::keyword_kind
+   (the perfect hash) and by a walk of the keyword list as the lexer once did
+   it; the best time of REPS runs of each is reported, and the benchmark
+   fails if the two disagree on any word. */
+#include "lexer.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+using namespace ramsey;
+
+namespace
+{
+    struct word
+    {
+        const char* s;
+        int length;
+    };
+
+    // the classification that the perfect hash replaced
+    token_t keyword_kind_linear(const char* s,int length)
+    {
+        struct keyword
+        {
+            const char* spelling;
+            token_t kind;
+        };
+        static const keyword KEYWORDS[] = {
+            {"in", token_in}, {"big", token_big}, {"small", token_small}, {"boo", token_boo},
+            {"if", token_if}, {"elf", token_elf}, {"else", token_else}, {"endif", token_endif},
+            {"while", token_while}, {"smash", token_smash}, {"endwhile", token_endwhile},
+            {"fun", token_fun}, {"as", token_as}, {"endfun", token_endfun}, {"toss", token_toss},
+            {"mod", token_mod}, {"or", token_or}, {"and", token_and}, {"not", token_not},
+            {"true", token_bool_true}, {"false", token_bool_false}
+        };
+        for (size_t i = 0;i < sizeof(KEYWORDS)/sizeof(KEYWORDS[0]);++i)
+            if (strncmp(s,KEYWORDS[i].spelling,length)==0 && KEYWORDS[i].spelling[length]==0)
+                return KEYWORDS[i].kind;
+        return token_id;
+    }
+
+    bool is_word_char(char c,bool first)
+    {
+        return (c>='a' && c<='z') || (c>='A' && c<='Z') || c=='_' || (!first && c>='0' && c<='9');
+    }
+
+    // time one pass of 'classify' over the words (the sum of the kinds keeps the calls live)
+    template<typename function>
+    double time_pass(const vector<word>& words,function classify,long& sum)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t i = 0;i < words.size();++i)
+            sum += classify(words[i].s,words[i].length);
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc,const char* argv[])
+{
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " FILE.ram [REPS]\n";
+        return 1;
+    }
+    int reps = argc > 2 ? atoi(argv[2]) : 5;
+    ifstream file(argv[1],ios::in|ios::binary);
+    if (!file) {
+        cerr << argv[0] << ": cannot open '" << argv[1] << "'\n";
+        return 1;
+    }
+    string text((istreambuf_iterator<char>(file)),istreambuf_iterator<char>());
+
+    // collect the words as the scanner delimits identifiers (comments and strings are not skipped)
+    vector<word> words;
+    for (size_t i = 0;i < text.size();) {
+        if ( !is_word_char(text[i],true) ) {
+            ++i;
+            continue;
+        }
+        size_t j = i;
+        while (j<text.size() && is_word_char(text[j],false))
+            ++j;
+        word w = { text.data()+i, int(j-i) };
+        words.push_back(w);
+        i = j;
+    }
+    if ( words.empty() ) {
+        cerr << argv[0] << ": no identifiers in '" << argv[1] << "'\n";
+        return 1;
+    }
+
+    size_t keywords = 0;
+    for (size_t i = 0;i < words.size();++i) {
+        token_t kind = lexer::keyword_kind(words[i].s,words[i].length);
+        if (kind != keyword_kind_linear(words[i].s,words[i].length)) {
+            cerr << argv[0] << ": classifications differ for '" << string(words[i].s,words[i].length) << "'\n";
+            return 1;
+        }
+        keywords += kind != token_id;
+    }
+
+    long sum = 0;
+    double linear = 1e9, hashed = 1e9;
+    for (int r = 0;r < reps;++r) {
+        linear = min(linear,time_pass(words,keyword_kind_linear,sum));
+        hashed = min(hashed,time_pass(words,lexer::keyword_kind,sum));
+    }
+    cout << words.size() << " words (" << keywords << " keywords), best of " << reps << ":\n"
+         << "  keyword list  " << words.size()/linear/1e6 << " M words/s\n"
+         << "  perfect hash  " << words.size()/hashed/1e6 << " M words/s\n";
+    return sum == -1; // (never)
+}
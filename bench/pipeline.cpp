@@ -0,0 +1,120 @@
+/* pipeline.cpp - full-pipeline benchmark of the node AST and the flat AST
+
+   usage: bench-pipeline FILE.ram [REPS]
+
+   FILE is compiled in memory REPS times (default 5) on each path, as the
+   driver compiles it by default (lexing on demand, one thread):
+       node AST: parse, semantics, codegen
+       flat AST: parse, lower, semantics, codegen (--flat-ast)
+   The code is generated into a string; the best time of each stage is
+   reported, and the benchmark fails if the paths' assembly differs. A large
+   input is made with 'bench-generate program N'. */
+#include "parser.h"
+#include "flatast.h"
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+using namespace std;
+using namespace ramsey;
+
+namespace
+{
+    typedef chrono::steady_clock bench_clock;
+
+    // keep the best time of a stage
+    struct stage
+    {
+        const char* name;
+        double best;
+    };
+
+    void record(stage& s,bench_clock::time_point& start)
+    {
+        bench_clock::time_point now = bench_clock::now();
+        double ms = chrono::duration<double,milli>(now - start).count();
+        if (ms < s.best)
+            s.best = ms;
+        start = now;
+    }
+
+    void report(const char* path,stage* stages,int count)
+    {
+        double total = 0;
+        cout << path << ':';
+        for (int i = 0;i < count;++i) {
+            cout << "  " << stages[i].name << ' ' << stages[i].best;
+            total += stages[i].best;
+        }
+        cout << "  (total " << total << " ms)\n";
+    }
+}
+
+int main(int argc,const char* argv[])
+{
+    if (argc<2 || argc>3) {
+        cerr << "usage: " << argv[0] << " FILE.ram [REPS]\n";
+        return 1;
+    }
+    int reps = argc > 2 ? atoi(argv[2]) : 5;
+    stage node[] = { {"parse",1e9}, {"semantics",1e9}, {"codegen",1e9} };
+    stage flat[] = { {"parse",1e9}, {"lower",1e9}, {"semantics",1e9}, {"codegen",1e9} };
+    string nodecode, flatcode;
+    try {
+        for (int r = 0;r < reps;++r) {
+            {
+                bench_clock::time_point start = bench_clock::now();
+                parser theParser(argv[1],NULL,true);
+                const ast_node* theAst = theParser.get_ast();
+                if (theAst == NULL) {
+                    cerr << argv[0] << ": '" << argv[1] << "' has no functions\n";
+                    return 1;
+                }
+                record(node[0],start);
+                stable theSymbolTable;
+                theSymbolTable.addScope();
+                theAst->check_semantics(theSymbolTable);
+                theSymbolTable.remScope();
+                record(node[1],start);
+                ostringstream code;
+                {
+                    code_generator theCodeGenerator(code);
+                    theAst->generate_code(theCodeGenerator);
+                }
+                record(node[2],start);
+                nodecode = code.str();
+            }
+            {
+                bench_clock::time_point start = bench_clock::now();
+                parser theParser(argv[1],NULL,true);
+                const ast_node* theAst = theParser.get_ast();
+                record(flat[0],start);
+                flat_ast theFlatAst(theAst);
+                record(flat[1],start);
+                stable theSymbolTable;
+                theSymbolTable.addScope();
+                theFlatAst.check_semantics(theSymbolTable);
+                theSymbolTable.remScope();
+                record(flat[2],start);
+                ostringstream code;
+                {
+                    code_generator theCodeGenerator(code);
+                    theFlatAst.generate_code(theCodeGenerator);
+                }
+                record(flat[3],start);
+                flatcode = code.str();
+            }
+        }
+    } catch (compiler_error_generic& err) {
+        cerr << argv[0] << ": " << err.what() << endl;
+        return 1;
+    }
+
+    cout << argv[1] << ": " << nodecode.size() << " bytes of assembly, best of " << reps << " (ms)\n";
+    report("node AST",node,3);
+    report("flat AST",flat,4);
+    if (nodecode != flatcode) {
+        cerr << argv[0] << ": the node and flat paths generated different code\n";
+        return 1;
+    }
+}
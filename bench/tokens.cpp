@@ -0,0 +1,48 @@
+/* tokens.cpp - memory held per token by the lexer's token stream
+
+   usage: bench-tokens FILE.ram
+
+   FILE is lexed whole (as the parser's parallel mode does) and the heap
+   held by the lexer afterwards is divided by the number of tokens; the
+   source mapping is not heap memory and is not counted. A 1M-token input is
+   made with 'bench-generate program 7300'. (The heap is measured with glibc's
+   mallinfo2.) */
+#include "lexer.h"
+#include <iostream>
+#include <chrono>
+#include <malloc.h>
+using namespace std;
+using namespace ramsey;
+
+namespace
+{
+    size_t heap_in_use()
+    {
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd; // (small blocks in use, and mapped blocks)
+    }
+}
+
+int main(int argc,const char* argv[])
+{
+    if (argc != 2) {
+        cerr << "usage: " << argv[0] << " FILE.ram\n";
+        return 1;
+    }
+    try {
+        size_t before = heap_in_use();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        lexer lex(argv[1]);
+        double ms = chrono::duration<double,milli>(chrono::steady_clock::now() - start).count();
+        size_t bytes = heap_in_use() - before;
+
+        long count = 0;
+        for (;!lex.endtok();++lex)
+            ++count;
+        cout << count << " tokens lexed in " << ms << " ms\n"
+             << bytes << " heap bytes held, " << (count > 0 ? double(bytes)/count : 0.0) << " bytes/token\n";
+    } catch (lexer_error& err) {
+        cerr << argv[0] << ": " << err.what() << endl;
+        return 1;
+    }
+}
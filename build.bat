@@ -7,13 +7,13 @@
 SET COMPILE_GNU=g++
 
 :: define common object files shared between configurations
-SET OBJECTS=src\lexer.cpp src\ast.cpp src\codegen.cpp src\gccbuild_win32.cpp src\parser.cpp src\ramsey-error.cpp src\semantics.cpp src\stable.cpp
+SET OBJECTS=src\lexer.cpp src\lexsimd.cpp src\srcmap_win32.cpp src\intern.cpp src\arena.cpp src\threadpool.cpp src\ast.cpp src\flatast.cpp src\codegen.cpp src\elfobj.cpp src\gccbuild_win32.cpp src\parser.cpp src\ramsey-error.cpp src\semantics.cpp src\stable.cpp src\bytecode.cpp src\interp.cpp
 
 :: define object files used for testing
 SET TEST_OBJECTS=src\test.cpp
 
 :: define object files used for main program
-SET MAIN_OBJECTS=src\ramsey.cpp
+SET MAIN_OBJECTS=src\ramsey.cpp src\jit_win32.cpp
 
 :: build test; link to a different main function for testing
 IF '%1'=='test' (
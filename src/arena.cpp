@@ -0,0 +1,43 @@
+/* arena.cpp */
+#include "arena.h"
+using namespace std;
+using namespace ramsey;
+
+arena::arena()
+    : _cur(NULL), _end(NULL)
+{
+}
+arena::~arena()
+{
+    clear();
+}
+void arena::adopt(arena& other)
+{
+    // allocation continues in this arena's current block
+    _blocks.insert(_blocks.end(),other._blocks.begin(),other._blocks.end());
+    other._blocks.clear();
+    other._cur = other._end = NULL;
+}
+void arena::clear()
+{
+    for (size_t i = 0;i < _blocks.size();++i)
+        delete[] _blocks[i];
+    _blocks.clear();
+    _cur = _end = NULL;
+}
+void* arena::_allocate_block(size_t size)
+{
+    // requests larger than a block get a block to themselves (leaving
+    // the current block in use for later requests)
+    if (size > BLOCK_SIZE/4) {
+        char* big = new char[size];
+        _blocks.push_back(big);
+        return big;
+    }
+    _cur = new char[BLOCK_SIZE];
+    _end = _cur + BLOCK_SIZE;
+    _blocks.push_back(_cur);
+    void* p = _cur;
+    _cur += size;
+    return p;
+}
@@ -0,0 +1,86 @@
+/* arena.h - CS355 Compiler Project */
+#ifndef ARENA_H
+#define ARENA_H
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace ramsey
+{
+    // a bump allocator: memory is carved sequentially out of large blocks
+    // and is released all at once when the arena is cleared or destroyed;
+    // objects placed in an arena never have their destructors run, so they
+    // must not own any memory outside of it
+    class arena
+    {
+    public:
+        arena();
+        ~arena();
+
+        void* allocate(std::size_t size)
+        {
+            size = (size + ALIGN-1) & ~(ALIGN-1);
+            if (size > std::size_t(_end - _cur))
+                return _allocate_block(size);
+            void* p = _cur;
+            _cur += size;
+            return p;
+        }
+        void adopt(arena& other); // take over the memory of 'other', which is left empty
+        void clear(); // release all of the memory (the objects placed in the arena are gone)
+    private:
+        // disallow copying
+        arena(const arena&);
+        arena& operator =(const arena&);
+
+        static const std::size_t ALIGN = alignof(std::max_align_t);
+        static const std::size_t BLOCK_SIZE = 64 * 1024;
+
+        char* _cur, *_end; // free space in the current block
+        std::vector<char*> _blocks;
+
+        void* _allocate_block(std::size_t size);
+    };
+
+    // a fixed-length array whose storage lives in an arena
+    template<typename T>
+    class arena_array
+    {
+    public:
+        arena_array()
+            : _data(NULL), _size(0) {}
+
+        void allocate(arena& a,std::size_t size) // elements are value-initialized
+        {
+            _data = static_cast<T*>(a.allocate(sizeof(T) * size));
+            for (std::size_t i = 0;i < size;++i)
+                new (_data + i) T();
+            _size = size;
+        }
+
+        std::size_t size() const
+        { return _size; }
+        T& operator [](std::size_t i)
+        { return _data[i]; }
+        const T& operator [](std::size_t i) const
+        { return _data[i]; }
+        T* begin()
+        { return _data; }
+        const T* begin() const
+        { return _data; }
+        T* end()
+        { return _data + _size; }
+        const T* end() const
+        { return _data + _size; }
+    private:
+        T* _data;
+        std::size_t _size;
+    };
+}
+
+// placement form used to construct objects in an arena
+inline void* operator new(std::size_t size,ramsey::arena& a)
+{ return a.allocate(size); }
+inline void operator delete(void*,ramsey::arena&) {} // only called if a constructor throws
+
+#endif
@@ -19,63 +19,95 @@ ast_exception::ast_exception(const char* format, ...)
     va_end(args);
 }
 
-// ast_builder
-void ast_builder::collapse(ast_builder& builder)
-{
-    /*_elems.swap(builder._elems);
-    while ( !builder._elems.empty() ) {
-        // maintain the correct ordering by popping off the front
-        _elems.push_back(builder._elems.front());
-        builder._elems.pop_front();
-        }*/
-    while ( !builder._elems.empty() ) {
-        _elems.push_back(builder._elems.front());
-        builder._elems.pop_front();
-    }
+// ast_element_stack
+ast_element_stack::ast_element_stack()
+{
+    // the frames of a typical parse never need more than this
+    _elems.reserve(64);
+    _linenos.reserve(64);
+    _frames.reserve(64);
+}
+void ast_element_stack::open_frame()
+{
+    frame f;
+    f.elembase = int(_elems.size());
+    f.linebase = int(_linenos.size());
+    _frames.push_back(f);
+}
+void ast_element_stack::adopt_frame()
+{
+    // the new frame's marker is placed on the last element of the current frame
+#ifdef RAMSEY_DEBUG
+    if ( is_empty() )
+        throw ast_exception("ast_element_stack::adopt_frame: current frame is empty");
+#endif
+    open_frame();
+    --_frames.back().elembase;
+}
+void ast_element_stack::close_frame()
+{
+    // elements left in the frame are already in order on top of the frame
+    // below, so dropping the marker hands them over; the frame's line numbers
+    // are dropped with it
+    _linenos.resize(_frames.back().linebase);
+    _frames.pop_back();
+}
+
+// ast_element_stack::ast_element
+ast_element_stack::ast_element::ast_element()
+    : pnode(NULL), flag(0)
+{
+}
+ast_element_stack::ast_element::ast_element(token t)
+    : tok(t), pnode(NULL), flag(ast_element_tok)
+{
 }
-const token* ast_builder::pop_token()
+ast_element_stack::ast_element::ast_element(ast_node* node)
+    : pnode(node), flag(ast_element_node)
+{
+}
+
+// ast_builder
+token ast_builder::pop_token()
 {
 #ifdef RAMSEY_DEBUG
-    if (_elems.size() == 0)
+    if (size() == 0)
         throw ast_exception("ast_builder::pop_token: stack is empty");
     if ( !is_next_token() )
         throw ast_exception("ast_builder::pop_token: top of stack was not a token");
 #endif
-    ast_element thing = _elems.back();
-    _elems.pop_back();
-    return thing.ptok;
+    token t = _stack._elems.back().tok;
+    _stack._elems.pop_back();
+    return t;
 }
 ast_node* ast_builder::pop_node()
 {
 #ifdef RAMSEY_DEBUG
-    if (_elems.size() == 0)
+    if (size() == 0)
         throw ast_exception("ast_builder::pop_node: stack is empty!");
     if ( !is_next_node() )
         throw ast_exception("ast_builder::pop_token: top of stack was not a node");
 #endif
-    ast_element thing = _elems.back();
-    _elems.pop_back();
-    return thing.pnode;
+    ast_node* n = _stack._elems.back().pnode;
+    _stack._elems.pop_back();
+    return n;
 }
 int ast_builder::get_line()
 {
-    int l = _linenos.top();
-    _linenos.pop();
+#ifdef RAMSEY_DEBUG
+    if (int(_stack._linenos.size()) == _stack._frames.back().linebase)
+        throw ast_exception("ast_builder::get_line: no line numbers in frame");
+#endif
+    int l = _stack._linenos.back();
+    _stack._linenos.pop_back();
     return l;
 }
 
-// ast_builder::ast_element
-ast_builder::ast_element::ast_element()
-    : pnode(NULL), flag(0)
-{
-}
-ast_builder::ast_element::ast_element(const token* tok)
-    : ptok(tok), flag(ast_element_tok)
-{
-}
-ast_builder::ast_element::ast_element(ast_node* node)
-    : pnode(node), flag(ast_element_node)
+// ast_pass_frame
+ast_pass_frame::ast_pass_frame(const ast_node* n)
+    : node(n), step(0), index(0), cursor(NULL), current(NULL), alloc(false), reg(NULL)
 {
+    labels[0] = labels[1] = labels[2] = 0;
 }
 
 // ast_node
@@ -106,22 +138,15 @@ void ast_node::output_at_level(ostream& stream,int level) const
 
 // ast_function_node, ast_function_builder
 ast_function_node::ast_function_node()
-    : _id(NULL), _param(NULL), _typespec(NULL), _statements(NULL)
+    : _param(NULL), _statements(NULL)
 {
 }
-ast_function_node::~ast_function_node()
-{
-    if (_param != NULL)
-        delete _param;
-    if (_statements != NULL)
-        delete _statements;
-}
 #ifdef RAMSEY_DEBUG
 void ast_function_node::output_impl(ostream& stream,int nlevel) const
 {
-    stream << "function:id=" << *_id << ",type=";
-    if (_typespec != NULL)
-        stream << *_typespec;
+    stream << "function:id=" << _id << ",type=";
+    if (_typespec.valid())
+        stream << _typespec;
     else
         stream << "[default in]";
     stream << '\n';
@@ -133,29 +158,6 @@ void ast_function_node::output_impl(ostream& stream,int nlevel) const
     }
 }
 #endif
-token_t* ast_function_node::get_argtypes_impl() const
-{
-    // create a dynamically allocated list of parameter types
-    int sz = 0, alloc = 5;
-    token_t* tlist = new token_t[alloc];
-    ast_parameter_node* pnode = _param;
-    while (true) {
-        if (sz >= alloc) { // reallocate
-            token_t* tnew = new token_t[alloc*=2];
-            for (int i = 0;i < sz;++i)
-                tnew[i] = tlist[i];
-            delete[] tlist;
-            tlist = tnew;
-        }
-        if (pnode == NULL) {
-            tlist[sz] = token_invalid; // terminate the list with token_invalid
-            break;
-        }
-        tlist[sz++] = pnode->_typespec->type();
-        pnode = pnode->get_next();
-    }
-    return tlist;
-}
 ast_function_node* ast_function_builder::build()
 {
 #ifdef RAMSEY_DEBUG
@@ -172,25 +174,46 @@ ast_function_node* ast_function_builder::build()
     }
     return node;
 }
+ast_function_node* ast_function_builder::join(ast_function_node* first,ast_function_node* second)
+{
+    // either list may be empty (NULL); returns the head of the joined list
+    if (first == NULL)
+        return second;
+    if (second != NULL) {
+        ast_function_node* tail = first;
+        while ( !tail->end() )
+            tail = tail->get_next();
+        second->append(tail);
+    }
+    return first;
+}
 ast_function_node* ast_function_builder::get_next()
 {
-    ast_function_node* node = new ast_function_node;
+    ast_function_node* node = new (get_arena()) ast_function_node;
     node->_statements = static_cast<ast_statement_node*>(pop_node());
     node->_typespec = pop_token();
     node->_param = static_cast<ast_parameter_node*>(pop_node());
     node->_id = pop_token();
+    // record the parameter types (for matching calls against)
+    size_t cnt = 0;
+    for (ast_parameter_node* p = node->_param;p != NULL;p = p->get_next())
+        ++cnt;
+    node->_argtypes.allocate(get_arena(),cnt+1);
+    cnt = 0;
+    for (ast_parameter_node* p = node->_param;p != NULL;p = p->get_next())
+        node->_argtypes[cnt++] = p->_typespec.type();
+    node->_argtypes[cnt] = token_invalid;
     return node;
 }
 
 // ast_parameter_node, ast_parameter_builder
 ast_parameter_node::ast_parameter_node()
-    : _typespec(NULL), _id(NULL)
 {
 }
 #ifdef RAMSEY_DEBUG
 void ast_parameter_node::output_impl(ostream& stream,int) const
 {
-    stream << "parameter:id=" << *_id << ",type=" << *_typespec << '\n';
+    stream << "parameter:id=" << _id << ",type=" << _typespec << '\n';
 }
 #endif
 ast_parameter_node* ast_parameter_builder::build()
@@ -209,7 +232,7 @@ ast_parameter_node* ast_parameter_builder::build()
 }
 ast_parameter_node* ast_parameter_builder::get_next()
 {
-    ast_parameter_node* node = new ast_parameter_node;
+    ast_parameter_node* node = new (get_arena()) ast_parameter_node;
     node->_id = pop_token();
     node->_typespec = pop_token();
     return node;
@@ -238,18 +261,13 @@ ast_statement_node* ast_statement_builder::build()
 
 // ast_declaration_statement_node, ast_declaration_statement_builder
 ast_declaration_statement_node::ast_declaration_statement_node()
-    : ast_statement_node(ast_declaration_statement), _typespec(NULL), _id(NULL), _initializer(NULL)
-{
-}
-ast_declaration_statement_node::~ast_declaration_statement_node()
+    : ast_statement_node(ast_declaration_statement), _initializer(NULL)
 {
-    if (_initializer != NULL)
-        delete _initializer;
 }
 #ifdef RAMSEY_DEBUG
 void ast_declaration_statement_node::output_impl(ostream& stream,int nlevel) const
 {
-    stream << "declaration-statement:id=" << *_id << ",type=" << *_typespec << '\n';
+    stream << "declaration-statement:id=" << _id << ",type=" << _typespec << '\n';
     if (_initializer != NULL) {
         output_annot(stream,nlevel,"initializer");
         _initializer->output_at_level(stream,nlevel);
@@ -258,7 +276,7 @@ void ast_declaration_statement_node::output_impl(ostream& stream,int nlevel) con
 #endif
 ast_declaration_statement_node* ast_declaration_statement_builder::build()
 {
-    ast_declaration_statement_node* node = new ast_declaration_statement_node;
+    ast_declaration_statement_node* node = new (get_arena()) ast_declaration_statement_node;
     node->set_lineno(get_line());
     node->_initializer = static_cast<ast_expression_node*>(pop_node());
     node->_id = pop_token();
@@ -272,17 +290,6 @@ ast_selection_statement_node::ast_selection_statement_node()
       _body(NULL), _elf(NULL), _else(NULL)
 {
 }
-ast_selection_statement_node::~ast_selection_statement_node()
-{
-    if (_condition != NULL)
-        delete _condition;
-    if (_body != NULL)
-        delete _body;
-    if (_elf != NULL)
-        delete _elf;
-    if (_else != NULL)
-        delete _else;
-}
 #ifdef RAMSEY_DEBUG
 void ast_selection_statement_node::output_impl(ostream& stream,int nlevel) const
 {
@@ -303,7 +310,7 @@ void ast_selection_statement_node::output_impl(ostream& stream,int nlevel) const
 #endif
 ast_selection_statement_node* ast_selection_statement_builder::build()
 {
-    ast_selection_statement_node* node = new ast_selection_statement_node;
+    ast_selection_statement_node* node = new (get_arena()) ast_selection_statement_node;
     node->set_lineno(get_line());
     node->_else = static_cast<ast_statement_node*>(pop_node());
     node->_elf = static_cast<ast_elf_node*>(pop_node());
@@ -317,15 +324,6 @@ ast_elf_node::ast_elf_node()
     : _condition(NULL), _body(NULL), _elf(NULL)
 {
 }
-ast_elf_node::~ast_elf_node()
-{
-    if (_condition != NULL)
-        delete _condition;
-    if (_body != NULL)
-        delete _body;
-    if (_elf != NULL)
-        delete _elf;
-}
 #ifdef RAMSEY_DEBUG
 void ast_elf_node::output_impl(ostream& stream,int nlevel) const
 {
@@ -344,7 +342,7 @@ void ast_elf_node::output_impl(ostream& stream,int nlevel) const
 #endif
 ast_elf_node* ast_elf_builder::build()
 {
-    ast_elf_node* node = new ast_elf_node;
+    ast_elf_node* node = new (get_arena()) ast_elf_node;
     node->set_lineno(get_line());
     node->_elf = static_cast<ast_elf_node*>(pop_node());
     node->_body = static_cast<ast_statement_node*>(pop_node());
@@ -357,13 +355,6 @@ ast_iterative_statement_node::ast_iterative_statement_node()
     : ast_statement_node(ast_iterative_statement), _condition(NULL), _body(NULL)
 {
 }
-ast_iterative_statement_node::~ast_iterative_statement_node()
-{
-    if (_condition != NULL)
-        delete _condition;
-    if (_body != NULL)
-        delete _body;
-}
 #ifdef RAMSEY_DEBUG
 void ast_iterative_statement_node::output_impl(ostream& stream,int nlevel) const
 {
@@ -378,7 +369,7 @@ void ast_iterative_statement_node::output_impl(ostream& stream,int nlevel) const
 #endif
 ast_iterative_statement_node* ast_iterative_statement_builder::build()
 {
-    ast_iterative_statement_node* node = new ast_iterative_statement_node;
+    ast_iterative_statement_node* node = new (get_arena()) ast_iterative_statement_node;
     node->set_lineno(get_line());
     node->_body = static_cast<ast_statement_node*>(pop_node());
     node->_condition = static_cast<ast_expression_node*>(pop_node());
@@ -387,18 +378,13 @@ ast_iterative_statement_node* ast_iterative_statement_builder::build()
 
 // ast_jump_statement_node, ast_jump_statement_builder
 ast_jump_statement_node::ast_jump_statement_node()
-    : ast_statement_node(ast_jump_statement), _kind(NULL), _expr(NULL)
+    : ast_statement_node(ast_jump_statement), _expr(NULL)
 {
 }
-ast_jump_statement_node::~ast_jump_statement_node()
-{
-    if (_expr != NULL)
-        delete _expr;
-}
 #ifdef RAMSEY_DEBUG
 void ast_jump_statement_node::output_impl(ostream& stream,int nlevel) const
 {
-    stream << "ast_jump_statement_node:kind=" << *_kind << '\n';
+    stream << "ast_jump_statement_node:kind=" << _kind << '\n';
     if (_expr != NULL) {
         output_annot(stream,nlevel,"return-expression");
         _expr->output_at_level(stream,nlevel);
@@ -407,7 +393,7 @@ void ast_jump_statement_node::output_impl(ostream& stream,int nlevel) const
 #endif
 ast_jump_statement_node* ast_jump_statement_builder::build()
 {
-    ast_jump_statement_node* node = new ast_jump_statement_node;
+    ast_jump_statement_node* node = new (get_arena()) ast_jump_statement_node;
     node->set_lineno(get_line());
     if ( is_next_node() )
         node->_expr = static_cast<ast_expression_node*>(pop_node());
@@ -438,23 +424,9 @@ ast_expression_node::operand::operand()
     : node(NULL)
 {
 }
-ast_expression_node::operand::operand(const token* tok,int line)
-    : node(new ast_primary_expression_node(tok))
-{
-    node->set_lineno(line);
-}
-ast_expression_node::operand::operand(ast_expression_node* n)
-    : node(n)
-{
-}
-ast_expression_node::operand::~operand()
+void ast_expression_node::operand::assign_primary_expr(arena& nodes,token tok,int line)
 {
-    if (node != NULL)
-        delete node;
-}
-void ast_expression_node::operand::assign_primary_expr(const token* tok,int line)
-{
-    node = new ast_primary_expression_node(tok);
+    node = new (nodes) ast_primary_expression_node(tok);
     node->set_lineno(line);
 }
 ast_expression_node* ast_expression_builder::build()
@@ -468,7 +440,7 @@ ast_expression_node* ast_expression_builder::build()
         if (size() != 1)
             throw ast_exception("ast_expression_builder: expected single token in element stack");
 #endif
-        ast_primary_expression_node* node = new ast_primary_expression_node( pop_token() );
+        ast_primary_expression_node* node = new (get_arena()) ast_primary_expression_node( pop_token() );
         node->set_lineno(get_line());
         return node;
     }
@@ -502,11 +474,11 @@ ast_assignment_expression_node* ast_assignment_expression_builder::build()
         throw ast_exception("ast_assignment_expression_builder: element stack did not contain correct number of elements");
 #endif
     int line;
-    ast_assignment_expression_node* node = new ast_assignment_expression_node;
+    ast_assignment_expression_node* node = new (get_arena()) ast_assignment_expression_node;
     node->set_lineno(line = get_line());
     for (short i = 1;i >= 0;--i) {
         if ( is_next_token() )
-            node->_ops[i].assign_primary_expr(pop_token(),line);
+            node->_ops[i].assign_primary_expr(get_arena(),pop_token(),line);
         else
             node->_ops[i].node = static_cast<ast_expression_node*>(pop_node());
     }
@@ -522,7 +494,7 @@ ast_logical_or_expression_node::ast_logical_or_expression_node()
 void ast_logical_or_expression_node::output_impl(ostream& stream,int nlevel) const
 {
     stream << "logical-or-expression\n";
-    for (deque<operand>::const_iterator iter = _ops.begin();iter != _ops.end();++iter)
+    for (const operand* iter = _ops.begin();iter != _ops.end();++iter)
         iter->node->output_at_level(stream,nlevel);
 }
 #endif
@@ -533,13 +505,16 @@ ast_logical_or_expression_node* ast_logical_or_expression_builder::build()
         throw ast_exception("ast_logical_or_expression_builder: element stack did not contain correct number of elements");
 #endif
     int line;
-    ast_logical_or_expression_node* node = new ast_logical_or_expression_node;
+    ast_logical_or_expression_node* node = new (get_arena()) ast_logical_or_expression_node;
     node->set_lineno(line = get_line());
-    while ( !is_empty() ) {
+    // the elements are popped in reverse order
+    size_t i = size_t(size());
+    node->_ops.allocate(get_arena(),i);
+    while (i-- > 0) {
         if ( is_next_token() )
-            node->_ops.emplace_front(pop_token(),line);
+            node->_ops[i].assign_primary_expr(get_arena(),pop_token(),line);
         else
-            node->_ops.emplace_front( static_cast<ast_expression_node*>(pop_node()) );
+            node->_ops[i].node = static_cast<ast_expression_node*>(pop_node());
     }
     return node;
 }
@@ -553,7 +528,7 @@ ast_logical_and_expression_node::ast_logical_and_expression_node()
 void ast_logical_and_expression_node::output_impl(ostream& stream,int nlevel) const
 {
     stream << "logical-and-expression\n";
-    for (deque<operand>::const_iterator iter = _ops.begin();iter != _ops.end();++iter)
+    for (const operand* iter = _ops.begin();iter != _ops.end();++iter)
         iter->node->output_at_level(stream,nlevel);
 }
 #endif
@@ -564,13 +539,16 @@ ast_logical_and_expression_node* ast_logical_and_expression_builder::build()
         throw ast_exception("ast_logical_and_expression_builder: element stack did not contain correct number of elements");
 #endif
     int line;
-    ast_logical_and_expression_node* node = new ast_logical_and_expression_node;
+    ast_logical_and_expression_node* node = new (get_arena()) ast_logical_and_expression_node;
     node->set_lineno(line = get_line());
-    while ( !is_empty() ) {
+    // the elements are popped in reverse order
+    size_t i = size_t(size());
+    node->_ops.allocate(get_arena(),i);
+    while (i-- > 0) {
         if ( is_next_token() )
-            node->_ops.emplace_front(pop_token(),line);
+            node->_ops[i].assign_primary_expr(get_arena(),pop_token(),line);
         else
-            node->_ops.emplace_front( static_cast<ast_expression_node*>(pop_node()) );
+            node->_ops[i].node = static_cast<ast_expression_node*>(pop_node());
     }
     return node;
 }
@@ -587,7 +565,7 @@ void ast_equality_expression_node::output_impl(ostream& stream,int nlevel) const
     _operands[0].node->output_at_level(stream,nlevel);
     for (int cnt = 0;cnt < nlevel;++cnt)
         stream.put('\t');
-    stream << *_operator << '\n';
+    stream << _operator << '\n';
     _operands[1].node->output_at_level(stream,nlevel);
 }
 #endif
@@ -598,10 +576,10 @@ ast_equality_expression_node* ast_equality_expression_builder::build()
         throw ast_exception("ast_equality_expression_builder: element stack did not contain correct number of elements");
 #endif
     int line;
-    ast_equality_expression_node* node = new ast_equality_expression_node;
+    ast_equality_expression_node* node = new (get_arena()) ast_equality_expression_node;
     node->set_lineno(line = get_line());
     if ( is_next_token() )
-        node->_operands[0].assign_primary_expr(pop_token(),line);
+        node->_operands[0].assign_primary_expr(get_arena(),pop_token(),line);
     else
         node->_operands[0].node = static_cast<ast_expression_node*>(pop_node());
 #ifdef RAMSEY_DEBUG
@@ -610,7 +588,7 @@ ast_equality_expression_node* ast_equality_expression_builder::build()
 #endif
     node->_operator = pop_token();
     if ( is_next_token() )
-        node->_operands[1].assign_primary_expr(pop_token(),line);
+        node->_operands[1].assign_primary_expr(get_arena(),pop_token(),line);
     else
         node->_operands[1].node = static_cast<ast_expression_node*>(pop_node());
     return node;
@@ -628,7 +606,7 @@ void ast_relational_expression_node::output_impl(ostream& stream,int nlevel) con
     _operands[0].node->output_at_level(stream,nlevel);
     for (int cnt = 0;cnt < nlevel;++cnt)
         stream.put('\t');
-    stream << *_operator << '\n';
+    stream << _operator << '\n';
     _operands[1].node->output_at_level(stream,nlevel);
 }
 #endif
@@ -639,10 +617,10 @@ ast_relational_expression_node* ast_relational_expression_builder::build()
         throw ast_exception("ast_relational_expression_builder: element stack did not contain correct number of elements");
 #endif
     int line;
-    ast_relational_expression_node* node = new ast_relational_expression_node;
+    ast_relational_expression_node* node = new (get_arena()) ast_relational_expression_node;
     node->set_lineno(line = get_line());
     if ( is_next_token() )
-        node->_operands[0].assign_primary_expr(pop_token(),line);
+        node->_operands[0].assign_primary_expr(get_arena(),pop_token(),line);
     else
         node->_operands[0].node = static_cast<ast_expression_node*>(pop_node());
 #ifdef RAMSEY_DEBUG
@@ -651,7 +629,7 @@ ast_relational_expression_node* ast_relational_expression_builder::build()
 #endif
     node->_operator = pop_token();
     if ( is_next_token() )
-        node->_operands[1].assign_primary_expr(pop_token(),line);
+        node->_operands[1].assign_primary_expr(get_arena(),pop_token(),line);
     else
         node->_operands[1].node = static_cast<ast_expression_node*>(pop_node());
     return node;
@@ -665,13 +643,13 @@ ast_additive_expression_node::ast_additive_expression_node()
 #ifdef RAMSEY_DEBUG
 void ast_additive_expression_node::output_impl(ostream& stream,int nlevel) const
 {
-    deque<operand>::size_type i = 0, j = 0;
+    size_t i = 0, j = 0;
     stream << "additive-expression\n";
     while (j < _operators.size()) {
         _operands[i++].node->output_at_level(stream,nlevel);
         for (int cnt = 0;cnt < nlevel;++cnt)
             stream.put('\t');
-        stream << *_operators[j++] << '\n';
+        stream << _operators[j++] << '\n';
     }
     _operands[i].node->output_at_level(stream,nlevel);
 }
@@ -683,19 +661,20 @@ ast_additive_expression_node* ast_additive_expression_builder::build()
         throw ast_exception("ast_additive_expression_builder: element stack did not contain correct number of elements");
 #endif
     int line;
-    bool state = true;
-    ast_additive_expression_node* node = new ast_additive_expression_node;
+    ast_additive_expression_node* node = new (get_arena()) ast_additive_expression_node;
     node->set_lineno(line = get_line());
-    while ( !is_empty() ) {
-        if (state) {
-            if ( is_next_token() )
-                node->_operands.emplace_front(pop_token(),line);
-            else
-                node->_operands.emplace_front( static_cast<ast_expression_node*>(pop_node()) );
-        }
+    // the elements alternate operand, operator, ..., operand and are popped in reverse order
+    size_t i = size_t(size())/2 + 1, j = i - 1;
+    node->_operands.allocate(get_arena(),i);
+    node->_operators.allocate(get_arena(),j);
+    while (i > 0) {
+        --i;
+        if ( is_next_token() )
+            node->_operands[i].assign_primary_expr(get_arena(),pop_token(),line);
         else
-            node->_operators.push_front( pop_token() );
-        state = !state;
+            node->_operands[i].node = static_cast<ast_expression_node*>(pop_node());
+        if (j > 0)
+            node->_operators[--j] = pop_token();
     }
     return node;
 }
@@ -708,13 +687,13 @@ ast_multiplicative_expression_node::ast_multiplicative_expression_node()
 #ifdef RAMSEY_DEBUG
 void ast_multiplicative_expression_node::output_impl(ostream& stream,int nlevel) const
 {
-    deque<operand>::size_type i = 0, j = 0;
+    size_t i = 0, j = 0;
     stream << "multiplicative-expression\n";
     while (j < _operators.size()) {
         _operands[i++].node->output_at_level(stream,nlevel);
         for (int cnt = 0;cnt < nlevel;++cnt)
             stream.put('\t');
-        stream << *_operators[j++] << '\n';
+        stream << _operators[j++] << '\n';
     }
     _operands[i].node->output_at_level(stream,nlevel);
 }
@@ -726,32 +705,33 @@ ast_multiplicative_expression_node* ast_multiplicative_expression_builder::build
         throw ast_exception("ast_multiplicative_expression_builder: element stack did not contain correct number of elements");
 #endif
     int line;
-    bool state = true;
-    ast_multiplicative_expression_node* node = new ast_multiplicative_expression_node;
+    ast_multiplicative_expression_node* node = new (get_arena()) ast_multiplicative_expression_node;
     node->set_lineno(line = get_line());
-    while ( !is_empty() ) {
-        if (state) {
-            if ( is_next_token() )
-                node->_operands.emplace_front(pop_token(),line);
-            else
-                node->_operands.emplace_front( static_cast<ast_expression_node*>(pop_node()) );
-        }
+    // the elements alternate operand, operator, ..., operand and are popped in reverse order
+    size_t i = size_t(size())/2 + 1, j = i - 1;
+    node->_operands.allocate(get_arena(),i);
+    node->_operators.allocate(get_arena(),j);
+    while (i > 0) {
+        --i;
+        if ( is_next_token() )
+            node->_operands[i].assign_primary_expr(get_arena(),pop_token(),line);
         else
-            node->_operators.push_front( pop_token() );
-        state = !state;
+            node->_operands[i].node = static_cast<ast_expression_node*>(pop_node());
+        if (j > 0)
+            node->_operators[--j] = pop_token();
     }
     return node;
 }
 
 // ast_prefix_expression_node, ast_prefix_expression_builder
 ast_prefix_expression_node::ast_prefix_expression_node()
-    : ast_expression_node(ast_prefix_expression), _operator(NULL)
+    : ast_expression_node(ast_prefix_expression)
 {
 }
 #ifdef RAMSEY_DEBUG
 void ast_prefix_expression_node::output_impl(ostream& stream,int nlevel) const
 {
-    stream << "prefix-expression:op=" << *_operator << '\n';
+    stream << "prefix-expression:op=" << _operator << '\n';
     _operand.node->output_at_level(stream,nlevel);
 }
 #endif
@@ -762,10 +742,10 @@ ast_prefix_expression_node* ast_prefix_expression_builder::build()
         throw ast_exception("ast_prefix_expression_builder: element stack did not contain correct number of elements");
 #endif
     int line;
-    ast_prefix_expression_node* node = new ast_prefix_expression_node;
+    ast_prefix_expression_node* node = new (get_arena()) ast_prefix_expression_node;
     node->set_lineno(line = get_line());
     if ( is_next_token() )
-        node->_operand.assign_primary_expr(pop_token(),line);
+        node->_operand.assign_primary_expr(get_arena(),pop_token(),line);
     else
         node->_operand.node = static_cast<ast_expression_node*>(pop_node());
     node->_operator = pop_token();
@@ -777,11 +757,6 @@ ast_postfix_expression_node::ast_postfix_expression_node()
     : ast_expression_node(ast_postfix_expression), _expList(NULL)
 {
 }
-ast_postfix_expression_node::~ast_postfix_expression_node()
-{
-    if (_expList != NULL)
-        delete _expList;
-}
 #ifdef RAMSEY_DEBUG
 void ast_postfix_expression_node::output_impl(ostream& stream,int nlevel) const
 {
@@ -800,25 +775,33 @@ ast_postfix_expression_node* ast_postfix_expression_builder::build()
         throw ast_exception("ast_postfix_expression_builder: element stack did not contain correct number of elements");
 #endif
     int line;
-    ast_postfix_expression_node* node = new ast_postfix_expression_node;
+    ast_postfix_expression_node* node = new (get_arena()) ast_postfix_expression_node;
     node->set_lineno(line = get_line());
     node->_expList = static_cast<ast_expression_node*>(pop_node());
     // operand is either a token or a node
     if ( is_next_token() )
-        node->_op.assign_primary_expr(pop_token(),line);
+        node->_op.assign_primary_expr(get_arena(),pop_token(),line);
     else
         node->_op.node = static_cast<ast_expression_node*>(pop_node());
     return node;
 }
 
 // ast_primary_expression_node
-ast_primary_expression_node::ast_primary_expression_node(const token* tok)
-    : ast_expression_node(ast_primary_expression), _tok(tok)
+ast_primary_expression_node::ast_primary_expression_node(token tok)
+    : ast_expression_node(ast_primary_expression), _tok(tok), _symbol(NULL)
 {
 }
+const symbol* ast_primary_expression_node::get_symbol() const
+{
+#ifdef RAMSEY_DEBUG
+    if (_symbol == NULL)
+        throw ast_exception("ast_primary_expression_node::get_symbol: identifier was not bound");
+#endif
+    return _symbol;
+}
 #ifdef RAMSEY_DEBUG
 void ast_primary_expression_node::output_impl(ostream& stream,int) const
 {
-    stream << "primary-expression:tok=" << *_tok << '\n';
+    stream << "primary-expression:tok=" << _tok << '\n';
 }
 #endif
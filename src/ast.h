@@ -4,9 +4,9 @@
 #include "ramsey-error.h" // gets <ostream>, <string>
 #include "lexer.h"
 #include "stable.h"
+#include "arena.h"
 #include "codegen.h"
-#include <deque>
-#include <stack>
+#include <vector>
 
 namespace ramsey
 {
@@ -27,68 +27,133 @@ namespace ramsey
     // forward declare types used in this module before their definition
     class ast_node; class ast_function_node; class ast_parameter_node;
     class ast_statement_node; class ast_elf_node; class ast_expression_node;
-    class ast_expression_builder;
+    class ast_expression_builder; class flat_ast;
 
-    // provide a base type for handling AST construction; a subtype will
-    // be created to handle each construct in the AST
-    class ast_builder
+    // provide a contiguous stack of elements (tokens and nodes) and line
+    // numbers shared by every construct of a parse; each construct under
+    // construction owns a frame of the stack (the elements above a marker),
+    // so nested constructs reuse the same storage and the whole state of a
+    // partial parse is data on this stack rather than in native call frames
+    class ast_element_stack
     {
+        friend class ast_builder;
     public:
-        void add_token(const token* tok)
+        ast_element_stack();
+
+        void open_frame(); // begin the frame of a new construct
+        void adopt_frame(); // begin a new frame that takes over the last element of the current frame
+        void close_frame(); // end the current frame; its elements are handed to the frame below it
+        void add_token(token tok)
         { _elems.push_back(tok); }
         void add_node(ast_node* pnode)
         { _elems.push_back(pnode); }
         void add_line(int lno)
-        { _linenos.push(lno); }
-        bool is_empty() const
-        { return _elems.empty(); }
-        int size() const
-        { return int(_elems.size()); }
-        void collapse(ast_builder& builder);
-    protected:
-        ast_builder() {}
-
-        bool is_next_token() const
-        { return _elems.back().flag == ast_element::ast_element_tok; }
-        bool is_next_node() const
-        { return _elems.back().flag == ast_element::ast_element_node; }
-        const token* pop_token();
-        ast_node* pop_node();
-        int get_line();
+        { _linenos.push_back(lno); }
+        bool is_empty() const // is the current frame empty?
+        { return size() == 0; }
+        int size() const // number of elements in the current frame
+        { return int(_elems.size()) - _frames.back().elembase; }
     private:
         struct ast_element
         {
             ast_element();
-            ast_element(const token* tok);
+            ast_element(token t);
             ast_element(ast_node* pnode);
 
             enum {
                 ast_element_tok,
                 ast_element_node
             };
-            union {
-                const token* ptok;
-                ast_node* pnode;
-                int decore;
-            };
+            token tok;
+            ast_node* pnode;
             short flag;
         };
+        struct frame
+        {
+            int elembase; // first element of the frame
+            int linebase; // first line number of the frame
+        };
 
-        std::deque<ast_element> _elems;
-        std::stack<int> _linenos;
+        std::vector<ast_element> _elems;
+        std::vector<int> _linenos;
+        std::vector<frame> _frames;
     };
 
-    // provide a generic node type (with optional debug information)
+    // provide a base type for handling AST construction; a subtype will
+    // be created to handle each construct in the AST; a builder turns the
+    // elements of the current frame of the element stack into a node (the
+    // caller closes the frame afterwards)
+    class ast_builder
+    {
+    public:
+        bool is_empty() const
+        { return _stack.is_empty(); }
+        int size() const
+        { return _stack.size(); }
+    protected:
+        ast_builder(arena& a,ast_element_stack& s) // nodes are allocated in 'a'; elements are taken from 's'
+            : _arena(a), _stack(s) {}
+
+        arena& get_arena()
+        { return _arena; }
+        bool is_next_token() const
+        { return _stack._elems.back().flag == ast_element_stack::ast_element::ast_element_tok; }
+        bool is_next_node() const
+        { return _stack._elems.back().flag == ast_element_stack::ast_element::ast_element_node; }
+        token pop_token();
+        ast_node* pop_node();
+        int get_line();
+    private:
+        arena& _arena;
+        ast_element_stack& _stack;
+    };
+
+    // provide the state of a node while a pass (semantic analysis or code
+    // generation) is visiting it; the passes keep a stack of these frames
+    // instead of recursing, so a node's pass function runs in steps: to visit
+    // a child it records its next step and returns the child, and it is called
+    // again once the child is done
+    struct ast_pass_frame
+    {
+        ast_pass_frame(const ast_node* n);
+
+        template<typename T>
+        const T* next_item(); // take the item of a list at 'cursor' (NULL at the end of the list)
+
+        const ast_node* node;
+        int step;
+        int index; // current operand (or count of arguments)
+        const ast_node* cursor; // next item of the list being visited
+        const ast_node* current; // function being visited (function lists)
+        int labels[3];
+        bool alloc; // did the node allocate its result register?
+        const char* reg; // register of a condition or an operand
+    };
+
+    // provide a generic node type (with optional debug information); nodes
+    // are constructed in the parser's arena ('new (arena) node') and are
+    // released together with it, so they are never deleted individually
     class ast_node
     {
     public:
         ast_node();
         virtual ~ast_node() {}
 
-        void check_semantics(stable& symtable) const // perform semantic analysis on the node; a scope should already exist in 'symtable'
-        { semantics_impl(symtable); }
-        void generate_code(stable& symtable,code_generator& generator) const // generate ASM code on the node; a scope should already exist in 'symtable'
-        { codegen_impl(symtable,generator); }
+        void check_semantics(stable& symtable) const; // perform semantic analysis on the node; a scope should already exist in 'symtable'
+        void generate_code(code_generator& generator) const; // generate ASM code on the node; semantic analysis must have bound its identifiers
+        // the same passes run on the threads of 'pool', each function apart from the others; the
+        // node must be the root of the tree (the function list); the results are the same
+        void check_semantics(stable& symtable,thread_pool& pool) const;
+        void generate_code(code_generator& generator,thread_pool& pool) const;
+        // both passes in one: each function is checked and then generated at once (last to
+        // first); the node must be the root of the tree; code is generated only for the
+        // functions checked before an error is found
+        void check_and_generate(stable& symtable,code_generator& generator) const;
+        // the same for a program parsed one function at a time (see parser::next_function): the
+        // root, which declares the functions, is given to 'declare_functions', then each function
+        // is given to 'check_and_generate_function'
+        void declare_functions(stable& symtable) const;
+        void check_and_generate_function(stable& symtable,code_generator& generator) const;
 
         int get_lineno() const
         { return _lineno; }
@@ -110,9 +175,17 @@ namespace ramsey
 
         int _lineno;
 
-        // virtual interface
-        virtual void semantics_impl(stable& symtable) const = 0; // perform semantic analysis
-        virtual void codegen_impl(stable& symtable,code_generator&) const = 0; // generate assembly code
+        // visit a tree beginning with the frame 'root' (see ast_pass_frame)
+        static void semantics_walk(stable& symtable,const ast_pass_frame& root);
+        static void codegen_walk(code_generator& generator,const ast_pass_frame& root);
+        // add the functions of the list 'root' to 'symtable' and get them in the order
+        // that the passes visit them (last to first); the frame visits just 'function'
+        static void declare_functions(const ast_node* root,stable& symtable,std::vector<const ast_function_node*>& funcs);
+        static ast_pass_frame function_frame(const ast_function_node* function);
+
+        // virtual interface: each returns a child to visit before its next step, or NULL once the node is done
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const = 0; // perform semantic analysis
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const = 0; // generate assembly code
     };
 
     // provide a generic node that can form a linked-list; any construct
@@ -121,7 +194,6 @@ namespace ramsey
     class ast_linked_node : public ast_node
     {
     public:
-        ~ast_linked_node();
         T* get_next();
         const T* get_next() const;
         T* get_prev();
@@ -143,35 +215,42 @@ namespace ramsey
                               private symbol
     { // represents the root node node of the AST
         friend class ast_function_builder;
-    public:
-        ~ast_function_node();
+        friend class flat_ast;
+        friend class ast_node; // runs the passes on the functions one by one
     private:
         ast_function_node();
 
         // elements
-        const token* _id; // identifier that names function
+        token _id; // identifier that names function
         ast_parameter_node* _param; // OPTIONAL list of parameter declarations
-        const token* _typespec; // OPTIONAL type of function
+        token _typespec; // OPTIONAL type of function
         ast_statement_node* _statements; // OPTIONAL list of statements
+        arena_array<token_t> _argtypes; // parameter types (terminated by token_invalid)
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
-        virtual const char* get_name_impl() const
-        { return _id->source_string(); }
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
+        virtual std::string get_name_impl() const
+        { return _id.source_string(); }
+        virtual int get_ident_impl() const
+        { return _id.ident(); }
         virtual token_t get_type_impl() const
-        { return _typespec != NULL ? _typespec->type() : token_in; }
+        { return _typespec.valid() ? _typespec.type() : token_in; }
         virtual skind get_kind_impl() const
         { return skind_function; }
-        virtual token_t* get_argtypes_impl() const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const token_t* get_argtypes_impl() const
+        { return _argtypes.begin(); }
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_function_builder : public ast_builder
     {
     public:
+        ast_function_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_function_node* build();
+        static ast_function_node* join(ast_function_node* first,ast_function_node* second); // link list 'second' after list 'first'
     private:
         ast_function_node* get_next();
     };
@@ -180,30 +259,36 @@ namespace ramsey
                                private symbol
     {
         friend class ast_parameter_builder;
+        friend class flat_ast;
         friend class ast_function_node;
+        friend class ast_function_builder;
     private:
         ast_parameter_node();
 
         // elements
-        const token* _typespec; // type of parameter
-        const token* _id; // identifier that names parameter
+        token _typespec; // type of parameter
+        token _id; // identifier that names parameter
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
-        virtual const char* get_name_impl() const
-        { return _id->source_string(); }
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
+        virtual std::string get_name_impl() const
+        { return _id.source_string(); }
+        virtual int get_ident_impl() const
+        { return _id.ident(); }
         virtual token_t get_type_impl() const
-        { return _typespec->type(); }
+        { return _typespec.type(); }
         virtual skind get_kind_impl() const
         { return skind_variable; }
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_parameter_builder : public ast_builder
     {
     public:
+        ast_parameter_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_parameter_node* build();
     private:
         ast_parameter_node* get_next();
@@ -212,9 +297,8 @@ namespace ramsey
     class ast_statement_node : public ast_linked_node<ast_statement_node>
     { // abstract class for statements; this shouldn't implement any virtual functions directly
         friend class ast_statement_builder;
+        friend class flat_ast;
     public:
-        virtual ~ast_statement_node() {}
-    protected:
         enum ast_statement_kind
         {
             ast_declaration_statement,
@@ -225,6 +309,13 @@ namespace ramsey
             ast_jump_statement
         };
 
+        virtual ~ast_statement_node() {}
+
+        // get a flag representing what kind of statement the node represents; note
+        // that expression-statements are expression nodes linked into the statement list
+        ast_statement_kind get_kind() const
+        { return _kind; }
+    protected:
         ast_statement_node(ast_statement_kind kind);
     private:
         const ast_statement_kind _kind; // decorate what kind of statement node this is
@@ -232,6 +323,8 @@ namespace ramsey
     class ast_statement_builder : public ast_builder
     {
     public:
+        ast_statement_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_statement_node* build();
     };
 
@@ -239,32 +332,35 @@ namespace ramsey
                                            private symbol
     {
         friend class ast_declaration_statement_builder;
-    public:
-        ~ast_declaration_statement_node();
+        friend class flat_ast;
     private:
         ast_declaration_statement_node();
 
         // elements
-        const token* _typespec; // type specifier
-        const token* _id; // identifier (name) of declaration
+        token _typespec; // type specifier
+        token _id; // identifier (name) of declaration
         ast_expression_node* _initializer; // OPTIONAL initializer for declaration
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
-        virtual const char* get_name_impl() const
-        { return _id->source_string(); }
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
+        virtual std::string get_name_impl() const
+        { return _id.source_string(); }
+        virtual int get_ident_impl() const
+        { return _id.ident(); }
         virtual token_t get_type_impl() const
-        { return _typespec->type(); }
+        { return _typespec.type(); }
         virtual skind get_kind_impl() const
         { return skind_variable; }
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_declaration_statement_builder : public ast_builder
     {
     public:
+        ast_declaration_statement_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_declaration_statement_node* build();
     };
 
@@ -276,8 +372,7 @@ namespace ramsey
     class ast_selection_statement_node : public ast_statement_node
     {
         friend class ast_selection_statement_builder;
-    public:
-        ~ast_selection_statement_node();
+        friend class flat_ast;
     private:
         ast_selection_statement_node();
 
@@ -291,20 +386,21 @@ namespace ramsey
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_selection_statement_builder : public ast_builder
     {
     public:
+        ast_selection_statement_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_selection_statement_node* build();
     };
 
     class ast_elf_node : public ast_node
     {
         friend class ast_elf_builder;
-    public:
-        ~ast_elf_node();
+        friend class flat_ast;
     private:
         ast_elf_node();
 
@@ -317,20 +413,21 @@ namespace ramsey
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_elf_builder : public ast_builder
     {
     public:
+        ast_elf_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_elf_node* build();
     };
 
     class ast_iterative_statement_node : public ast_statement_node
     {
         friend class ast_iterative_statement_builder;
-    public:
-        ~ast_iterative_statement_node();
+        friend class flat_ast;
     private:
         ast_iterative_statement_node();
 
@@ -342,43 +439,47 @@ namespace ramsey
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_iterative_statement_builder : public ast_builder
     {
     public:
+        ast_iterative_statement_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_iterative_statement_node* build();
     };
 
     class ast_jump_statement_node : public ast_statement_node
     {
         friend class ast_jump_statement_builder;
-    public:
-        ~ast_jump_statement_node();
+        friend class flat_ast;
     private:
         ast_jump_statement_node();
 
         // elements
-        const token* _kind; // 'toss' or 'smash'
+        token _kind; // 'toss' or 'smash'
         ast_expression_node* _expr; // OPTIONAL used only for 'toss' statement
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_jump_statement_builder : public ast_builder
     {
     public:
+        ast_jump_statement_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_jump_statement_node* build();
     };
 
     class ast_expression_node : public ast_linked_node<ast_expression_node>
     { // abstract class for expressions; shouldn't implement any virtual functions directly
         friend class ast_expression_builder;
+        friend class flat_ast;
     public:
         enum ast_expression_kind
         {
@@ -409,20 +510,16 @@ namespace ramsey
         ast_expression_node(ast_expression_kind kind);
 
         struct operand
-        { // an 'operand' wraps an expression node and will delete it at unload time
+        { // an 'operand' refers to an expression node
             operand();
-            operand(const token*,int);
-            operand(ast_expression_node*);
-            ~operand();
 
-            void assign_primary_expr(const token*,int);
+            void assign_primary_expr(arena&,token,int);
 
             ast_expression_node* node;
-        private:
-            operand(const operand&);
         };
 
-        static const char* load_operand(const operand&,stable&,code_generator&,bool alloc = false);
+        static const ast_node* load_operand(const operand&,code_generator&,bool alloc = false); // returns the operand to visit
+        static const char* loaded_register(const code_generator&); // register into which the operand was loaded
     private:
         ast_expression_kind _kind; // decorate what kind of expression node this is
         mutable token_t _type;
@@ -432,12 +529,15 @@ namespace ramsey
     class ast_expression_builder : public ast_builder
     {
     public:
+        ast_expression_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_expression_node* build();
     };
 
     class ast_assignment_expression_node : public ast_expression_node
     {
         friend class ast_assignment_expression_builder;
+        friend class flat_ast;
     private:
         ast_assignment_expression_node();
 
@@ -448,187 +548,209 @@ namespace ramsey
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
         virtual token_t get_ex_type_impl(const stable&) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_assignment_expression_builder : public ast_builder
     {
     public:
+        ast_assignment_expression_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_assignment_expression_node* build();
     };
 
     class ast_logical_or_expression_node : public ast_expression_node
     {
         friend class ast_logical_or_expression_builder;
+        friend class flat_ast;
     private:
         ast_logical_or_expression_node();
 
         // elements: the operator is implied
-        std::deque<operand> _ops;
+        arena_array<operand> _ops;
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
         virtual token_t get_ex_type_impl(const stable&) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_logical_or_expression_builder : public ast_builder
     {
     public:
+        ast_logical_or_expression_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_logical_or_expression_node* build();
     };
 
     class ast_logical_and_expression_node : public ast_expression_node
     {
         friend class ast_logical_and_expression_builder;
+        friend class flat_ast;
     private:
         ast_logical_and_expression_node();
 
         // elements: the operator is implied
-        std::deque<operand> _ops;
+        arena_array<operand> _ops;
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
         virtual token_t get_ex_type_impl(const stable&) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_logical_and_expression_builder : public ast_builder
     {
     public:
+        ast_logical_and_expression_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_logical_and_expression_node* build();
     };
 
     class ast_equality_expression_node : public ast_expression_node
     {
         friend class ast_equality_expression_builder;
+        friend class flat_ast;
     private:
         ast_equality_expression_node();
 
         // elements
-        const token* _operator;
+        token _operator;
         operand _operands[2];
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
         virtual token_t get_ex_type_impl(const stable&) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_equality_expression_builder : public ast_builder
     {
     public:
+        ast_equality_expression_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_equality_expression_node* build();
     };
 
     class ast_relational_expression_node : public ast_expression_node
     {
         friend class ast_relational_expression_builder;
+        friend class flat_ast;
     private:
         ast_relational_expression_node();
 
         // elements
-        const token* _operator;
+        token _operator;
         operand _operands[2];
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
         virtual token_t get_ex_type_impl(const stable&) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_relational_expression_builder : public ast_builder
     {
     public:
+        ast_relational_expression_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_relational_expression_node* build();
     };
 
     class ast_additive_expression_node : public ast_expression_node
     {
         friend class ast_additive_expression_builder;
+        friend class flat_ast;
     private:
         ast_additive_expression_node();
 
         // elements
-        std::deque<operand> _operands;
-        std::deque<const token*> _operators;
+        arena_array<operand> _operands;
+        arena_array<token> _operators;
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
         virtual token_t get_ex_type_impl(const stable&) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_additive_expression_builder : public ast_builder
     {
     public:
+        ast_additive_expression_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_additive_expression_node* build();
     };
 
     class ast_multiplicative_expression_node : public ast_expression_node
     {
         friend class ast_multiplicative_expression_builder;
+        friend class flat_ast;
     private:
         ast_multiplicative_expression_node();
 
         // elements
-        std::deque<operand> _operands;
-        std::deque<const token*> _operators;
+        arena_array<operand> _operands;
+        arena_array<token> _operators;
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
         virtual token_t get_ex_type_impl(const stable&) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_multiplicative_expression_builder : public ast_builder
     {
     public:
+        ast_multiplicative_expression_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_multiplicative_expression_node* build();
     };
 
     class ast_prefix_expression_node : public ast_expression_node
     {
         friend class ast_prefix_expression_builder;
+        friend class flat_ast;
     private:
         ast_prefix_expression_node();
 
         // elements
-        const token* _operator;
+        token _operator;
         operand _operand;
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
         virtual token_t get_ex_type_impl(const stable&) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_prefix_expression_builder : public ast_builder
     {
     public:
+        ast_prefix_expression_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_prefix_expression_node* build();
     };
 
     class ast_postfix_expression_node : public ast_expression_node
     {
         friend class ast_postfix_expression_builder;
-    public:
-        ~ast_postfix_expression_node();
+        friend class flat_ast;
     private:
         ast_postfix_expression_node();
 
@@ -640,39 +762,48 @@ namespace ramsey
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
         virtual token_t get_ex_type_impl(const stable&) const;
-        virtual void codegen_impl(stable& symtable,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
     class ast_postfix_expression_builder : public ast_builder
     {
     public:
+        ast_postfix_expression_builder(arena& a,ast_element_stack& s)
+            : ast_builder(a,s) {}
         ast_postfix_expression_node* build();
     };
 
     class ast_primary_expression_node : public ast_expression_node
     {
         friend class ast_expression_builder;
+        friend class flat_ast;
     public:
-        ast_primary_expression_node(const token* tok);
+        ast_primary_expression_node(token tok);
 
         bool is_identifier() const
-        { return _tok->type() == token_id; }
-        const char* name() const
-        { return _tok->source_string(); }
-        const char* value() const
-        { return _tok->source_string(); }
+        { return _tok.type() == token_id; }
+        std::string name() const
+        { return _tok.source_string(); }
+        int ident() const // interned identifier ID (-1 if not an identifier)
+        { return is_identifier() ? _tok.ident() : -1; }
+        std::string value() const
+        { return _tok.source_string(); }
+        const symbol* get_symbol() const; // the symbol an identifier was bound to by semantic analysis
+        void bind(const symbol* sym) const
+        { _symbol = sym; }
     private:
         // elements
-        const token* _tok; // in the AST, a primary expression is only a single token expression
+        token _tok; // in the AST, a primary expression is only a single token expression
+        mutable const symbol* _symbol; // bound during semantic analysis (identifiers only)
 
         // virtual functions
 #ifdef RAMSEY_DEBUG
         virtual void output_impl(std::ostream&,int nlevel) const;
 #endif
-        virtual void semantics_impl(stable& symtable) const;
+        virtual const ast_node* semantics_impl(stable& symtable,ast_pass_frame& frame) const;
         virtual token_t get_ex_type_impl(const stable&) const;
-        virtual void codegen_impl(stable&,code_generator&) const;
+        virtual const ast_node* codegen_impl(code_generator&,ast_pass_frame& frame) const;
     };
 }
 
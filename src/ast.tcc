@@ -1,16 +1,20 @@
 /* ast.tcc - ast.h out-of-line implementation */
 
-// ast_linked_node
+// ast_pass_frame
 template<typename T>
-ramsey::ast_linked_node<T>::ast_linked_node()
-    : _nxt(NULL), _prv(NULL)
+const T* ramsey::ast_pass_frame::next_item()
 {
+    const T* item = static_cast<const T*>(cursor);
+    if (item != NULL)
+        cursor = item->get_next();
+    return item;
 }
+
+// ast_linked_node
 template<typename T>
-ramsey::ast_linked_node<T>::~ast_linked_node()
+ramsey::ast_linked_node<T>::ast_linked_node()
+    : _nxt(NULL), _prv(NULL)
 {
-    if (_nxt != NULL)
-        delete _nxt;
 }
 template<typename T>
 T* ramsey::ast_linked_node<T>::get_next()
@@ -43,13 +47,13 @@ void ramsey::ast_linked_node<T>::append(T* node)
 template<typename T>
 void ramsey::ast_linked_node<T>::output_at_level(std::ostream& stream,int level) const
 {
-    stream.width(4);
-    stream << get_lineno() << ' ';
-    for (int i = 0;i < level;++i)
-        stream.put('\t');
-    output_impl(stream,level+1);
-    // perform the operation on the next node in the list (if any)
-    if (_nxt != NULL)
-        _nxt->output_at_level(stream,level);
+    // perform the operation on this node and on each node after it in the list
+    for (const ast_linked_node<T>* n = this;n != NULL;n = n->_nxt) {
+        stream.width(4);
+        stream << n->get_lineno() << ' ';
+        for (int i = 0;i < level;++i)
+            stream.put('\t');
+        n->output_impl(stream,level+1);
+    }
 }
 #endif
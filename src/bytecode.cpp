@@ -0,0 +1,723 @@
+/* bytecode.cpp */
+#include "bytecode.h"
+#include "flatast.h"
+#include <cstring>
+#include <cctype>
+#include <iterator>
+using namespace std;
+using namespace ramsey;
+
+// bytecode_error
+bytecode_error::bytecode_error(const char* format, ...)
+{
+    va_list args;
+    va_start(args,format);
+    _cstor(format,args);
+    va_end(args);
+}
+
+namespace
+{
+    const char* const OPERANDS[] = {
+        "di", "da", "da", "da", "da", "da",
+        "dab", "dab", "dab", "dab", "dab",
+        "dai",
+        "dab", "dab", "dab", "dab", "dab", "dab",
+        "t",
+        "at", "at",
+        "abt", "abt", "abt", "abt", "abt", "abt",
+        "ait", "ait", "ait", "ait", "ait", "ait",
+        "dfa",
+        "a"
+    };
+
+    // file format: the magic number and version, then each function
+    const char MAGIC[] = { 'R', 'M', 'B', 'C' };
+    const unsigned VERSION = 1;
+    const token_t TYPES[] = { token_in, token_big, token_small, token_boo }; // (as numbered in the file)
+    const int MAX_REGISTERS = 1 << 20;
+
+    int type_code(token_t type)
+    {
+        for (int i = 0;i < 4;++i)
+            if (TYPES[i] == type)
+                return i;
+        return 0;
+    }
+
+    // every word is written as a variable-length integer (7 bits per byte, low
+    // bits first); immediates are signed, so they are zigzag-encoded first
+    void put_varint(string& out,unsigned value)
+    {
+        while (value >= 0x80) {
+            out += char((value&0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += char(value);
+    }
+    unsigned zigzag(int value)
+    {
+        return (unsigned(value)<<1) ^ unsigned(value>>31);
+    }
+
+    class reader
+    {
+    public:
+        reader(const string& data)
+            : _p(data.data()), _e(data.data()+data.size()) {}
+
+        unsigned varint()
+        {
+            unsigned value = 0;
+            for (int shift = 0;shift < 35;shift += 7) {
+                if (_p == _e)
+                    truncated();
+                unsigned char c = (unsigned char)*_p++;
+                value |= unsigned(c&0x7f) << shift;
+                if ((c&0x80) == 0)
+                    return value;
+            }
+            throw bytecode_error("bad bytecode file: malformed integer");
+        }
+        int count(unsigned limit)
+        {
+            unsigned n = varint();
+            if (n > limit)
+                throw bytecode_error("bad bytecode file: count out of range");
+            return int(n);
+        }
+        const char* bytes(size_t n)
+        {
+            if (size_t(_e-_p) < n)
+                truncated();
+            const char* p = _p;
+            _p += n;
+            return p;
+        }
+        bool done() const
+        { return _p == _e; }
+    private:
+        const char* _p, *_e;
+
+        static void truncated()
+        { throw bytecode_error("bad bytecode file: unexpected end of file"); }
+    };
+
+    // comparisons are ordered as the comparison opcodes are (eq, ne, lt, gt, le, ge)
+    int comparison(int op)
+    {
+        switch (op) {
+        case token_equal:
+            return 0;
+        case token_nequal:
+            return 1;
+        case token_less:
+            return 2;
+        case token_greater:
+            return 3;
+        case token_le:
+            return 4;
+        }
+        return 5; // token_ge
+    }
+    const int INVERSE[] = { 1, 0, 5, 4, 3, 2 }; // the comparison that holds when one does not
+    const int MIRROR[] = { 0, 1, 3, 2, 5, 4 }; // the comparison with its operands swapped
+}
+
+// bytecode_module
+bytecode_module::bytecode_module()
+    : _function(-1), _top(0), _last(-1), _bound(-1)
+{
+}
+int bytecode_module::declare_function(const char* name,int length,const token_t* params,token_t type)
+{
+    function f;
+    f.name.assign(name,length);
+    while (*params != token_invalid)
+        f.params.push_back(*params++);
+    f.type = type;
+    f.registers = int(f.params.size());
+    f.entry = f.size = 0;
+    _functions.push_back(f);
+    _functionmap.insert( make_pair(f.name,int(_functions.size())-1) );
+    return int(_functions.size()) - 1;
+}
+void bytecode_module::begin_function(int func)
+{
+    _function = func;
+    _top = _functions[func].registers;
+    _functions[func].entry = int(_code.size());
+    _last = _bound = -1;
+    _labels.clear();
+    _fixups.clear();
+}
+int bytecode_module::allocate_register()
+{
+    if (++_top > _functions[_function].registers)
+        _functions[_function].registers = _top;
+    return _top - 1;
+}
+int bytecode_module::new_label()
+{
+    _labels.push_back(-1);
+    return int(_labels.size()) - 1;
+}
+void bytecode_module::label(int label)
+{
+    _labels[label] = _bound = int(_code.size());
+}
+void bytecode_module::emit(bytecode_opcode op,int x,int y,int z)
+{
+    const int v[] = { x, y, z };
+    const char* k = OPERANDS[op];
+    _last = int(_code.size());
+    _code.push_back(op);
+    for (int i = 0;k[i] != '\0';++i) {
+        if (k[i] == 't')
+            _fixups.push_back(int(_code.size()));
+        _code.push_back(v[i]);
+    }
+}
+bool bytecode_module::retarget(int from,int to)
+{
+    // not if a jump can reach the end of the code: the last instruction is then
+    // not the only one that leaves the value in 'from'
+    if (_last<0 || _bound==int(_code.size()) || OPERANDS[_code[_last]][0]!='d' || _code[_last+1]!=from)
+        return false;
+    _code[_last+1] = to;
+    return true;
+}
+void bytecode_module::end_function()
+{
+    for (size_t i = 0;i < _fixups.size();++i)
+        _code[_fixups[i]] = _labels[_code[_fixups[i]]];
+    function& f = _functions[_function];
+    f.size = int(_code.size()) - f.entry;
+    if (f.registers > MAX_REGISTERS)
+        throw bytecode_error("function '%s' is too large (it needs more than %d registers)",f.name.c_str(),MAX_REGISTERS);
+    _function = -1;
+}
+void bytecode_module::write(ostream& output) const
+{
+    // jump targets are written relative to the function, so each function is read on its own
+    string out(MAGIC,sizeof(MAGIC));
+    put_varint(out,VERSION);
+    put_varint(out,unsigned(_functions.size()));
+    for (size_t i = 0;i < _functions.size();++i) {
+        const function& f = _functions[i];
+        put_varint(out,unsigned(f.name.size()));
+        out += f.name;
+        put_varint(out,unsigned(f.params.size()));
+        for (size_t j = 0;j < f.params.size();++j)
+            out += char(type_code(f.params[j]));
+        out += char(type_code(f.type));
+        put_varint(out,unsigned(f.registers));
+        put_varint(out,unsigned(f.size));
+        for (int p = f.entry;p < f.entry+f.size;) {
+            const char* k = OPERANDS[_code[p]];
+            put_varint(out,unsigned(_code[p++]));
+            for (;*k != '\0';++k,++p)
+                put_varint(out,*k=='i' ? zigzag(_code[p]) : *k=='t' ? unsigned(_code[p]-f.entry) : unsigned(_code[p]));
+        }
+    }
+    output.write(out.data(),out.size());
+}
+void bytecode_module::read(istream& input)
+{
+    string data((istreambuf_iterator<char>(input)),istreambuf_iterator<char>());
+    reader in(data);
+    if (memcmp(in.bytes(sizeof(MAGIC)),MAGIC,sizeof(MAGIC)) != 0)
+        throw bytecode_error("not a bytecode file");
+    if (in.varint() != VERSION)
+        throw bytecode_error("bytecode file has an unsupported version");
+    _functions.clear();
+    _functionmap.clear();
+    _code.clear();
+    int count = in.count(data.size());
+    for (int i = 0;i < count;++i) {
+        function f;
+        int length = in.count(data.size());
+        f.name.assign(in.bytes(length),length);
+        int nparams = in.count(data.size());
+        for (int j = 0;j <= nparams;++j) {
+            unsigned t = (unsigned char)*in.bytes(1);
+            if (t >= 4)
+                throw bytecode_error("bad bytecode file: bad type in function '%s'",f.name.c_str());
+            if (j < nparams)
+                f.params.push_back(TYPES[t]);
+            else
+                f.type = TYPES[t];
+        }
+        f.registers = in.count(MAX_REGISTERS);
+        f.size = in.count(data.size());
+        f.entry = int(_code.size());
+        for (int p = 0;p < f.size;) {
+            unsigned op = in.varint();
+            if (op >= bc_opcode_count)
+                throw bytecode_error("bad bytecode file: bad instruction in function '%s'",f.name.c_str());
+            _code.push_back(int(op));
+            ++p;
+            for (const char* k = OPERANDS[op];*k != '\0';++k,++p) {
+                unsigned v = in.varint();
+                _code.push_back(*k=='i' ? int((v>>1) ^ (0u-(v&1))) : *k=='t' ? f.entry+int(v) : int(v));
+            }
+        }
+        _functions.push_back(f);
+        _functionmap.insert( make_pair(f.name,i) );
+    }
+    if ( !in.done() )
+        throw bytecode_error("bad bytecode file: data after the last function");
+    for (int i = 0;i < count;++i)
+        verify(_functions[i]);
+}
+/*static*/ bool bytecode_module::is_bytecode(istream& input)
+{
+    char magic[sizeof(MAGIC)];
+    streampos pos = input.tellg();
+    input.read(magic,sizeof(magic));
+    bool b = input.gcount()==streamsize(sizeof(magic)) && memcmp(magic,MAGIC,sizeof(magic))==0;
+    input.clear();
+    input.seekg(pos);
+    return b;
+}
+int bytecode_module::find_function(const char* name) const
+{
+    unordered_map<string,int>::const_iterator it = _functionmap.find(name);
+    return it != _functionmap.end() ? it->second : -1;
+}
+/*static*/ const char* bytecode_module::operands(bytecode_opcode op)
+{
+    return OPERANDS[op];
+}
+void bytecode_module::verify(const function& f) const
+{
+    // the interpreter checks nothing that can be checked here: every operand must be in
+    // range, every jump must land on an instruction, and the code must not run off its end
+    const char* name = f.name.c_str();
+    vector<bool> starts(f.size+1,false);
+    int p, op = bc_ret;
+    if (f.registers < int(f.params.size()))
+        throw bytecode_error("bad bytecode file: function '%s' has too few registers",name);
+    for (p = f.entry;p < f.entry+f.size;p += 1+int(strlen(OPERANDS[op]))) {
+        op = _code[p];
+        starts[p-f.entry] = true;
+    }
+    if (p != f.entry+f.size || f.size==0 || (op!=bc_ret && op!=bc_jmp))
+        throw bytecode_error("bad bytecode file: function '%s' does not end with a return or a jump",name);
+    for (p = f.entry;p < f.entry+f.size;) {
+        op = _code[p++];
+        for (const char* k = OPERANDS[op];*k != '\0';++k,++p) {
+            int v = _code[p];
+            bool bad = false;
+            if (*k=='d' || *k=='a' || *k=='b')
+                bad = v<0 || v>=f.registers;
+            else if (*k == 't')
+                bad = v<f.entry || v>=f.entry+f.size || !starts[v-f.entry];
+            else if (*k == 'f')
+                bad = v<0 || v>=int(_functions.size());
+            if (bad)
+                throw bytecode_error("bad bytecode file: operand out of range in function '%s'",name);
+        }
+        if (op == bc_call) {
+            // the arguments must be within the caller's frame
+            const function& callee = _functions[_code[p-2]];
+            if (_code[p-1] > f.registers-int(callee.params.size()))
+                throw bytecode_error("bad bytecode file: operand out of range in function '%s'",name);
+        }
+    }
+}
+
+// bytecode generation for flat_ast: each function's parameters are its first
+// registers, then each declaration has a register of its own, and the registers
+// above those hold the values of the expressions being evaluated
+
+void flat_ast::generate_bytecode(bytecode_module& module)
+{
+    for (size_t i = 0;i < _functions.size();++i) {
+        const flat_symbol& f = _symbols[_functions[i].symb];
+        module.declare_function(f.id.source(),f.id.source_length(),f.argtypes_ptr,f.type);
+    }
+    // note the expressions that contain an assignment: an operand read from a variable's
+    // register must be copied before a later operand can assign to the variable (the
+    // operands of an expression are after it in the array, so one pass back suffices)
+    _assigns.assign(_expressions.size(),false);
+    for (int e = int(_expressions.size())-1;e >= 0;--e) {
+        const expression_node& x = _expressions[e];
+        bool b = x.kind == ast_expression_node::ast_assignment_expression;
+        if (x.kind != ast_expression_node::ast_primary_expression)
+            for (int i = x.a;i < x.a+x.b && !b;++i)
+                b = _assigns[i];
+        _assigns[e] = b;
+    }
+    for (int i = 0;i < int(_functions.size());++i) {
+        const function_node& fn = _functions[i];
+        module.begin_function(i);
+        for (int p = fn.params.first;p < fn.params.first+fn.params.count;++p) {
+            // a parameter is read as its type, whatever the caller passed
+            int r = p - fn.params.first;
+            _symbols[p].set_offset(r);
+            if (_symbols[p].type == token_small)
+                module.emit(bc_sx16,r,r);
+            else if (_symbols[p].type == token_boo)
+                module.emit(bc_sx8,r,r);
+        }
+        bytecode_statements(module,fn.body);
+        // a function that ends without a 'toss' returns zero
+        int r = module.allocate_register();
+        module.emit(bc_ldi,r,0);
+        module.emit(bc_ret,r);
+        module.end_function();
+    }
+}
+void flat_ast::bytecode_statements(bytecode_module& module,range body)
+{
+    // the blocks being visited are kept on '_walk' (as in codegen_statements); unlike the
+    // native code, a loop tests its condition at the bottom, so each iteration takes one jump
+    size_t base = _walk.size();
+    open_block(body,block_function,-1);
+    while (_walk.size() > base) {
+        if (_walk.back().next < _walk.back().last) {
+            int i = _walk.back().next++;
+            const statement_node& s = _statements[i];
+            int mark = module.register_mark();
+            switch (s.kind) {
+            case ast_statement_node::ast_declaration_statement:
+                {
+                    flat_symbol& decl = _symbols[s.a];
+                    decl.set_offset( module.allocate_register() );
+                    mark = module.register_mark();
+                    if (s.b >= 0)
+                        bytecode_store(module,decl,bytecode_expression(module,s.b,-1),mark);
+                }
+                break;
+            case ast_statement_node::ast_expression_statement:
+                bytecode_expression(module,s.a,-1);
+                break;
+            case ast_statement_node::ast_selection_statement:
+                {
+                    int lblnext = module.new_label(), lbldone = module.new_label();
+                    bytecode_condition(module,s.a,lblnext,false);
+                    walk_frame& w = open_block(s.body,block_if,i);
+                    w.labels[0] = lblnext;
+                    w.labels[1] = lbldone;
+                }
+                break;
+            case ast_statement_node::ast_iterative_statement:
+                {
+                    int lbltop = module.new_label(), lbltest = module.new_label(), lbldone = module.new_label();
+                    module.emit(bc_jmp,lbltest);
+                    module.label(lbltop);
+                    walk_frame& w = open_block(s.body,block_loop,i);
+                    w.labels[0] = lbltop;
+                    w.labels[1] = lbltest;
+                    w.labels[2] = lbldone;
+                }
+                break;
+            case ast_statement_node::ast_jump_statement:
+                if (s.a >= 0) // toss
+                    module.emit(bc_ret,bytecode_expression(module,s.a,-1));
+                else { // smash: leave the innermost loop
+                    size_t k = _walk.size();
+                    while (_walk[--k].step != block_loop)
+                        ;
+                    module.emit(bc_jmp,_walk[k].labels[2]);
+                }
+                break;
+            }
+            module.release_registers(mark);
+            continue;
+        }
+        // the block has ended: continue its statement
+        walk_frame w = _walk.back();
+        _walk.pop_back();
+        switch (w.step) {
+        case block_if:
+            {
+                // the body of the if or an elf ended: test the next elf, or run the else-body
+                const statement_node& s = _statements[w.node];
+                int elf = w.elf < 0 ? s.b : _statements[w.elf].b;
+                if (elf>=0 || s.other.count>0)
+                    module.emit(bc_jmp,w.labels[1]);
+                module.label(w.labels[0]);
+                if (elf >= 0) {
+                    const statement_node& e = _statements[elf];
+                    int lblnext = module.new_label();
+                    bytecode_condition(module,e.a,lblnext,false);
+                    walk_frame& next = open_block(e.body,block_if,w.node);
+                    next.elf = elf;
+                    next.labels[0] = lblnext;
+                    next.labels[1] = w.labels[1];
+                }
+                else {
+                    walk_frame& other = open_block(s.other,block_else,w.node);
+                    other.labels[1] = w.labels[1];
+                }
+            }
+            break;
+        case block_else:
+            module.label(w.labels[1]);
+            break;
+        case block_loop:
+            module.label(w.labels[1]);
+            bytecode_condition(module,_statements[w.node].a,w.labels[0],true);
+            module.label(w.labels[2]);
+            break;
+        }
+    }
+}
+void flat_ast::bytecode_condition(bytecode_module& module,int e,int label,bool when)
+{
+    // jump to 'label' if the condition is 'when': a comparison jumps on its operands, and
+    // 'not', 'and' and 'or' become jumps, so no truth value is computed; the conditions
+    // left to test are kept on '_conditions' instead of recursing
+    size_t base = _conditions.size();
+    condition_item item = { e, label, when };
+    _conditions.push_back(item);
+    do {
+        item = _conditions.back();
+        _conditions.pop_back();
+        if (item.e < 0) {
+            module.label(item.label);
+            continue;
+        }
+        e = item.e;
+        when = item.when;
+        while (_expressions[e].kind==ast_expression_node::ast_prefix_expression && _expressions[e].op==token_not) {
+            e = _expressions[e].a;
+            when = !when;
+        }
+        const expression_node& x = _expressions[e];
+        if (x.kind==ast_expression_node::ast_logical_or_expression || x.kind==ast_expression_node::ast_logical_and_expression) {
+            // 'or' is true if any operand is true; 'and' is false if any operand is false: each
+            // such operand jumps to the label, and otherwise the last operand decides
+            bool isor = x.kind == ast_expression_node::ast_logical_or_expression;
+            condition_item next = { -1, module.new_label(), false };
+            if (isor != when)
+                _conditions.push_back(next);
+            for (int i = x.a+x.b-1;i >= x.a;--i) {
+                condition_item operand = { i, item.label, when };
+                if (isor!=when && i<x.a+x.b-1) {
+                    operand.label = next.label;
+                    operand.when = !when;
+                }
+                _conditions.push_back(operand);
+            }
+            continue;
+        }
+        int mark = module.register_mark();
+        if (x.kind==ast_expression_node::ast_equality_expression || x.kind==ast_expression_node::ast_relational_expression) {
+            // (the right operand is first, and is evaluated first as in the native code)
+            int a = x.a, b = x.a+1, k = MIRROR[comparison(x.op)], value;
+            if (bytecode_literal(a,value) && !bytecode_literal(b,value)) { // (a literal has no effects to reorder)
+                swap(a,b);
+                k = MIRROR[k];
+            }
+            if ( !when )
+                k = INVERSE[k];
+            int ra = bytecode_expression(module,a,_assigns[b] ? module.allocate_register() : -1);
+            if ( bytecode_literal(b,value) )
+                module.emit(bytecode_opcode(bc_jeqi+k),ra,value,item.label);
+            else
+                module.emit(bytecode_opcode(bc_jeq+k),ra,bytecode_expression(module,b,-1),item.label);
+        }
+        else if (x.kind==ast_expression_node::ast_primary_expression && x.op!=token_id && x.op!=token_number) {
+            if ((x.op==token_bool_true) == when)
+                module.emit(bc_jmp,item.label);
+        }
+        else
+            module.emit(when ? bc_jnz : bc_jz,bytecode_expression(module,e,-1),item.label);
+        module.release_registers(mark);
+    } while (_conditions.size() > base);
+}
+int flat_ast::bytecode_expression(bytecode_module& module,int e,int dst)
+{
+    // generate the expression and return the register that holds its value: 'dst' unless
+    // it is -1, in which case a variable is read from its own register; the expressions
+    // being visited are kept on '_walk' (see bytecode_step)
+    size_t base = _walk.size();
+    int value = -1;
+    _walk.push_back( walk_frame(e) );
+    _walk.back().dst = dst;
+    do {
+        int operand = bytecode_step(module,_walk.back(),value,dst);
+        if (operand >= 0) {
+            _walk.push_back( walk_frame(operand) );
+            _walk.back().dst = dst;
+        }
+        else
+            _walk.pop_back();
+    } while (_walk.size() > base);
+    return value;
+}
+int flat_ast::bytecode_step(bytecode_module& module,walk_frame& w,int& value,int& dst)
+{
+    // generate code for the expression up to its next operand and return the operand (with
+    // the register it must be left in, or -1, in 'dst'), or finish the expression and return
+    // -1; 'value' is the register of the operand finished last, then of this expression
+    const expression_node& x = _expressions[w.node];
+    const int first = x.a, last = first + x.b;
+    const int step = w.step++;
+    dst = -1;
+    if (step==0 && x.kind!=ast_expression_node::ast_primary_expression && x.kind!=ast_expression_node::ast_assignment_expression) {
+        // the result register, then the registers in use before the operands
+        w.acc = w.dst>=0 ? w.dst : module.allocate_register();
+        w.mark = module.register_mark();
+    }
+    switch (x.kind) {
+    case ast_expression_node::ast_assignment_expression:
+        if (step == 0) {
+            w.mark = module.register_mark();
+            return first+1;
+        }
+        bytecode_store(module,_symbols[_expressions[first].b],value,w.mark);
+        module.release_registers(w.mark);
+        value = _symbols[_expressions[first].b].get_offset();
+        break;
+    case ast_expression_node::ast_logical_or_expression:
+    case ast_expression_node::ast_logical_and_expression:
+        {
+            // or: any non-zero operand jumps to set 1; and: any zero operand jumps to set 0
+            bool isor = x.kind == ast_expression_node::ast_logical_or_expression;
+            if (step == 0) {
+                w.labels[0] = module.new_label();
+                w.next = first;
+                return first;
+            }
+            module.emit(isor ? bc_jnz : bc_jz,value,w.labels[0]);
+            module.release_registers(w.mark);
+            if (++w.next < last)
+                return w.next;
+            int lbldone = module.new_label();
+            module.emit(bc_ldi,w.acc,isor ? 0 : 1);
+            module.emit(bc_jmp,lbldone);
+            module.label(w.labels[0]);
+            module.emit(bc_ldi,w.acc,isor ? 1 : 0);
+            module.label(lbldone);
+            value = w.acc;
+        }
+        break;
+    case ast_expression_node::ast_equality_expression:
+    case ast_expression_node::ast_relational_expression:
+        if (step == 0) {
+            if ( _assigns[first+1] )
+                dst = module.allocate_register();
+            return first;
+        }
+        if (step == 1) {
+            w.lhs = value;
+            return first+1;
+        }
+        module.emit(bytecode_opcode(bc_eq+MIRROR[comparison(x.op)]),w.acc,w.lhs,value); // (the right operand is first)
+        module.release_registers(w.mark);
+        value = w.acc;
+        break;
+    case ast_expression_node::ast_additive_expression:
+    case ast_expression_node::ast_multiplicative_expression:
+        if (step == 0) {
+            if ( _assigns[first+1] )
+                dst = module.allocate_register();
+            w.next = first;
+            return first;
+        }
+        if (step == 1)
+            w.lhs = value;
+        else {
+            const int infix = _expressions[w.next].infix;
+            bytecode_opcode op = infix==token_add ? bc_add : infix==token_subtract ? bc_sub
+                : infix==token_multiply ? bc_mul : infix==token_divide ? bc_div : bc_mod;
+            module.emit(op,w.acc,w.lhs,value);
+            module.release_registers(w.mark);
+            w.lhs = w.acc;
+        }
+        while (++w.next < last) {
+            // add or subtract a literal as an immediate
+            const int infix = _expressions[w.next].infix;
+            int imm;
+            if (!bytecode_literal(w.next,imm) || (infix!=token_add && infix!=token_subtract))
+                return w.next;
+            module.emit(bc_addi,w.acc,w.lhs,infix==token_add ? imm : int(0u-unsigned(imm)));
+            w.lhs = w.acc;
+        }
+        value = w.acc;
+        break;
+    case ast_expression_node::ast_prefix_expression:
+        if (step == 0)
+            return first;
+        module.emit(x.op==token_not ? bc_not : bc_neg,w.acc,value);
+        module.release_registers(w.mark);
+        value = w.acc;
+        break;
+    case ast_expression_node::ast_postfix_expression:
+        if (step == 0) {
+            // the arguments are left in the registers where the callee's frame begins,
+            // and are evaluated last to first (as the native code pushes them)
+            w.lhs = module.register_mark();
+            for (int i = first+1;i < last;++i)
+                module.allocate_register();
+            w.next = last;
+        }
+        if (--w.next > first) {
+            dst = w.lhs + (w.next-first-1);
+            return w.next;
+        }
+        module.emit(bc_call,w.acc,_expressions[first].b,w.lhs);
+        module.release_registers(w.mark);
+        value = w.acc;
+        break;
+    case ast_expression_node::ast_primary_expression:
+        if (x.op == token_id)
+            value = _symbols[x.b].get_offset();
+        else {
+            int imm;
+            bytecode_literal(w.node,imm);
+            value = w.dst>=0 ? w.dst : module.allocate_register();
+            module.emit(bc_ldi,value,imm);
+        }
+        break;
+    }
+    if (w.dst>=0 && value!=w.dst) {
+        module.emit(bc_mov,w.dst,value);
+        value = w.dst;
+    }
+    return -1;
+}
+void flat_ast::bytecode_store(bytecode_module& module,const flat_symbol& var,int value,int mark)
+{
+    // store 'value' in a variable, narrowed to its type; a value computed into a register
+    // above 'mark' (one that is no longer needed) is computed into the variable instead
+    int r = var.get_offset();
+    if (var.type == token_small)
+        module.emit(bc_sx16,r,value);
+    else if (var.type == token_boo)
+        module.emit(bc_sx8,r,value);
+    else if (value!=r && (value<mark || !module.retarget(value,r)))
+        module.emit(bc_mov,r,value);
+}
+bool flat_ast::bytecode_literal(int e,int& value) const
+{
+    // get the value of a literal (false if the expression is not one); a number is read
+    // as the native code has the assembler read it (a leading zero is octal), truncated
+    // to 32 bits, and 'false' and 'true' are 0 and 1
+    const expression_node& x = _expressions[e];
+    if (x.kind != ast_expression_node::ast_primary_expression || x.op == token_id)
+        return false;
+    if (x.op != token_number) {
+        value = x.op == token_bool_true;
+        return true;
+    }
+    const token& tok = _tokens[x.a];
+    const char* p = tok.source(), *end = p + tok.source_length();
+    unsigned base = 10, n = 0;
+    if (end-p>1 && p[0]=='0') {
+        base = 8;
+        ++p;
+    }
+    for (;p < end;++p) {
+        unsigned d = unsigned(*p - '0');
+        if (d >= base)
+            throw bytecode_error("line %d: bad number '%.*s'",x.lineno,tok.source_length(),tok.source());
+        n = n*base + d;
+    }
+    value = int(n);
+    return true;
+}
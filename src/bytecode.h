@@ -0,0 +1,161 @@
+/* bytecode.h - register-based bytecode and its interpreter */
+#ifndef BYTECODE_H
+#define BYTECODE_H
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "lexer.h" // gets token_t and ramsey-error.h
+
+namespace ramsey
+{
+    class bytecode_error : public compiler_error_generic // errors reported to user
+    {
+    public:
+        bytecode_error(const char* format, ...);
+        virtual ~bytecode_error() throw() {}
+    };
+
+    /* each instruction is its opcode followed by its operands, one word each:
+       d is the register written, a and b are registers read, i is an immediate,
+       t is a jump target and f a function; registers are numbered within the
+       frame of the function, whose parameters are its first registers; a
+       register holds 32 bits, and a value is narrowed (sign-extended from its
+       low bits) when it is stored in a 'small' or 'boo' variable */
+    enum bytecode_opcode
+    {
+        bc_ldi, // d i: load an immediate
+        bc_mov, // d a
+        bc_sx16, // d a: narrow to 'small'
+        bc_sx8, // d a: narrow to 'boo'
+        bc_neg, // d a
+        bc_not, // d a: 1 if a is zero, else 0
+        bc_add, bc_sub, bc_mul, bc_div, bc_mod, // d a b
+        bc_addi, // d a i
+        bc_eq, bc_ne, bc_lt, bc_gt, bc_le, bc_ge, // d a b: 1 if the comparison holds, else 0
+        bc_jmp, // t
+        bc_jz, bc_jnz, // a t: jump if a is zero (nonzero)
+        bc_jeq, bc_jne, bc_jlt, bc_jgt, bc_jle, bc_jge, // a b t: jump if the comparison holds
+        bc_jeqi, bc_jnei, bc_jlti, bc_jgti, bc_jlei, bc_jgei, // a i t
+        bc_call, // d f a: call f with its arguments in the registers from a (where its frame begins)
+        bc_ret, // a
+        bc_opcode_count
+    };
+
+    /* bytecode_module: the functions of a program in bytecode; a module is
+       built one function at a time (much as an elf_object is encoded), or
+       read from the file format that it writes: the file holds each function's
+       signature and frame size, and its instructions with every word written
+       as a variable-length integer */
+    class bytecode_module
+    {
+    public:
+        struct function
+        {
+            std::string name;
+            std::vector<token_t> params;
+            token_t type; // return type
+            int registers; // size of the frame
+            int entry, size; // range of its code (in words)
+        };
+
+        bytecode_module();
+
+        // building: the functions are declared (in the order that calls refer to them), then
+        // built in any order; jumps take labels as targets; registers are allocated as a stack
+        int declare_function(const char* name,int length,const token_t* params,token_t type); // 'params' ends with token_invalid
+        void begin_function(int func);
+        int allocate_register();
+        int register_mark() const
+        { return _top; }
+        void release_registers(int mark) // free the registers allocated since 'mark'
+        { _top = mark; }
+        int new_label();
+        void label(int label);
+        void emit(bytecode_opcode op,int x = 0,int y = 0,int z = 0);
+        bool retarget(int from,int to); // make the last instruction write 'to' instead (if it writes 'from')
+        void end_function();
+
+        void write(std::ostream& output) const;
+        void read(std::istream& input); // throws bytecode_error if the input is not a valid module
+        static bool is_bytecode(std::istream& input); // does the input begin as a module does (the position is kept)
+
+        int function_count() const
+        { return int(_functions.size()); }
+        const function& get_function(int i) const
+        { return _functions[i]; }
+        int find_function(const char* name) const; // -1 if there is no such function
+        const std::vector<int>& code() const
+        { return _code; }
+        static const char* operands(bytecode_opcode op); // operand kinds of an instruction (see above)
+    private:
+        std::vector<function> _functions;
+        std::unordered_map<std::string,int> _functionmap;
+        std::vector<int> _code;
+
+        // the function being built
+        int _function;
+        int _top;
+        int _last; // position of the last instruction (or -1)
+        int _bound; // position where a label was last bound
+        std::vector<int> _labels; // position of each label (or -1)
+        std::vector<int> _fixups; // positions that hold a label to be resolved
+
+        void verify(const function& f) const;
+
+        // disallow copying
+        bytecode_module(const bytecode_module&);
+        bytecode_module& operator =(const bytecode_module&);
+    };
+
+    /* bytecode_interpreter: runs the code of a module, which it first threads:
+       each opcode is replaced with the address of the code that executes it and
+       each jump target and function with a pointer, so that (given GNU C++)
+       each instruction dispatches the next one with a single indirect jump
+       and no decoding; other compilers dispatch with a switch */
+    class bytecode_interpreter
+    {
+    public:
+        bytecode_interpreter(const bytecode_module& module); // 'module' must outlive this
+        ~bytecode_interpreter();
+
+        // call function 'name' with the arguments; throws bytecode_error on a runtime error
+        int call(const char* name,const std::vector<int>& args);
+    private:
+        struct callee;
+        union slot
+        {
+            const void* handler;
+            const slot* target;
+            const callee* function;
+            int operand;
+        };
+        struct callee
+        {
+            const slot* entry;
+            int registers, params;
+        };
+        struct frame
+        {
+            const slot* pc; // return address
+            int* regs;
+            int dst;
+        };
+
+        const bytecode_module& _module;
+        const void* const* _handlers; // the address of the code for each opcode (see 'run')
+        std::vector<slot> _code;
+        std::vector<callee> _callees;
+        int* _registers; // the frames of the calls in progress are stacked here
+        frame* _frames;
+
+        int run(const callee* func,int* regs); // given no function, this sets '_handlers'
+
+        // disallow copying
+        bytecode_interpreter(const bytecode_interpreter&);
+        bytecode_interpreter& operator =(const bytecode_interpreter&);
+    };
+}
+
+#endif
@@ -1,6 +1,12 @@
 /* codegen.cpp */
 #include "codegen.h"
 #include "ast.h"
+#include "flatast.h"
+#include "elfobj.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <deque>
+#include <sstream>
 #include <cstring>
 #include <cctype>
 using namespace std;
@@ -8,57 +14,65 @@ using namespace ramsey;
 
 // code_generator
 /*static*/ const int code_generator::REGISTER_WIDTH = 4;
-code_generator::code_generator(ostream& output)
+code_generator::code_generator(ostream& output,bool apart,elf_object* object)
     : _output(output), _alloc(0), _narg(0), _reghead(reg_invalid), _regnonvol(reg_EBX),
-      _regcnt(-1), _lbl(1), _retlbl(0)
+      _regcnt(-1), _lbl(apart ? 0 : 1), _retlbl(0), _apart(apart), _object(object)
 {
-    _before.flags(ios_base::left | _before.flags());
-    _body.flags(ios_base::left | _body.flags());
 }
 void code_generator::begin_function(const char* name)
 {
-#ifdef RAMSEY_WIN32
-    // MSWindows needs prefix underscore on symbol name
-    instruction_before(".globl _%s",name);
-    //instruction_before(".type _%s, @function",name); // MinGW doesn't like this by itself...
-    _before << '_' << name << ":\n";
-#elif RAMSEY_APPLE
-    instruction_before(".globl _%s",name);
-    _before << '_' << name << ":\n";
-#else // POSIX (GNU/LINUX)
-    instruction_before(".globl %s",name);
-    instruction_before(".type %s, @function",name);
-    _before << name << ":\n";
+    if (_apart)
+        _lbl = 0;
+    asm_operand symb = asm_sym(name,int(strlen(name)));
+    if (_object != NULL)
+        _object->begin_function(symb.text,symb.length);
+    else {
+        _before.append("\t.globl ",8);
+        append(_before,symb);
+        _before += '\n';
+#if !defined(RAMSEY_WIN32) && !defined(RAMSEY_APPLE) // POSIX (GNU/LINUX); MinGW doesn't like this by itself...
+        _before.append("\t.type  ",8);
+        append(_before,symb);
+        _before.append(", @function\n",12);
 #endif
-    instruction_impl(_before,"pushl\0%ebp");
-    instruction_impl(_before,"movl\0%esp, %ebp");
+        append(_before,symb);
+        _before.append(":\n",2);
+    }
+    emit_before(op_pushl,asm_reg("ebp"));
+    emit_before(op_movl,asm_reg("esp"),asm_reg("ebp"));
 }
 void code_generator::end_function()
 {
-    if (_retlbl > 0) {
-        _body << "lbl" << _retlbl << ":\n";
+    if (_retlbl != 0) {
+        emit_label(_retlbl);
         _retlbl = 0; // make sure to reset the label so another function will generate a new one
     }
     // do stack allocation for local variables; this value should be aligned at a 4-byte boundry
     if (_alloc > 0)
-        instruction_before("subl $%d, %%esp",_alloc);
+        emit_before(op_subl,asm_imm(_alloc),asm_reg("esp"));
     // save non-volatile registers
     for (int i = _regnonvol-1;i >= reg_EBX;--i)
-        instruction_before("pushl %%%s",register_to_string((_register)i,token_big));
+        emit_before(op_pushl,asm_reg(register_to_string((_register)i,token_big)));
     // restore non-volatile registers
     for (int i = reg_EBX;i < _regnonvol;++i)
-        instruction("popl %%%s",register_to_string((_register)i,token_big));
+        emit(op_popl,asm_reg(register_to_string((_register)i,token_big)));
     if (_alloc > 0)
         // do function stack cleanup with 'leave' instruction
-        instruction("leave");
+        emit(op_leave);
     else
         // do function stack cleanup (nothing besides restoring old EBP value)
-        instruction("popl %%ebp");
-    instruction("ret");
-    // place function preamble into output, then rest of function body
-    _output << _before.str() << _body.str() << endl;
-    // reset stringstream objects
-    _before.str(string()); _body.str(string());
+        emit(op_popl,asm_reg("ebp"));
+    emit(op_ret);
+    if (_object != NULL)
+        _object->end_function();
+    else {
+        // place function preamble into output, then rest of function body
+        _output.write(_before.data(),_before.size());
+        _output.write(_body.data(),_body.size());
+        _output.put('\n');
+        // reset the buffers (they keep their storage for the next function)
+        _before.clear(); _body.clear();
+    }
     // reset stack allocator
     for (short i = 0;i < 3;++i)
         _allocations[i] = queue<int>();
@@ -70,29 +84,36 @@ void code_generator::end_function()
     _regcnt = -1;
     // note: _lbl does not need to be reset as the labels are global to all functions
 }
-void code_generator::instruction(const char* format, ...)
+void code_generator::write_apart(const string& code,int nlabels)
 {
-    va_list vargs;
-    va_start(vargs,format);
-    instruction_impl(_body,format,vargs);
-    va_end(vargs);
+    // the labels of code generated apart are written "lbl-k" (an identifier cannot
+    // contain '-'), where the label is the k-th one the function allocated
+    size_t p = 0, q;
+    while ((q = code.find("lbl-",p)) != string::npos) {
+        _output.write(code.data()+p,q+3 - p);
+        int k = 0;
+        for (q += 4;q<code.size() && isdigit(code[q]);++q)
+            k = k*10 + (code[q]-'0');
+        _output << _lbl + k-1;
+        p = q;
+    }
+    _output.write(code.data()+p,code.size() - p);
+    _lbl += nlabels;
 }
-void code_generator::instruction_before(const char* format, ...)
+void code_generator::write_apart(elf_object& part)
 {
-    va_list vargs;
-    va_start(vargs,format);
-    instruction_impl(_before,format,vargs);
-    va_end(vargs);
+    // the labels of encoded code are resolved in each function
+    _object->append(part);
 }
-void code_generator::writeline(const char* format, ...)
+void code_generator::emit_label(int label)
 {
-    static const size_t BUFMAX = 4097;
-    va_list vargs;
-    char buffer[BUFMAX];
-    va_start(vargs,format);
-    vsnprintf(buffer,BUFMAX-1,format,vargs);
-    _body << buffer << '\n';
-    va_end(vargs);
+    if (_object != NULL) {
+        _object->label(label);
+        return;
+    }
+    _body.append("lbl",3);
+    append(_body,label);
+    _body.append(":\n",2);
 }
 int code_generator::next_variable_offset(token_t type)
 {
@@ -153,7 +174,7 @@ void code_generator::allocate_result_register()
     ++_regcnt;
     _reghead = (_register)(_regcnt % reg_end);
     if (_regcnt >= reg_end)
-        instruction("pushl %%%s",current_result_register());
+        emit(op_pushl,asm_reg(current_result_register()));
     else if (_regcnt>=reg_EBX && _regcnt<=reg_end && _regcnt>=_regnonvol) // we allocated a non-volatile register; its value will have to be saved
         _regnonvol = (_register)((int)_regcnt+1);
 }
@@ -164,7 +185,7 @@ void code_generator::deallocate_result_register()
         throw ramsey_exception("code_generator::deallocate_result_register");
 #endif
     if (_regcnt >= reg_end)
-        instruction("popl %%%s",current_result_register());
+        emit(op_popl,asm_reg(current_result_register()));
     --_regcnt;
     _reghead = _regcnt<0 ? reg_invalid : (_register)(_regcnt % reg_end);
 }
@@ -172,42 +193,81 @@ void code_generator::save_registers()
 {
     // save all volatile registers (don't include the current register)
     for (int i = 0;i<_reghead && i<reg_EBX;++i)
-        instruction("pushl %%%s",register_to_string((_register)i,token_big));
+        emit(op_pushl,asm_reg(register_to_string((_register)i,token_big)));
 }
 void code_generator::restore_registers()
 {
     // restore all volatile registers (don't include the current register)
     for (int i = _reghead<reg_EBX ? _reghead-1 : reg_EBX-1;i >= 0;--i)
-        instruction("popl %%%s",register_to_string((_register)i,token_big));
+        emit(op_popl,asm_reg(register_to_string((_register)i,token_big)));
 }
 int code_generator::get_return_label()
 {
-    if (_retlbl <= 0)
+    if (_retlbl == 0)
         _retlbl = get_unique_label();
     return _retlbl;
 }
-/*static*/ void code_generator::instruction_impl(ostream& output,const char* source)
-{
-    // 'source' must have 2 null bytes
-    output.put('\t');
-    output.width(7);
-    output << source; // output instruction
-    while (*source++); // find optional argument
-    output << source << '\n';
-}
-/*static*/ void code_generator::instruction_impl(ostream& output,const char* format,va_list vargs)
-{
-    static const size_t BUFMAX = 4098;
-    int len;
-    char buffer[BUFMAX];
-    len = vsnprintf(buffer,BUFMAX-2,format,vargs);
-    buffer[len+1] = 0; // write the (potential) second null byte
-    // section off the instruction 
-    int iter = 0;
-    while (buffer[iter] && !isspace(buffer[iter]))
-        ++iter;
-    buffer[iter++] = 0;
-    instruction_impl(output,buffer);
+void code_generator::encode(asm_opcode op,const asm_operand* a,const asm_operand* b,bool before)
+{
+    _object->encode(op,a,b,before);
+}
+/*static*/ void code_generator::append(string& out,asm_opcode op)
+{
+    // each mnemonic is preformatted: a tab, then the mnemonic left-justified
+    // in a field of 7 characters
+    static const char MNEMONICS[][9] = {
+        "\tpushl  ", "\tpush   ", "\tpopl   ",
+        "\tmovl   ", "\tmovw   ", "\tmovb   ", "\tmovswl ", "\tmovsbl ", "\tmovzbl ",
+        "\taddl   ", "\tsubl   ", "\timull  ", "\tidivl  ", "\tnegl   ", "\tcdq    ",
+        "\tcmp    ", "\tcmpl   ", "\tcmpw   ", "\tcmpb   ", "\tsete   ",
+        "\tjmp    ", "\tje     ", "\tjne    ", "\tjl     ", "\tjg     ", "\tjle    ", "\tjge    ",
+        "\tcall   ", "\tleave  ", "\tret    ", "\tnop    "
+    };
+    out.append(MNEMONICS[op],8);
+}
+/*static*/ void code_generator::append(string& out,const asm_operand& operand)
+{
+    switch (operand.kind) {
+    case asm_operand::operand_register:
+        out += '%';
+        out += operand.text;
+        break;
+    case asm_operand::operand_memory:
+        append(out,operand.value);
+        out.append("(%ebp)",6);
+        break;
+    case asm_operand::operand_immediate:
+        out += '$';
+        append(out,operand.value);
+        break;
+    case asm_operand::operand_literal:
+        out += '$';
+        out.append(operand.text,operand.length);
+        break;
+    case asm_operand::operand_label:
+        out.append("lbl",3);
+        append(out,operand.value);
+        break;
+    case asm_operand::operand_symbol:
+#if defined(RAMSEY_WIN32) || defined(RAMSEY_APPLE)
+        out += '_'; // MSWindows and Apple need prefix underscore on symbol name
+#endif
+        out.append(operand.text,operand.length);
+        break;
+    }
+}
+/*static*/ void code_generator::append(string& out,int value)
+{
+    // format the decimal digits from the last one back
+    char digits[12], *p = digits + sizeof(digits);
+    unsigned u = value < 0 ? 0u - unsigned(value) : unsigned(value);
+    do {
+        *--p = char('0' + u%10);
+        u /= 10;
+    } while (u != 0);
+    if (value < 0)
+        *--p = '-';
+    out.append(p,digits + sizeof(digits) - p);
 }
 /*static*/ const char* code_generator::register_to_string(_register r,token_t t)
 {
@@ -228,506 +288,1115 @@ int code_generator::get_return_label()
 
 // code generation implementation for AST node types
 
-/*static*/ const char* ast_expression_node::load_operand(const ast_expression_node::operand& op,stable& symtable,code_generator& cgen,bool alloc)
+void ast_node::generate_code(code_generator& cgen) const
+{
+    codegen_walk(cgen,ast_pass_frame(this));
+}
+void ast_node::generate_code(code_generator& cgen,thread_pool& pool) const
+{
+    /* each thread generates functions into a buffer with its own generator,
+       numbering each function's labels apart; the buffers are then written in
+       the order of the serial pass (last function to first), which renumbers
+       the labels just as the serial pass numbers them; this is done in batches
+       so that only a batch of functions is held in memory at a time; given an
+       object, each function is encoded into a part that is appended in turn */
+    struct apart_generator
+    {
+        apart_generator(bool encode)
+            : gen(code,true,encode ? &object : NULL) {}
+
+        ostringstream code;
+        elf_object object;
+        code_generator gen;
+    };
+    vector<const ast_function_node*> funcs;
+    for (const ast_function_node* f = static_cast<const ast_function_node*>(this);f != NULL;f = f->get_next())
+        funcs.push_back(f);
+    reverse(funcs.begin(),funcs.end());
+    bool encode = cgen.get_object() != NULL;
+    deque<apart_generator> gens;
+    for (int t = 0;t < pool.size();++t)
+        gens.emplace_back(encode);
+    int n = int(funcs.size()), batch = pool.size() * 16;
+    vector<string> code(batch);
+    vector<int> labels(batch);
+    vector<elf_object> parts(encode ? batch : 0);
+    for (int first = 0;first < n;first += batch) {
+        int count = min(batch,n - first);
+        pool.run_on_threads(count,[&](int i,int t) {
+            codegen_walk(gens[t].gen,function_frame(funcs[first+i]));
+            if (encode) {
+                parts[i].append(gens[t].object);
+                return;
+            }
+            code[i] = gens[t].code.str();
+            labels[i] = gens[t].gen.function_labels();
+            gens[t].code.str(string());
+        });
+        for (int i = 0;i < count;++i) {
+            if (encode)
+                cgen.write_apart(parts[i]);
+            else
+                cgen.write_apart(code[i],labels[i]);
+        }
+    }
+}
+void ast_node::check_and_generate(stable& symtable,code_generator& cgen) const
+{
+    // each function's subtree is visited by the code generator right after it is
+    // checked (while it is still in the cache); the functions must be declared first
+    vector<const ast_function_node*> funcs;
+    declare_functions(this,symtable,funcs);
+    for (size_t i = 0;i < funcs.size();++i)
+        funcs[i]->check_and_generate_function(symtable,cgen);
+}
+void ast_node::declare_functions(stable& symtable) const
+{
+    vector<const ast_function_node*> funcs;
+    declare_functions(this,symtable,funcs);
+}
+void ast_node::check_and_generate_function(stable& symtable,code_generator& cgen) const
+{
+    ast_pass_frame frame = function_frame(static_cast<const ast_function_node*>(this));
+    semantics_walk(symtable,frame);
+    codegen_walk(cgen,frame);
+}
+void ast_node::codegen_walk(code_generator& cgen,const ast_pass_frame& root)
+{
+    // visit the tree with an explicit stack of frames (see ast_pass_frame) so
+    // that the depth of the tree does not bound the native stack
+    vector<ast_pass_frame> frames;
+    frames.push_back(root);
+    do {
+        const ast_node* child = frames.back().node->codegen_impl(cgen,frames.back());
+        if (child != NULL)
+            frames.push_back( ast_pass_frame(child) );
+        else
+            frames.pop_back();
+    } while ( !frames.empty() );
+}
+
+/*static*/ const ast_node* ast_expression_node::load_operand(const ast_expression_node::operand& op,code_generator& cgen,bool alloc)
 {
     // loading an operand into a register is a very common operation performed by expression nodes
     if (alloc) // allocate a new register for the operand's evaluation
         cgen.allocate_result_register();
-    op.node->generate_code(symtable,cgen);
+    return op.node;
+}
+/*static*/ const char* ast_expression_node::loaded_register(const code_generator& cgen)
+{
     // return the register into which the operand was loaded
     return !cgen.expects_result() ? "eax" : cgen.current_result_register();
 }
 
-void ast_function_node::codegen_impl(stable& symtable,code_generator& cgen) const
-{
-    // add symbol and process all remaining functions
-    symtable.add(this);
-    if ( !end() )
-        get_next()->codegen_impl(symtable,cgen);
-    // generate code for function body
-    symtable.addScope();
-    symtable.enterFunction(this);
-    cgen.begin_function(_id->source_string());
-    { ast_parameter_node* n = _param;
-        while (n != NULL) {
-            n->generate_code(symtable,cgen);
-            n = n->get_next();
-        }
+// compare a statement condition against zero, leaving the flags set for a jump; if the
+// condition must be evaluated first, it is returned to be visited before 'end_condition'
+static const ast_node* begin_condition(const ast_expression_node* condition,code_generator& cgen,ast_pass_frame& frame)
+{
+    if (condition->get_kind()==ast_expression_node::ast_primary_expression && static_cast<const ast_primary_expression_node*>(condition)->is_identifier()) {
+        // if the condition is just an identifier, then it can be used directly
+        const symbol* sym = static_cast<const ast_primary_expression_node*>(condition)->get_symbol();
+        if (sym->get_type()==token_in || sym->get_type()==token_big)
+            cgen.emit(op_cmpl,asm_imm(0),asm_mem(sym->get_offset()));
+        else if (sym->get_type() == token_small)
+            cgen.emit(op_cmpw,asm_imm(0),asm_mem(sym->get_offset()));
+        else // token_boo
+            cgen.emit(op_cmpb,asm_imm(0),asm_mem(sym->get_offset()));
+        return NULL;
+    }
+    cgen.allocate_result_register(); // allocate a register for the result of the expression
+    frame.reg = cgen.current_result_register(); // this should always be EAX
+    return condition;
+}
+static void end_condition(code_generator& cgen,ast_pass_frame& frame)
+{
+    if (frame.reg != NULL) {
+        cgen.deallocate_result_register();
+        // the register value is still good since this is a statement condition
+        cgen.emit(op_cmpl,asm_imm(0),asm_reg(frame.reg));
     }
-    { ast_statement_node* n = _statements;
-        while (n != NULL) {
-            n->generate_code(symtable,cgen);
-            n = n->get_next();
+}
+
+const ast_node* ast_function_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
+{
+    const ast_function_node* f = static_cast<const ast_function_node*>(frame.current);
+    const ast_node* n;
+    while (true) {
+        switch (frame.step) {
+        case 0:
+            // the functions are emitted last to first
+            f = this;
+            while ( !f->end() )
+                f = f->get_next();
+            frame.current = f;
+            // fall through
+        case 1:
+            // generate code for function body
+            cgen.begin_function(f->_id.source_string().c_str());
+            frame.cursor = f->_param;
+            frame.step = 2;
+            // fall through
+        case 2:
+            if ((n = frame.next_item<ast_parameter_node>()) != NULL)
+                return n;
+            frame.cursor = f->_statements;
+            frame.step = 3;
+            // fall through
+        case 3:
+            if ((n = frame.next_item<ast_statement_node>()) != NULL)
+                return n;
+            cgen.end_function();
+            if (f == this)
+                return NULL;
+            // process the previous function
+            frame.current = f = f->get_prev();
+            frame.step = 1;
+            break;
         }
     }
-    cgen.end_function();
-    symtable.exitFunction();
-    symtable.remScope();
 }
-void ast_parameter_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_parameter_node::codegen_impl(code_generator& cgen,ast_pass_frame&) const
 {
     const_cast<ast_parameter_node*>(this)->set_offset( cgen.next_argument_offset() );
-    symtable.add(this);
+    return NULL;
 }
-void ast_declaration_statement_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_declaration_statement_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
 {
-    // get stack address offset
-    const_cast<ast_declaration_statement_node*>(this)->set_offset( cgen.next_variable_offset(_typespec->type()) );
-    // do initializer assignment
-    if (_initializer != NULL) {
-        token_t type = get_type();
-        cgen.allocate_result_register();
-        _initializer->generate_code(symtable,cgen);
-        if (type==token_in || type==token_big)
-            cgen.instruction("movl %%%s, %d(%%ebp)",cgen.current_result_register(type),get_offset());
-        else if (type == token_small)
-            cgen.instruction("movw %%%s, %d(%%ebp)",cgen.current_result_register(type),get_offset());
-        else // token_boo
-            cgen.instruction("movb %%%s, %d(%%ebp)",cgen.current_result_register(type),get_offset());
-        cgen.deallocate_result_register();
+    if (frame.step++ == 0) {
+        // get stack address offset
+        const_cast<ast_declaration_statement_node*>(this)->set_offset( cgen.next_variable_offset(_typespec.type()) );
+        // do initializer assignment
+        if (_initializer != NULL)
+            cgen.allocate_result_register();
+        return _initializer;
     }
-    // add symbol after assignment
-    symtable.add(this);
+    token_t type = get_type();
+    if (type==token_in || type==token_big)
+        cgen.emit(op_movl,asm_reg(cgen.current_result_register(type)),asm_mem(get_offset()));
+    else if (type == token_small)
+        cgen.emit(op_movw,asm_reg(cgen.current_result_register(type)),asm_mem(get_offset()));
+    else // token_boo
+        cgen.emit(op_movb,asm_reg(cgen.current_result_register(type)),asm_mem(get_offset()));
+    cgen.deallocate_result_register();
+    return NULL;
 }
-void ast_selection_statement_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_selection_statement_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
 {
-    int lbltrue = cgen.get_unique_label(), lbldone = cgen.get_unique_label();
-    // load condition into a register
-    if (_condition->get_kind()==ast_expression_node::ast_primary_expression && static_cast<ast_primary_expression_node*>(_condition)->is_identifier()) {
-        // if the condition is just an identifier, then it can be used directly
-        const symbol* sym = symtable.getSymbol(static_cast<ast_primary_expression_node*>(_condition)->name());
-        if (sym->get_type()==token_in || sym->get_type()==token_big)
-            cgen.instruction("cmpl $0, %d(%%ebp)",sym->get_offset());
-        else if (sym->get_type() == token_small)
-            cgen.instruction("cmpw $0, %d(%%ebp)",sym->get_offset());
-        else // token_boo
-            cgen.instruction("cmpb $0, %d(%%ebp)",sym->get_offset());
-    }
-    else {
-        const char* reg;
-        cgen.allocate_result_register(); // allocate a register for the result of the expression
-        reg = cgen.current_result_register(); // this should always be EAX
-        _condition->generate_code(symtable,cgen);
-        cgen.deallocate_result_register();
-        // the register value is still good since this is an if-statement condition
-        cgen.instruction("cmpl $0, %%%s",reg);
-    }
-    // jump to the true block if condition was non-zero
-    cgen.instruction("jne lbl%d",lbltrue);
-    // otherwise the control falls through to hit an elf or else block (if any)
-    cgen.add_store_label(lbldone); // store done label so elf block can jump over other case blocks
-    if (_elf != NULL)
-        _elf->generate_code(symtable,cgen);
-    cgen.remove_store_label();
-    if (_else != NULL)
-        _else->generate_code(symtable,cgen);
-    cgen.instruction("jmp lbl%d",lbldone); // jump over true block to done label
-    cgen.writeline("lbl%d:",lbltrue);
-    if (_body == NULL)
-        cgen.instruction("nop"); // empty statement body, issue nop
-    else {
+    int& lbltrue = frame.labels[0], &lbldone = frame.labels[1];
+    const ast_node* n;
+    switch (frame.step) {
+    case 0:
+        lbltrue = cgen.get_unique_label(); lbldone = cgen.get_unique_label();
+        // load condition into a register
+        frame.step = 1;
+        if ((n = begin_condition(_condition,cgen,frame)) != NULL)
+            return n;
+        // fall through
+    case 1:
+        end_condition(cgen,frame);
+        // jump to the true block if condition was non-zero
+        cgen.emit(op_jne,asm_lbl(lbltrue));
+        // otherwise the control falls through to hit an elf or else block (if any)
+        cgen.add_store_label(lbldone); // store done label so elf block can jump over other case blocks
+        frame.step = 2;
+        if (_elf != NULL)
+            return _elf;
+        // fall through
+    case 2:
+        cgen.remove_store_label();
+        frame.step = 3;
+        if (_else != NULL)
+            return _else;
+        // fall through
+    case 3:
+        cgen.emit(op_jmp,asm_lbl(lbldone)); // jump over true block to done label
+        cgen.emit_label(lbltrue);
+        if (_body == NULL)
+            cgen.emit(op_nop); // empty statement body, issue nop
         // insert code for function body
-        ast_statement_node* n = _body;
-        do {
-            n->generate_code(symtable,cgen);
-            n = n->get_next();
-        } while (n != NULL);
+        frame.cursor = _body;
+        frame.step = 4;
+        // fall through
+    case 4:
+        if ((n = frame.next_item<ast_statement_node>()) != NULL)
+            return n;
+        // define done label past true block
+        cgen.emit_label(lbldone);
     }
-    // define done label past true block
-    cgen.writeline("lbl%d:",lbldone);
+    return NULL;
 }
-void ast_elf_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_elf_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
 {
-    int lbldone = cgen.get_store_label(); // get jump location from parent node
-    int lblfalse = cgen.get_unique_label();
-    // load condition into a register
-    if (_condition->get_kind()==ast_expression_node::ast_primary_expression && static_cast<ast_primary_expression_node*>(_condition)->is_identifier()) {
-        // if the condition is just an identifier, then it can be used directly
-        const symbol* sym = symtable.getSymbol(static_cast<ast_primary_expression_node*>(_condition)->name());
-        if (sym->get_type()==token_in || sym->get_type()==token_big)
-            cgen.instruction("cmpl $0, %d(%%ebp)",sym->get_offset());
-        else if (sym->get_type() == token_small)
-            cgen.instruction("cmpw $0, %d(%%ebp)",sym->get_offset());
-        else // token_boo
-            cgen.instruction("cmpb $0, %d(%%ebp)",sym->get_offset());
+    int& lblfalse = frame.labels[0], &lbldone = frame.labels[1];
+    const ast_node* n;
+    switch (frame.step) {
+    case 0:
+        lbldone = cgen.get_store_label(); // get jump location from parent node
+        lblfalse = cgen.get_unique_label();
+        // load condition into a register
+        frame.step = 1;
+        if ((n = begin_condition(_condition,cgen,frame)) != NULL)
+            return n;
+        // fall through
+    case 1:
+        end_condition(cgen,frame);
+        // jump to the false block if value was zero
+        cgen.emit(op_je,asm_lbl(lblfalse));
+        frame.cursor = _body;
+        frame.step = 2;
+        // fall through
+    case 2:
+        if ((n = frame.next_item<ast_statement_node>()) != NULL)
+            return n;
+        cgen.emit(op_jmp,asm_lbl(lbldone));
+        // otherwise test another elf (if any) and let control fall through
+        cgen.emit_label(lblfalse);
+        frame.step = 3;
+        return _elf;
     }
-    else {
-        const char* reg;
-        cgen.allocate_result_register(); // allocate a register for the result of the expression
-        reg = cgen.current_result_register(); // this should always be EAX
-        _condition->generate_code(symtable,cgen);
-        cgen.deallocate_result_register();
-        // the register value is still good since this is an if-statement condition
-        cgen.instruction("cmpl $0, %%%s",reg);
-    }
-    // jump to the false block if value was zero
-    cgen.instruction("je lbl%d",lblfalse);
-    ast_statement_node* n = _body;
-    while (n != NULL) {
-        n->generate_code(symtable,cgen);
-        n = n->get_next();
-    }
-    cgen.instruction("jmp lbl%d",lbldone);
-    // otherwise test another elf (if any) and let control fall through
-    cgen.writeline("lbl%d:",lblfalse);
-    if (_elf != NULL)
-        _elf->generate_code(symtable,cgen);
-}
-void ast_iterative_statement_node::codegen_impl(stable& symtable,code_generator& cgen) const
-{
-    int lbltop = cgen.get_unique_label(), lbldone = cgen.get_unique_label();
-    // add label for top of loop body
-    cgen.writeline("lbl%d:",lbltop);
-    // load condition into a register
-    if (_condition->get_kind()==ast_expression_node::ast_primary_expression && static_cast<ast_primary_expression_node*>(_condition)->is_identifier()) {
-        // if the condition is just an identifier, then it can be used directly
-        const symbol* sym = symtable.getSymbol(static_cast<ast_primary_expression_node*>(_condition)->name());
-        if (sym->get_type()==token_in || sym->get_type()==token_big)
-            cgen.instruction("cmpl $0, %d(%%ebp)",sym->get_offset());
-        else if (sym->get_type() == token_small)
-            cgen.instruction("cmpw $0, %d(%%ebp)",sym->get_offset());
-        else // token_boo
-            cgen.instruction("cmpb $0, %d(%%ebp)",sym->get_offset());
+    return NULL;
+}
+const ast_node* ast_iterative_statement_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
+{
+    int& lbltop = frame.labels[0], &lbldone = frame.labels[1];
+    const ast_node* n;
+    switch (frame.step) {
+    case 0:
+        lbltop = cgen.get_unique_label(); lbldone = cgen.get_unique_label();
+        // add label for top of loop body
+        cgen.emit_label(lbltop);
+        // load condition into a register
+        frame.step = 1;
+        if ((n = begin_condition(_condition,cgen,frame)) != NULL)
+            return n;
+        // fall through
+    case 1:
+        end_condition(cgen,frame);
+        // if the condition was zero (false), then jump to the done label
+        cgen.emit(op_je,asm_lbl(lbldone));
+        // otherwise control falls through to execute the while loop body
+        cgen.add_store_label(lbldone); // this store label is used to break from the loop
+        frame.cursor = _body;
+        frame.step = 2;
+        // fall through
+    case 2:
+        if ((n = frame.next_item<ast_statement_node>()) != NULL)
+            return n;
+        cgen.remove_store_label();
+        // jump back up to the top to reiterate the loop
+        cgen.emit(op_jmp,asm_lbl(lbltop));
+        // add done label
+        cgen.emit_label(lbldone);
     }
-    else {
-        const char* reg;
-        cgen.allocate_result_register(); // allocate a register for the result of the expression
-        reg = cgen.current_result_register(); // this should always be EAX
-        _condition->generate_code(symtable,cgen);
-        cgen.deallocate_result_register();
-        // the register value is still good since this is a statement node
-        cgen.instruction("cmpl $0, %%%s",reg);
-    }
-    // if the condition was zero (false), then jump to the done label
-    cgen.instruction("je lbl%d",lbldone);
-    // otherwise control falls through to execute the while loop body
-    ast_statement_node* n = _body;
-    cgen.add_store_label(lbldone); // this store label is used to break from the loop
-    while (n != NULL) {
-        n->generate_code(symtable,cgen);
-        n = n->get_next();
-    }
-    cgen.remove_store_label();
-    // jump back up to the top to reiterate the loop
-    cgen.instruction("jmp lbl%d",lbltop);
-    // add done label
-    cgen.writeline("lbl%d:",lbldone);
-}
-void ast_jump_statement_node::codegen_impl(stable& symtable,code_generator& cgen) const
-{
-    if (_expr != NULL) { // _kind->type() == token_toss
-        // load return value into EAX
+    return NULL;
+}
+const ast_node* ast_jump_statement_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
+{
+    if (_expr == NULL) { // _kind.type() == token_smash
+        // jump to loop end (iterative-statement parent set this on top of the store label stack)
+        cgen.emit(op_jmp,asm_lbl(cgen.get_store_label()));
+        return NULL;
+    }
+    // _kind.type() == token_toss: load return value into EAX
+    if (frame.step++ == 0) {
         cgen.allocate_result_register(); // allocate a register for the result of the expression (this will be EAX)
-        _expr->generate_code(symtable,cgen);
-        cgen.deallocate_result_register();
-        // the register value is still good since this is at the statement level; so jump to the function return label
-        cgen.instruction("jmp lbl%d",cgen.get_return_label());
+        return _expr;
     }
-    else // _kind->type() == token_smash
-        // jump to loop end (iterative-statement parent set this on top of the store label stack)
-        cgen.instruction("jmp lbl%d",cgen.get_store_label());
+    cgen.deallocate_result_register();
+    // the register value is still good since this is at the statement level; so jump to the function return label
+    cgen.emit(op_jmp,asm_lbl(cgen.get_return_label()));
+    return NULL;
 }
-void ast_assignment_expression_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_assignment_expression_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
 {
-    bool alloc = !cgen.expects_result();
+    if (frame.step++ == 0) {
+        // generate code for the right-hand expression
+        frame.alloc = !cgen.expects_result();
+        if (frame.alloc)
+            cgen.allocate_result_register();
+        return _ops[1].node;
+    }
     token_t type = get_type();
-    const symbol* obj = symtable.getSymbol( static_cast<ast_primary_expression_node*>(_ops[0].node)->name() );
-    // generate code for the right-hand expression
-    if (alloc)
-        cgen.allocate_result_register();
-    _ops[1].node->generate_code(symtable,cgen);
+    const symbol* obj = static_cast<ast_primary_expression_node*>(_ops[0].node)->get_symbol();
     // assign the right-hand expression to the left hand identifier; semantic analysis guarentees lvalue; make
     // sure that zero bits are extended when assigning to a function argument
     int offset = obj->get_offset();
     if (type==token_in || type==token_big)
-        cgen.instruction("movl %%%s, %d(%%ebp)",cgen.current_result_register(type),offset);
+        cgen.emit(op_movl,asm_reg(cgen.current_result_register(type)),asm_mem(offset));
     else if (type == token_small)
-        cgen.instruction("%s %%%s, %d(%%ebp)",offset>=0 ? "movswl" : "movw",cgen.current_result_register(type),offset);
+        cgen.emit(offset>=0 ? op_movswl : op_movw,asm_reg(cgen.current_result_register(type)),asm_mem(offset));
     else // token_boo
-        cgen.instruction("%s %%%s, %d(%%ebp)",offset>=0 ? "movsbl" : "movb",cgen.current_result_register(type),offset);
-    if (alloc)
+        cgen.emit(offset>=0 ? op_movsbl : op_movb,asm_reg(cgen.current_result_register(type)),asm_mem(offset));
+    if (frame.alloc)
         cgen.deallocate_result_register();
     // this expression returns the value of its left-operand, so if a result is expected, assign it to the 
     // current result register
-    if (!alloc)
-        cgen.instruction("movl %d(%%ebp), %%%s",offset,cgen.current_result_register());
+    else
+        cgen.emit(op_movl,asm_mem(offset),asm_reg(cgen.current_result_register()));
+    return NULL;
 }
-void ast_logical_or_expression_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_logical_or_expression_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
 {
     /* to implement logic-OR, we test to see if a term is non-zero; if so, the control assigns
        will jump to a block that assigns 1 to the result register; otherwise control falls through
        to test the next term; 0 is assigned in the default case */
-    bool alloc = !cgen.expects_result();
-    int lbltrue = cgen.get_unique_label(), lblfalse = cgen.get_unique_label(), lbldone = cgen.get_unique_label();
-    const char* reg = load_operand(_ops[0],symtable,cgen,alloc); // process the first term independently to effectively handle the else case
-    // process the rest of terms; the grammar guarantees at least 2 (so at least 1 for the below loop)
-    for (size_t i = 1;i < _ops.size();++i) {
+    int& lbltrue = frame.labels[0], &lblfalse = frame.labels[1], &lbldone = frame.labels[2];
+    if (frame.step++ == 0) {
+        frame.alloc = !cgen.expects_result();
+        lbltrue = cgen.get_unique_label(); lblfalse = cgen.get_unique_label(); lbldone = cgen.get_unique_label();
+        frame.index = 1;
+        return load_operand(_ops[0],cgen,frame.alloc); // process the first term independently to effectively handle the else case
+    }
+    const char* reg = loaded_register(cgen);
+    // process the rest of terms; the grammar guarantees at least 2
+    if (frame.index < int(_ops.size())) {
         // do comparison for previous term; if non-zero then jump to true block
-        cgen.instruction("cmpl $0, %%%s",reg);
-        cgen.instruction("jne lbl%d",lbltrue);
+        cgen.emit(op_cmpl,asm_imm(0),asm_reg(reg));
+        cgen.emit(op_jne,asm_lbl(lbltrue));
         // process the next term in the sequence
-        reg = load_operand(_ops[i],symtable,cgen); // use the same result register
+        return load_operand(_ops[frame.index++],cgen); // use the same result register
     }
     // insert jump for false case when none of the terms are non-zero
-    cgen.instruction("cmpl $0, %%%s",reg);
-    cgen.instruction("je lbl%d",lblfalse);
+    cgen.emit(op_cmpl,asm_imm(0),asm_reg(reg));
+    cgen.emit(op_je,asm_lbl(lblfalse));
     // define lbltrue
-    cgen.writeline("lbl%d:",lbltrue);
-    cgen.instruction("movl $1, %%%s",reg);
-    cgen.instruction("jmp lbl%d",lbldone);
+    cgen.emit_label(lbltrue);
+    cgen.emit(op_movl,asm_imm(1),asm_reg(reg));
+    cgen.emit(op_jmp,asm_lbl(lbldone));
     // define lblfalse
-    cgen.writeline("lbl%d:",lblfalse);
-    cgen.instruction("movl $0, %%%s",reg);
+    cgen.emit_label(lblfalse);
+    cgen.emit(op_movl,asm_imm(0),asm_reg(reg));
     // define lbldone
-    cgen.writeline("lbl%d:",lbldone);
-    if (alloc)
+    cgen.emit_label(lbldone);
+    if (frame.alloc)
         cgen.deallocate_result_register();
+    return NULL;
 }
-void ast_logical_and_expression_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_logical_and_expression_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
 {
     /* to implement logic-AND, we test each term to see if it is zero; if so then control
        jumps to a block that assigns 0 to the result register; otherwise control falls through
        to test each term until the success case is hit at the bottom */
-    bool alloc = !cgen.expects_result();
-    int lblfalse = cgen.get_unique_label(), lbltrue = cgen.get_unique_label(), lbldone = cgen.get_unique_label();
-    const char* reg = load_operand(_ops[0],symtable,cgen,alloc); // process the first term independently to effectively handle the else case
-    // process the rest of terms; the grammar guarantees at least 2 (so at least 1 for the below loop)
-    for (size_t i = 1;i < _ops.size();++i) {
-        // do comparison for previous term; if non-zero then jump to true block
-        cgen.instruction("cmpl $0, %%%s",reg);
-        cgen.instruction("je lbl%d",lblfalse);
+    int& lblfalse = frame.labels[0], &lbltrue = frame.labels[1], &lbldone = frame.labels[2];
+    if (frame.step++ == 0) {
+        frame.alloc = !cgen.expects_result();
+        lblfalse = cgen.get_unique_label(); lbltrue = cgen.get_unique_label(); lbldone = cgen.get_unique_label();
+        frame.index = 1;
+        return load_operand(_ops[0],cgen,frame.alloc); // process the first term independently to effectively handle the else case
+    }
+    const char* reg = loaded_register(cgen);
+    // process the rest of terms; the grammar guarantees at least 2
+    if (frame.index < int(_ops.size())) {
+        // do comparison for previous term; if zero then jump to false block
+        cgen.emit(op_cmpl,asm_imm(0),asm_reg(reg));
+        cgen.emit(op_je,asm_lbl(lblfalse));
         // process the next term in the sequence
-        reg = load_operand(_ops[i],symtable,cgen); // use the same result register
+        return load_operand(_ops[frame.index++],cgen); // use the same result register
     }
-    // insert jump for false case when none of the terms are non-zero
-    cgen.instruction("cmpl $0, %%%s",reg);
-    cgen.instruction("jne lbl%d",lbltrue);
+    // insert jump for true case when none of the terms are zero
+    cgen.emit(op_cmpl,asm_imm(0),asm_reg(reg));
+    cgen.emit(op_jne,asm_lbl(lbltrue));
     // define lblfalse
-    cgen.writeline("lbl%d:",lblfalse);
-    cgen.instruction("movl $0, %%%s",reg);
-    cgen.instruction("jmp lbl%d",lbldone);
+    cgen.emit_label(lblfalse);
+    cgen.emit(op_movl,asm_imm(0),asm_reg(reg));
+    cgen.emit(op_jmp,asm_lbl(lbldone));
     // define lbltrue
-    cgen.writeline("lbl%d:",lbltrue);
-    cgen.instruction("movl $1, %%%s",reg);
+    cgen.emit_label(lbltrue);
+    cgen.emit(op_movl,asm_imm(1),asm_reg(reg));
     // define lbldone
-    cgen.writeline("lbl%d:",lbldone);
-    if (alloc)
+    cgen.emit_label(lbldone);
+    if (frame.alloc)
         cgen.deallocate_result_register();
+    return NULL;
 }
-void ast_equality_expression_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_equality_expression_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
 {
     /* to implement EQUALITY, we load up the result of the left and right operands and compare them; based
        on which equality operator is used, a jump instruction takes control to either a success or fail block */
-    bool alloc = !cgen.expects_result();
-    const char* regA = load_operand(_operands[0],symtable,cgen,alloc), *regB = load_operand(_operands[1],symtable,cgen,true);
+    switch (frame.step++) {
+    case 0:
+        frame.alloc = !cgen.expects_result();
+        return load_operand(_operands[0],cgen,frame.alloc);
+    case 1:
+        frame.reg = loaded_register(cgen);
+        return load_operand(_operands[1],cgen,true);
+    }
+    const char* regA = frame.reg, *regB = loaded_register(cgen);
     int lbltrue = cgen.get_unique_label(), lbldone = cgen.get_unique_label();
     // note: regA will be assign-to register if hasResult==true
-    cgen.instruction("cmp %%%s, %%%s",regA,regB);
+    cgen.emit(op_cmp,asm_reg(regA),asm_reg(regB));
     cgen.deallocate_result_register();
-    if (alloc)
+    if (frame.alloc)
         cgen.deallocate_result_register();
-    cgen.instruction("%s lbl%d",_operator->type()==token_equal ? "je" : "jne",lbltrue);
-    cgen.instruction("movl $0, %%%s",regA);
-    cgen.instruction("jmp lbl%d",lbldone);
-    cgen.writeline("lbl%d:",lbltrue);
-    cgen.instruction("movl $1, %%%s",regA);
-    cgen.writeline("lbl%d:",lbldone);
+    cgen.emit(_operator.type()==token_equal ? op_je : op_jne,asm_lbl(lbltrue));
+    cgen.emit(op_movl,asm_imm(0),asm_reg(regA));
+    cgen.emit(op_jmp,asm_lbl(lbldone));
+    cgen.emit_label(lbltrue);
+    cgen.emit(op_movl,asm_imm(1),asm_reg(regA));
+    cgen.emit_label(lbldone);
+    return NULL;
 }
-void ast_relational_expression_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_relational_expression_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
 {
     /* to implement RELATIONAL, we load up the result of the left and right operands and compare them; based
        on which relational operator is used, a jump instruction takes control to either a success or fail block */
-    bool alloc = !cgen.expects_result();
-    const char* regA = load_operand(_operands[0],symtable,cgen,alloc), *regB = load_operand(_operands[1],symtable,cgen,true);
+    switch (frame.step++) {
+    case 0:
+        frame.alloc = !cgen.expects_result();
+        return load_operand(_operands[0],cgen,frame.alloc);
+    case 1:
+        frame.reg = loaded_register(cgen);
+        return load_operand(_operands[1],cgen,true);
+    }
+    const char* regA = frame.reg, *regB = loaded_register(cgen);
     int lbltrue = cgen.get_unique_label(), lbldone = cgen.get_unique_label();
-    const char* jmp;
+    asm_opcode jmp;
     // note: regA will be assign-to register if hasResult==true
-    cgen.instruction("cmp %%%s, %%%s",regA,regB);
+    cgen.emit(op_cmp,asm_reg(regA),asm_reg(regB));
     cgen.deallocate_result_register();
-    if (alloc)
+    if (frame.alloc)
         cgen.deallocate_result_register();
     // decide which operator to use
-    if (_operator->type() == token_less)
-        jmp = "jl";
-    else if (_operator->type() == token_greater)
-        jmp = "jg";
-    else if (_operator->type() == token_le)
-        jmp = "jle";
+    if (_operator.type() == token_less)
+        jmp = op_jl;
+    else if (_operator.type() == token_greater)
+        jmp = op_jg;
+    else if (_operator.type() == token_le)
+        jmp = op_jle;
     else // token_ge
-        jmp = "jge";
-    cgen.instruction("%s lbl%d",jmp,lbltrue);
-    cgen.instruction("movl $0, %%%s",regA);
-    cgen.instruction("jmp lbl%d",lbldone);
-    cgen.writeline("lbl%d:",lbltrue);
-    cgen.instruction("movl $1, %%%s",regA);
-    cgen.writeline("lbl%d:",lbldone);
-}
-void ast_additive_expression_node::codegen_impl(stable& symtable,code_generator& cgen) const
-{
-    // load up first operand; accumulate result in 'reg'
-    bool alloc = !cgen.expects_result();
-    const char* reg = load_operand(_operands[0],symtable,cgen,alloc);
-    // process the rest of the operands in the expression (grammar guarantees at least 1 more)
-    for (size_t i = 1,j = 0;i < _operands.size();++i,++j) {
-        load_operand(_operands[i],symtable,cgen,true); // allocate register and grab next operand
-        if (_operators[j]->type() == token_add)
-            cgen.instruction("addl %%%s, %%%s",cgen.current_result_register(),reg);
+        jmp = op_jge;
+    cgen.emit(jmp,asm_lbl(lbltrue));
+    cgen.emit(op_movl,asm_imm(0),asm_reg(regA));
+    cgen.emit(op_jmp,asm_lbl(lbldone));
+    cgen.emit_label(lbltrue);
+    cgen.emit(op_movl,asm_imm(1),asm_reg(regA));
+    cgen.emit_label(lbldone);
+    return NULL;
+}
+const ast_node* ast_additive_expression_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
+{
+    switch (frame.step++) {
+    case 0:
+        // load up first operand; accumulate result in 'reg'
+        frame.alloc = !cgen.expects_result();
+        return load_operand(_operands[0],cgen,frame.alloc);
+    case 1:
+        frame.reg = loaded_register(cgen);
+        frame.index = 1;
+        break;
+    default: // the operand at 'index' was loaded
+        if (_operators[frame.index-1].type() == token_add)
+            cgen.emit(op_addl,asm_reg(cgen.current_result_register()),asm_reg(frame.reg));
         else // token_subtract
-            cgen.instruction("subl %%%s, %%%s",cgen.current_result_register(),reg);
+            cgen.emit(op_subl,asm_reg(cgen.current_result_register()),asm_reg(frame.reg));
         cgen.deallocate_result_register();
+        ++frame.index;
+        break;
     }
-    if (alloc)
+    // process the rest of the operands in the expression (grammar guarantees at least 1 more)
+    if (frame.index < int(_operands.size()))
+        return load_operand(_operands[frame.index],cgen,true); // allocate register and grab next operand
+    if (frame.alloc)
         cgen.deallocate_result_register();
+    return NULL;
 }
-void ast_multiplicative_expression_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_multiplicative_expression_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
 {
-    // load up first operand; accumulate result in 'reg'
-    bool alloc = !cgen.expects_result();
-    const char* reg = load_operand(_operands[0],symtable,cgen,alloc);
-    // process the rest of the operands in the expression (grammar guarantees at least 1 more)
-    for (size_t i = 1,j = 0;i < _operands.size();++i,++j) {
-        load_operand(_operands[i],symtable,cgen,true); // allocate register and grab next operand
-        // do signed operations
-        if (_operators[j]->type() == token_multiply)
-            cgen.instruction("imull %%%s, %%%s",cgen.current_result_register(),reg);
-        else { // token_multiply or token_mod
-            // this is really nasty... I hard code in each case.
-            const char* restore = NULL;
-            const char* divisor = cgen.current_result_register();
-            if (strcmp(reg,"eax") == 0) { // is the dividend in EAX?
-                // EDX is the divisor; it is going to be cobbled by CDQ instruction so
-                // move it to ECX
-                cgen.instruction("movl %%edx, %%ecx");
-                divisor = "ecx";
-            }
-            else if (strcmp(reg,"edx") == 0) { // is the dividend in EDX?
-                // move dividend into dividend register; it will be cobbled by CDQ instruction
-                // the divisor (ECX) is fine where it is; push EAX on stack since the allocator
-                // must be using it
-                cgen.instruction("pushl %%eax");
-                cgen.instruction("movl %%edx, %%eax");
-                restore = "eax";
-            }
-            else if (strcmp(reg,"ebx") == 0) { // is the dividend in EBX?
-                // swap EBX with EAX
-                cgen.instruction("pushl %%eax");
-                cgen.instruction("movl %%ebx, %%eax");
-                cgen.instruction("popl %%ebx");
-                cgen.instruction("push %%edx");
-                divisor = "ebx";
-                restore = "edx";
+    switch (frame.step++) {
+    case 0:
+        // load up first operand; accumulate result in 'reg'
+        frame.alloc = !cgen.expects_result();
+        return load_operand(_operands[0],cgen,frame.alloc);
+    case 1:
+        frame.reg = loaded_register(cgen);
+        frame.index = 1;
+        break;
+    default: // the operand at 'index' was loaded
+        {
+            const char* reg = frame.reg;
+            const token& oper = _operators[frame.index-1];
+            // do signed operations
+            if (oper.type() == token_multiply)
+                cgen.emit(op_imull,asm_reg(cgen.current_result_register()),asm_reg(reg));
+            else { // token_multiply or token_mod
+                // this is really nasty... I hard code in each case.
+                const char* restore = NULL;
+                const char* divisor = cgen.current_result_register();
+                if (strcmp(reg,"eax") == 0) { // is the dividend in EAX?
+                    // EDX is the divisor; it is going to be cobbled by CDQ instruction so
+                    // move it to ECX
+                    cgen.emit(op_movl,asm_reg("edx"),asm_reg("ecx"));
+                    divisor = "ecx";
+                }
+                else if (strcmp(reg,"edx") == 0) { // is the dividend in EDX?
+                    // move dividend into dividend register; it will be cobbled by CDQ instruction
+                    // the divisor (ECX) is fine where it is; push EAX on stack since the allocator
+                    // must be using it
+                    cgen.emit(op_pushl,asm_reg("eax"));
+                    cgen.emit(op_movl,asm_reg("edx"),asm_reg("eax"));
+                    restore = "eax";
+                }
+                else if (strcmp(reg,"ebx") == 0) { // is the dividend in EBX?
+                    // swap EBX with EAX
+                    cgen.emit(op_pushl,asm_reg("eax"));
+                    cgen.emit(op_movl,asm_reg("ebx"),asm_reg("eax"));
+                    cgen.emit(op_popl,asm_reg("ebx"));
+                    cgen.emit(op_push,asm_reg("edx"));
+                    divisor = "ebx";
+                    restore = "edx";
+                }
+                else {
+                    cgen.emit(op_movl,asm_reg(reg),asm_reg("eax"));
+                    cgen.emit(op_push,asm_reg("edx"));
+                    restore = "edx";
+                }
+                cgen.emit(op_cdq); // sign-extend eax into edx
+                cgen.emit(op_idivl,asm_reg(divisor));
+                if (oper.type()==token_mod && strcmp(reg,"edx")!=0)
+                    cgen.emit(op_movl,asm_reg("edx"),asm_reg(reg)); // move remainder into result register
+                else if (oper.type()==token_divide && strcmp(reg,"eax")!=0)
+                    cgen.emit(op_movl,asm_reg("eax"),asm_reg(reg)); // move quotient into result register
+                if (restore != NULL)
+                    cgen.emit(op_popl,asm_reg(restore));
             }
-            else {
-                cgen.instruction("movl %%%s, %%eax",reg);
-                cgen.instruction("push %%edx");
-                restore = "edx";
-            }
-            cgen.instruction("cdq"); // sign-extend eax into edx
-            cgen.instruction("idivl %%%s",divisor);
-            if (_operators[j]->type()==token_mod && strcmp(reg,"edx")!=0)
-                cgen.instruction("movl %%edx, %%%s",reg); // move remainder into result register
-            else if (_operators[j]->type()==token_divide && strcmp(reg,"eax")!=0)
-                cgen.instruction("movl %%eax, %%%s",reg); // move quotient into result register
-            if (restore != NULL)
-                cgen.instruction("popl %%%s",restore);
+            cgen.deallocate_result_register();
+            ++frame.index;
         }
-        cgen.deallocate_result_register();
+        break;
     }
-    if (alloc)
+    // process the rest of the operands in the expression (grammar guarantees at least 1 more)
+    if (frame.index < int(_operands.size()))
+        return load_operand(_operands[frame.index],cgen,true); // allocate register and grab next operand
+    if (frame.alloc)
         cgen.deallocate_result_register();
+    return NULL;
 }
-void ast_prefix_expression_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_prefix_expression_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
 {
     // load up the single operand into a result register
-    bool alloc = !cgen.expects_result();
-    const char* reg = load_operand(_operand,symtable,cgen,alloc);
-    if (_operator->type() == token_not) {
+    if (frame.step++ == 0) {
+        frame.alloc = !cgen.expects_result();
+        return load_operand(_operand,cgen,frame.alloc);
+    }
+    const char* reg = loaded_register(cgen);
+    if (_operator.type() == token_not) {
         // do comparison on the operand; if non-zero then set 0 to the
         // low byte register, 1 otherwise; then zero-extend the low-byte
         // register into the long (extended) register
         const char* regLow;
         regLow = cgen.expects_result() ? cgen.current_result_register(token_boo)/*get low-byte version*/ : "al";
-        cgen.instruction("cmp $0, %%%s",reg);
-        cgen.instruction("sete %%%s",regLow); // set 1 if equal, 0 otherwise
-        cgen.instruction("movzbl %%%s, %%%s",regLow,reg);
+        cgen.emit(op_cmp,asm_imm(0),asm_reg(reg));
+        cgen.emit(op_sete,asm_reg(regLow)); // set 1 if equal, 0 otherwise
+        cgen.emit(op_movzbl,asm_reg(regLow),asm_reg(reg));
     }
     else // token_subtract (meaning unary negation)
-        cgen.instruction("negl %%%s",reg);
-    if (alloc)
+        cgen.emit(op_negl,asm_reg(reg));
+    if (frame.alloc)
         cgen.deallocate_result_register();
+    return NULL;
 }
-void ast_postfix_expression_node::codegen_impl(stable& symtable,code_generator& cgen) const
-{
-    bool alloc;
-    ast_expression_node* n;
-    const symbol* sym = symtable.getSymbol(static_cast<ast_primary_expression_node*>(_op.node)->name());
-    stack<ast_expression_node*> params;
-    int nargs;
-    // insert all parameter expressions into the stack
-    n = _expList;
-    while (n != NULL) {
-        params.push(n);
-        n = n->get_next();
-    }
-    nargs = (int)params.size();
-    // save any intermediate values on the stack
-    cgen.save_registers();
-    // generate code for each expression list, pushing the result value on the stack; the stack
-    // of expression nodes guarantees correct argument ordering
-    alloc = !cgen.expects_result();
-    if (alloc)
-        cgen.allocate_result_register();
-    while ( !params.empty() ) {
-        n = params.top();
-        params.pop();
-        n->generate_code(symtable,cgen);
-        cgen.instruction("pushl %%%s",cgen.current_result_register());
+const ast_node* ast_postfix_expression_node::codegen_impl(code_generator& cgen,ast_pass_frame& frame) const
+{
+    const ast_expression_node* n;
+    switch (frame.step) {
+    case 0:
+        // the arguments are visited last to first (the list is walked backwards from its
+        // tail), which guarantees correct argument ordering; 'index' counts the arguments
+        for (n = _expList;n != NULL;n = n->get_next()) {
+            frame.cursor = n;
+            ++frame.index;
+        }
+        // save any intermediate values on the stack
+        cgen.save_registers();
+        // generate code for each expression list, pushing the result value on the stack
+        frame.alloc = !cgen.expects_result();
+        if (frame.alloc)
+            cgen.allocate_result_register();
+        frame.step = 1;
+        break;
+    case 1:
+        cgen.emit(op_pushl,asm_reg(cgen.current_result_register()));
+        break;
     }
-    if (alloc)
+    if (frame.cursor != NULL) {
+        n = static_cast<const ast_expression_node*>(frame.cursor);
+        frame.cursor = n != _expList ? n->get_prev() : NULL;
+        return n;
+    }
+    if (frame.alloc)
         cgen.deallocate_result_register();
     // call the function
-#ifdef RAMSEY_WIN32 // requires leading underscore
-    cgen.instruction("call _%s",sym->get_name());
-#elif RAMSEY_APPLE // requires leading underscore
-    cgen.instruction("call _%s",sym->get_name());
-#else // POSIX (GNU/LINUX)
-    cgen.instruction("call %s",sym->get_name());
-#endif
+    const symbol* sym = static_cast<ast_primary_expression_node*>(_op.node)->get_symbol();
+    string name = sym->get_name();
+    cgen.emit(op_call,asm_sym(name.data(),int(name.size())));
     // move function return value into result register (if they are not the same register)
     if (cgen.expects_result() && cgen.current_result_register_flag()!=code_generator::reg_EAX)
-        cgen.instruction("movl %%eax, %%%s",cgen.current_result_register());
+        cgen.emit(op_movl,asm_reg("eax"),asm_reg(cgen.current_result_register()));
     // unload the stack
-    if (nargs > 0)
-        cgen.instruction("addl $%d, %%esp",nargs*code_generator::REGISTER_WIDTH);
+    if (frame.index > 0)
+        cgen.emit(op_addl,asm_imm(frame.index*code_generator::REGISTER_WIDTH),asm_reg("esp"));
     // restore registers 
     cgen.restore_registers();
+    return NULL;
 }
-void ast_primary_expression_node::codegen_impl(stable& symtable,code_generator& cgen) const
+const ast_node* ast_primary_expression_node::codegen_impl(code_generator& cgen,ast_pass_frame&) const
 {
     // optimization: if no result is expected, then the operation is useless and can be discarded
     if ( !cgen.expects_result() )
-        return;
+        return NULL;
     // default behavior is to load the value into the result register; this function should
     // not be called on every primary expression node; most expressions use the values directly
-    if (_tok->type() == token_id) {
+    if (_tok.type() == token_id) {
         token_t type;
-        const symbol* sym = symtable.getSymbol(_tok->source_string());
+        const symbol* sym = get_symbol();
         type = sym->get_type();
         if (type==token_in || type==token_big)
-            cgen.instruction("movl %d(%%ebp), %%%s",sym->get_offset(),cgen.current_result_register());
+            cgen.emit(op_movl,asm_mem(sym->get_offset()),asm_reg(cgen.current_result_register()));
         else if (type == token_small)
             // sign-extend to long
-            cgen.instruction("movswl %d(%%ebp), %%%s",sym->get_offset(),cgen.current_result_register());
+            cgen.emit(op_movswl,asm_mem(sym->get_offset()),asm_reg(cgen.current_result_register()));
         else // token_boo
             // sign-extend to long
-            cgen.instruction("movsbl %d(%%ebp), %%%s",sym->get_offset(),cgen.current_result_register());
+            cgen.emit(op_movsbl,asm_mem(sym->get_offset()),asm_reg(cgen.current_result_register()));
     }
     else {
-        if (_tok->type() == token_number)
-            cgen.instruction("movl $%s, %%%s",_tok->source_string(),cgen.current_result_register());
-        else if (_tok->type() == token_bool_false) // use 0 for false
-            cgen.instruction("movl $0, %%%s",cgen.current_result_register());
+        if (_tok.type() == token_number)
+            cgen.emit(op_movl,asm_imm(_tok.source(),_tok.source_length()),asm_reg(cgen.current_result_register()));
+        else if (_tok.type() == token_bool_false) // use 0 for false
+            cgen.emit(op_movl,asm_imm(0),asm_reg(cgen.current_result_register()));
         else // token_bool_true (use 1 for true)
-            cgen.instruction("movl $1, %%%s",cgen.current_result_register());
+            cgen.emit(op_movl,asm_imm(1),asm_reg(cgen.current_result_register()));
+    }
+    return NULL;
+}
+
+// code generation for flat_ast: the same instruction selection as the node
+// implementations above, dispatched on the node kind
+
+void flat_ast::generate_code(code_generator& cgen)
+{
+    // functions are emitted last to first (in the order the node pass emits them)
+    for (int i = int(_functions.size())-1;i >= 0;--i) {
+        const function_node& fn = _functions[i];
+        cgen.begin_function(_symbols[fn.symb].id.source_string().c_str());
+        for (int p = fn.params.first;p < fn.params.first+fn.params.count;++p)
+            _symbols[p].set_offset( cgen.next_argument_offset() );
+        codegen_statements(cgen,fn.body);
+        cgen.end_function();
+    }
+}
+void flat_ast::codegen_statements(code_generator& cgen,range body)
+{
+    // the blocks being visited are kept on '_walk' (innermost last); a nested block
+    // is opened in place of recursion and its statement is continued once it ends
+    size_t base = _walk.size();
+    open_block(body,block_function,-1);
+    while (_walk.size() > base) {
+        if (_walk.back().next < _walk.back().last) {
+            int i = _walk.back().next++;
+            const statement_node& s = _statements[i];
+            switch (s.kind) {
+            case ast_statement_node::ast_declaration_statement:
+                {
+                    flat_symbol& decl = _symbols[s.a];
+                    token_t type = decl.type;
+                    // get stack address offset
+                    decl.set_offset( cgen.next_variable_offset(type) );
+                    // do initializer assignment
+                    if (s.b >= 0) {
+                        cgen.allocate_result_register();
+                        codegen_expression(cgen,s.b);
+                        if (type==token_in || type==token_big)
+                            cgen.emit(op_movl,asm_reg(cgen.current_result_register(type)),asm_mem(decl.get_offset()));
+                        else if (type == token_small)
+                            cgen.emit(op_movw,asm_reg(cgen.current_result_register(type)),asm_mem(decl.get_offset()));
+                        else // token_boo
+                            cgen.emit(op_movb,asm_reg(cgen.current_result_register(type)),asm_mem(decl.get_offset()));
+                        cgen.deallocate_result_register();
+                    }
+                }
+                break;
+            case ast_statement_node::ast_expression_statement:
+                codegen_expression(cgen,s.a);
+                break;
+            case ast_statement_node::ast_selection_statement:
+                {
+                    int lbltrue = cgen.get_unique_label(), lbldone = cgen.get_unique_label();
+                    codegen_condition(cgen,s.a);
+                    // jump to the true block if condition was non-zero
+                    cgen.emit(op_jne,asm_lbl(lbltrue));
+                    // otherwise the control falls through to hit the elf blocks and the else block; as
+                    // in the node pass, the done label is the store label while the elf blocks are emitted
+                    cgen.add_store_label(lbldone);
+                    // begin the elf-clauses with an empty block
+                    walk_frame& w = open_block(range(),block_elf,i);
+                    w.labels[0] = lbltrue;
+                    w.labels[1] = lbldone;
+                    w.labels[2] = -1;
+                }
+                break;
+            case ast_statement_node::ast_iterative_statement:
+                {
+                    int lbltop = cgen.get_unique_label(), lbldone = cgen.get_unique_label();
+                    cgen.emit_label(lbltop);
+                    codegen_condition(cgen,s.a);
+                    // if the condition was zero (false), then jump to the done label
+                    cgen.emit(op_je,asm_lbl(lbldone));
+                    cgen.add_store_label(lbldone); // this store label is used to break from the loop
+                    walk_frame& w = open_block(s.body,block_loop,i);
+                    w.labels[0] = lbltop;
+                    w.labels[1] = lbldone;
+                }
+                break;
+            case ast_statement_node::ast_jump_statement:
+                if (s.a >= 0) { // toss
+                    cgen.allocate_result_register(); // this will be EAX
+                    codegen_expression(cgen,s.a);
+                    cgen.deallocate_result_register();
+                    cgen.emit(op_jmp,asm_lbl(cgen.get_return_label()));
+                }
+                else // smash: jump to loop end
+                    cgen.emit(op_jmp,asm_lbl(cgen.get_store_label()));
+                break;
+            }
+            continue;
+        }
+        // the block has ended: continue its statement
+        walk_frame w = _walk.back();
+        _walk.pop_back();
+        const int lbltrue = w.labels[0], lbldone = w.labels[1];
+        switch (w.step) {
+        case block_elf:
+            {
+                const statement_node& s = _statements[w.node];
+                int elf = s.b;
+                if (w.elf >= 0) {
+                    cgen.emit(op_jmp,asm_lbl(lbldone));
+                    cgen.emit_label(w.labels[2]);
+                    elf = _statements[w.elf].b;
+                }
+                if (elf >= 0) { // emit the next elf-clause
+                    const statement_node& e = _statements[elf];
+                    int lblfalse = cgen.get_unique_label();
+                    codegen_condition(cgen,e.a);
+                    cgen.emit(op_je,asm_lbl(lblfalse));
+                    walk_frame& next = open_block(e.body,block_elf,w.node);
+                    next.elf = elf;
+                    next.labels[0] = lbltrue;
+                    next.labels[1] = lbldone;
+                    next.labels[2] = lblfalse;
+                    break;
+                }
+                cgen.remove_store_label();
+                // the node pass emits only the head of the else-body list; match its output
+                range head = { s.other.first, s.other.count > 0 ? 1 : 0 };
+                walk_frame& other = open_block(head,block_else,w.node);
+                other.labels[0] = lbltrue;
+                other.labels[1] = lbldone;
+            }
+            break;
+        case block_else:
+            {
+                const statement_node& s = _statements[w.node];
+                cgen.emit(op_jmp,asm_lbl(lbldone)); // jump over true block to done label
+                cgen.emit_label(lbltrue);
+                if (s.body.count == 0)
+                    cgen.emit(op_nop); // empty statement body, issue nop
+                walk_frame& block = open_block(s.body,block_if,w.node);
+                block.labels[1] = lbldone;
+            }
+            break;
+        case block_if:
+            // define done label past true block
+            cgen.emit_label(lbldone);
+            break;
+        case block_loop:
+            cgen.remove_store_label();
+            cgen.emit(op_jmp,asm_lbl(w.labels[0]));
+            cgen.emit_label(lbldone);
+            break;
+        }
+    }
+}
+void flat_ast::codegen_condition(code_generator& cgen,int e)
+{
+    // compare a condition against zero, leaving the flags set for a jump
+    const expression_node& x = _expressions[e];
+    if (x.kind==ast_expression_node::ast_primary_expression && x.op==token_id) {
+        // if the condition is just an identifier, then it can be used directly
+        const flat_symbol& sym = _symbols[x.b];
+        if (sym.type==token_in || sym.type==token_big)
+            cgen.emit(op_cmpl,asm_imm(0),asm_mem(sym.get_offset()));
+        else if (sym.type == token_small)
+            cgen.emit(op_cmpw,asm_imm(0),asm_mem(sym.get_offset()));
+        else // token_boo
+            cgen.emit(op_cmpb,asm_imm(0),asm_mem(sym.get_offset()));
+    }
+    else {
+        const char* reg;
+        cgen.allocate_result_register(); // this should always be EAX
+        reg = cgen.current_result_register();
+        codegen_expression(cgen,e);
+        cgen.deallocate_result_register();
+        // the register value is still good since this is a statement condition
+        cgen.emit(op_cmpl,asm_imm(0),asm_reg(reg));
+    }
+}
+const char* flat_ast::codegen_expression(code_generator& cgen,int e,bool alloc)
+{
+    // generate the expression (in a newly allocated result register if 'alloc') and
+    // return the register into which it was loaded; the expressions being visited
+    // are kept on '_walk' (see codegen_step)
+    size_t base = _walk.size();
+    if (alloc)
+        cgen.allocate_result_register();
+    _walk.push_back( walk_frame(e) );
+    do {
+        int operand = codegen_step(cgen,_walk.back());
+        if (operand >= 0)
+            _walk.push_back( walk_frame(operand) );
+        else
+            _walk.pop_back();
+    } while (_walk.size() > base);
+    return !cgen.expects_result() ? "eax" : cgen.current_result_register();
+}
+int flat_ast::codegen_step(code_generator& cgen,walk_frame& w)
+{
+    // generate code for the expression up to its next operand and return the operand
+    // (after allocating a register for it if needed), or finish the expression and
+    // return -1; 'next' is the operand that was loaded last
+    const expression_node& x = _expressions[w.node];
+    const int first = x.a, last = first + x.b;
+    const char* loaded = !cgen.expects_result() ? "eax" : cgen.current_result_register();
+    const int step = w.step++;
+    switch (x.kind) {
+    case ast_expression_node::ast_assignment_expression:
+        if (step == 0) {
+            w.own = !cgen.expects_result();
+            if (w.own)
+                cgen.allocate_result_register();
+            return first+1;
+        }
+        else {
+            token_t type = token_t(x.type);
+            int offset = _symbols[_expressions[first].b].get_offset();
+            if (type==token_in || type==token_big)
+                cgen.emit(op_movl,asm_reg(cgen.current_result_register(type)),asm_mem(offset));
+            else if (type == token_small)
+                cgen.emit(offset>=0 ? op_movswl : op_movw,asm_reg(cgen.current_result_register(type)),asm_mem(offset));
+            else // token_boo
+                cgen.emit(offset>=0 ? op_movsbl : op_movb,asm_reg(cgen.current_result_register(type)),asm_mem(offset));
+            if (w.own)
+                cgen.deallocate_result_register();
+            else
+                cgen.emit(op_movl,asm_mem(offset),asm_reg(cgen.current_result_register()));
+        }
+        break;
+    case ast_expression_node::ast_logical_or_expression:
+    case ast_expression_node::ast_logical_and_expression:
+        {
+            // or: any non-zero term jumps to the true block; and: any zero term jumps to the false block
+            bool isor = x.kind == ast_expression_node::ast_logical_or_expression;
+            const int lbl1 = w.labels[0], lbl2 = w.labels[1], lbldone = w.labels[2];
+            if (step == 0) {
+                w.own = !cgen.expects_result();
+                w.labels[0] = cgen.get_unique_label(); w.labels[1] = cgen.get_unique_label(); w.labels[2] = cgen.get_unique_label();
+                if (w.own)
+                    cgen.allocate_result_register();
+                w.next = first;
+                return first;
+            }
+            const char* reg = loaded;
+            if (++w.next < last) {
+                cgen.emit(op_cmpl,asm_imm(0),asm_reg(reg));
+                cgen.emit(isor ? op_jne : op_je,asm_lbl(lbl1));
+                return w.next;
+            }
+            cgen.emit(op_cmpl,asm_imm(0),asm_reg(reg));
+            cgen.emit(isor ? op_je : op_jne,asm_lbl(lbl2));
+            cgen.emit_label(lbl1);
+            cgen.emit(op_movl,asm_imm(isor ? 1 : 0),asm_reg(reg));
+            cgen.emit(op_jmp,asm_lbl(lbldone));
+            cgen.emit_label(lbl2);
+            cgen.emit(op_movl,asm_imm(isor ? 0 : 1),asm_reg(reg));
+            cgen.emit_label(lbldone);
+            if (w.own)
+                cgen.deallocate_result_register();
+        }
+        break;
+    case ast_expression_node::ast_equality_expression:
+    case ast_expression_node::ast_relational_expression:
+        if (step == 0) {
+            w.own = !cgen.expects_result();
+            if (w.own)
+                cgen.allocate_result_register();
+            return first;
+        }
+        else if (step == 1) {
+            w.reg = loaded;
+            cgen.allocate_result_register();
+            return first+1;
+        }
+        else {
+            const char* regA = w.reg, *regB = loaded;
+            int lbltrue = cgen.get_unique_label(), lbldone = cgen.get_unique_label();
+            asm_opcode jmp;
+            cgen.emit(op_cmp,asm_reg(regA),asm_reg(regB));
+            cgen.deallocate_result_register();
+            if (w.own)
+                cgen.deallocate_result_register();
+            if (x.op == token_equal)
+                jmp = op_je;
+            else if (x.op == token_nequal)
+                jmp = op_jne;
+            else if (x.op == token_less)
+                jmp = op_jl;
+            else if (x.op == token_greater)
+                jmp = op_jg;
+            else if (x.op == token_le)
+                jmp = op_jle;
+            else // token_ge
+                jmp = op_jge;
+            cgen.emit(jmp,asm_lbl(lbltrue));
+            cgen.emit(op_movl,asm_imm(0),asm_reg(regA));
+            cgen.emit(op_jmp,asm_lbl(lbldone));
+            cgen.emit_label(lbltrue);
+            cgen.emit(op_movl,asm_imm(1),asm_reg(regA));
+            cgen.emit_label(lbldone);
+        }
+        break;
+    case ast_expression_node::ast_additive_expression:
+    case ast_expression_node::ast_multiplicative_expression:
+        if (step == 0) {
+            w.own = !cgen.expects_result();
+            if (w.own)
+                cgen.allocate_result_register();
+            w.next = first;
+            return first;
+        }
+        if (step == 1)
+            w.reg = loaded; // accumulate the result in the first operand's register
+        else {
+            const char* reg = w.reg;
+            const int i = w.next;
+            if (_expressions[i].infix == token_add)
+                cgen.emit(op_addl,asm_reg(cgen.current_result_register()),asm_reg(reg));
+            else if (_expressions[i].infix == token_subtract)
+                cgen.emit(op_subl,asm_reg(cgen.current_result_register()),asm_reg(reg));
+            else if (_expressions[i].infix == token_multiply)
+                cgen.emit(op_imull,asm_reg(cgen.current_result_register()),asm_reg(reg));
+            else { // token_divide or token_mod: see ast_multiplicative_expression_node::codegen_impl
+                const char* restore = NULL;
+                const char* divisor = cgen.current_result_register();
+                if (strcmp(reg,"eax") == 0) {
+                    cgen.emit(op_movl,asm_reg("edx"),asm_reg("ecx"));
+                    divisor = "ecx";
+                }
+                else if (strcmp(reg,"edx") == 0) {
+                    cgen.emit(op_pushl,asm_reg("eax"));
+                    cgen.emit(op_movl,asm_reg("edx"),asm_reg("eax"));
+                    restore = "eax";
+                }
+                else if (strcmp(reg,"ebx") == 0) {
+                    cgen.emit(op_pushl,asm_reg("eax"));
+                    cgen.emit(op_movl,asm_reg("ebx"),asm_reg("eax"));
+                    cgen.emit(op_popl,asm_reg("ebx"));
+                    cgen.emit(op_push,asm_reg("edx"));
+                    divisor = "ebx";
+                    restore = "edx";
+                }
+                else {
+                    cgen.emit(op_movl,asm_reg(reg),asm_reg("eax"));
+                    cgen.emit(op_push,asm_reg("edx"));
+                    restore = "edx";
+                }
+                cgen.emit(op_cdq);
+                cgen.emit(op_idivl,asm_reg(divisor));
+                if (_expressions[i].infix==token_mod && strcmp(reg,"edx")!=0)
+                    cgen.emit(op_movl,asm_reg("edx"),asm_reg(reg));
+                else if (_expressions[i].infix==token_divide && strcmp(reg,"eax")!=0)
+                    cgen.emit(op_movl,asm_reg("eax"),asm_reg(reg));
+                if (restore != NULL)
+                    cgen.emit(op_popl,asm_reg(restore));
+            }
+            cgen.deallocate_result_register();
+        }
+        if (++w.next < last) {
+            cgen.allocate_result_register();
+            return w.next;
+        }
+        if (w.own)
+            cgen.deallocate_result_register();
+        break;
+    case ast_expression_node::ast_prefix_expression:
+        if (step == 0) {
+            w.own = !cgen.expects_result();
+            if (w.own)
+                cgen.allocate_result_register();
+            return first;
+        }
+        else {
+            const char* reg = loaded;
+            if (x.op == token_not) {
+                const char* regLow = cgen.expects_result() ? cgen.current_result_register(token_boo) : "al";
+                cgen.emit(op_cmp,asm_imm(0),asm_reg(reg));
+                cgen.emit(op_sete,asm_reg(regLow));
+                cgen.emit(op_movzbl,asm_reg(regLow),asm_reg(reg));
+            }
+            else // token_subtract (meaning unary negation)
+                cgen.emit(op_negl,asm_reg(reg));
+            if (w.own)
+                cgen.deallocate_result_register();
+        }
+        break;
+    case ast_expression_node::ast_postfix_expression:
+        if (step == 0) {
+            cgen.save_registers();
+            // push the arguments last to first
+            w.own = !cgen.expects_result();
+            if (w.own)
+                cgen.allocate_result_register();
+            w.next = last;
+        }
+        else
+            cgen.emit(op_pushl,asm_reg(cgen.current_result_register()));
+        if (--w.next > first)
+            return w.next;
+        else {
+            const token& name = _symbols[_expressions[first].b].id;
+            int nargs = last - first - 1;
+            if (w.own)
+                cgen.deallocate_result_register();
+            cgen.emit(op_call,asm_sym(name.source(),name.source_length()));
+            if (cgen.expects_result() && cgen.current_result_register_flag()!=code_generator::reg_EAX)
+                cgen.emit(op_movl,asm_reg("eax"),asm_reg(cgen.current_result_register()));
+            if (nargs > 0)
+                cgen.emit(op_addl,asm_imm(nargs*code_generator::REGISTER_WIDTH),asm_reg("esp"));
+            cgen.restore_registers();
+        }
+        break;
+    case ast_expression_node::ast_primary_expression:
+        // if no result is expected, then the operation is useless and can be discarded
+        if ( !cgen.expects_result() )
+            break;
+        if (x.op == token_id) {
+            const flat_symbol& sym = _symbols[x.b];
+            if (sym.type==token_in || sym.type==token_big)
+                cgen.emit(op_movl,asm_mem(sym.get_offset()),asm_reg(cgen.current_result_register()));
+            else if (sym.type == token_small)
+                cgen.emit(op_movswl,asm_mem(sym.get_offset()),asm_reg(cgen.current_result_register()));
+            else // token_boo
+                cgen.emit(op_movsbl,asm_mem(sym.get_offset()),asm_reg(cgen.current_result_register()));
+        }
+        else if (x.op == token_number) {
+            const token& tok = _tokens[x.a];
+            cgen.emit(op_movl,asm_imm(tok.source(),tok.source_length()),asm_reg(cgen.current_result_register()));
+        }
+        else if (x.op == token_bool_false)
+            cgen.emit(op_movl,asm_imm(0),asm_reg(cgen.current_result_register()));
+        else // token_bool_true
+            cgen.emit(op_movl,asm_imm(1),asm_reg(cgen.current_result_register()));
+        break;
     }
+    return -1;
 }
@@ -1,15 +1,58 @@
 /* codegen.h */
 #ifndef CODEGEN_H
 #define CODEGEN_H
-#include <cstdarg>
-#include <cstdio>
-#include <sstream>
+#include <ostream>
+#include <string>
 #include <queue>
 #include <stack>
 #include "lexer.h"
 
 namespace ramsey
 {
+    // mnemonics of the instructions the code generator emits
+    enum asm_opcode
+    {
+        op_pushl, op_push, op_popl,
+        op_movl, op_movw, op_movb, op_movswl, op_movsbl, op_movzbl,
+        op_addl, op_subl, op_imull, op_idivl, op_negl, op_cdq,
+        op_cmp, op_cmpl, op_cmpw, op_cmpb, op_sete,
+        op_jmp, op_je, op_jne, op_jl, op_jg, op_jle, op_jge,
+        op_call, op_leave, op_ret, op_nop
+    };
+
+    // an instruction operand; it is only formatted when it is emitted
+    struct asm_operand
+    {
+        enum operand_kind
+        {
+            operand_register, // %text
+            operand_memory, // value(%ebp)
+            operand_immediate, // $value
+            operand_literal, // $text
+            operand_label, // lbl<value>
+            operand_symbol // text (a function name, with the platform's prefix)
+        };
+
+        operand_kind kind;
+        int value;
+        const char* text;
+        int length;
+    };
+    inline asm_operand asm_reg(const char* name)
+    { asm_operand o = { asm_operand::operand_register, 0, name, 0 }; return o; }
+    inline asm_operand asm_mem(int offset)
+    { asm_operand o = { asm_operand::operand_memory, offset, NULL, 0 }; return o; }
+    inline asm_operand asm_imm(int value)
+    { asm_operand o = { asm_operand::operand_immediate, value, NULL, 0 }; return o; }
+    inline asm_operand asm_imm(const char* text,int length)
+    { asm_operand o = { asm_operand::operand_literal, 0, text, length }; return o; }
+    inline asm_operand asm_lbl(int label)
+    { asm_operand o = { asm_operand::operand_label, label, NULL, 0 }; return o; }
+    inline asm_operand asm_sym(const char* name,int length)
+    { asm_operand o = { asm_operand::operand_symbol, 0, name, length }; return o; }
+
+    class elf_object;
+
     class code_generator
     {
     public:
@@ -29,16 +72,32 @@ namespace ramsey
         };
         static const int REGISTER_WIDTH;
 
-        code_generator(std::ostream& output);
+        // 'apart': number each function's labels apart (see 'write_apart'); 'object': encode
+        // the code into 'object' (see elfobj.h) instead of writing assembly to 'output'
+        code_generator(std::ostream& output,bool apart = false,elf_object* object = NULL);
 
         // handle function scheduling
         void begin_function(const char* name); // begin new stack frame following C calling convention
         void end_function(); // end stack frame; writes assembly code to output stream
+        // write the code of a function generated apart (which used 'nlabels' labels), numbering
+        // its labels as if the function had been generated by this generator
+        void write_apart(const std::string& code,int nlabels);
+        void write_apart(elf_object& part); // the functions encoded apart into 'part'
+        int function_labels() const // apart: the number of labels used by the last function
+        { return _lbl; }
+        elf_object* get_object() const
+        { return _object; }
 
-        // handle generic assembly text processing
-        void instruction(const char* format, ...); // write generic instruction to "function body"
-        void instruction_before(const char* format, ...); // write generic instruction to area before "function body"
-        void writeline(const char* format, ...); // write assembly code line with no special formatting to "function body"
+        // write an instruction (or a label) to the "function body"; the text is appended to
+        // the function's buffer as fragments, and is written out by 'end_function' (given
+        // an object, the instruction is encoded instead)
+        void emit(asm_opcode op)
+        { if (_object != NULL) encode(op,NULL,NULL,false); else { append(_body,op); _body += '\n'; } }
+        void emit(asm_opcode op,const asm_operand& a)
+        { if (_object != NULL) encode(op,&a,NULL,false); else emit_to(_body,op,a); }
+        void emit(asm_opcode op,const asm_operand& a,const asm_operand& b)
+        { if (_object != NULL) encode(op,&a,&b,false); else emit_to(_body,op,a,b); }
+        void emit_label(int label);
 
         // handle memory offsets for variables and arguments
         int next_variable_offset(token_t type);
@@ -60,7 +119,7 @@ namespace ramsey
 
         // handle unique label allocation
         int get_unique_label()
-        { return _lbl++; }
+        { return _apart ? -++_lbl : _lbl++; }
         int get_return_label();
         void add_store_label(int lbl)
         { _storlbls.push(lbl); }
@@ -70,18 +129,32 @@ namespace ramsey
         { _storlbls.pop(); }
     private:
         std::ostream& _output;
-        std::stringstream _before, _body;
+        std::string _before, _body; // the function's code before its body (written last), and its body
         int _alloc; // function stack allocation amount
         int _narg; // function argument counter
         std::queue<int> _allocations[3]; // for the stack allocator
         _register _reghead; // current available register
         _register _regnonvol; // all non-volatile registers up to and excluding this one need to be saved
         int _regcnt; // number of outstanding result registers
-        int _lbl, _retlbl; // current available local label, return label
+        int _lbl, _retlbl; // current available local label (apart: labels used by the function), return label
+        bool _apart; // labels are numbered apart in each function: -1, -2, ...
         std::stack<int> _storlbls; // stack of stored local labels
+        elf_object* _object;
+
+        // emit to the code before the function body
+        void emit_before(asm_opcode op,const asm_operand& a)
+        { if (_object != NULL) encode(op,&a,NULL,true); else emit_to(_before,op,a); }
+        void emit_before(asm_opcode op,const asm_operand& a,const asm_operand& b)
+        { if (_object != NULL) encode(op,&a,&b,true); else emit_to(_before,op,a,b); }
+        void encode(asm_opcode op,const asm_operand* a,const asm_operand* b,bool before);
 
-        static void instruction_impl(std::ostream&,const char*);
-        static void instruction_impl(std::ostream&,const char*,va_list);
+        static void emit_to(std::string& out,asm_opcode op,const asm_operand& a)
+        { append(out,op); append(out,a); out += '\n'; }
+        static void emit_to(std::string& out,asm_opcode op,const asm_operand& a,const asm_operand& b)
+        { append(out,op); append(out,a); out.append(", ",2); append(out,b); out += '\n'; }
+        static void append(std::string& out,asm_opcode op); // the mnemonic (padded to the operand column)
+        static void append(std::string& out,const asm_operand& operand);
+        static void append(std::string& out,int value);
         static const char* register_to_string(_register,token_t);
     };
 }
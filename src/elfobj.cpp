@@ -0,0 +1,554 @@
+/* elfobj.cpp */
+#include "elfobj.h"
+#include <cstring>
+#include <cctype>
+using namespace std;
+using namespace ramsey;
+
+// assembler_error
+assembler_error::assembler_error(const char* format, ...)
+{
+    va_list args;
+    va_start(args,format);
+    _cstor(format,args);
+    va_end(args);
+}
+
+namespace
+{
+    const char* const MNEMONIC_NAMES[] = {
+        "pushl", "push", "popl",
+        "movl", "movw", "movb", "movswl", "movsbl", "movzbl",
+        "addl", "subl", "imull", "idivl", "negl", "cdq",
+        "cmp", "cmpl", "cmpw", "cmpb", "sete",
+        "jmp", "je", "jne", "jl", "jg", "jle", "jge",
+        "call", "leave", "ret", "nop"
+    };
+
+    // the number of a register in the encoding; 'width' receives its size in bytes
+    int register_code(const char* name,int& width)
+    {
+        static const char WORD_NAMES[] = "axcxdxbxspbpsidi";
+        static const char BYTE_NAMES[] = "acdb";
+        if (name[0]!='\0' && name[1]=='l') {
+            width = 1;
+            for (int r = 0;r < 4;++r)
+                if (BYTE_NAMES[r] == name[0])
+                    return r;
+        }
+        else {
+            width = 2;
+            if (name[0] == 'e') {
+                width = 4;
+                ++name;
+            }
+            for (int r = 0;r < 8;++r)
+                if (WORD_NAMES[2*r]==name[0] && WORD_NAMES[2*r+1]==name[1])
+                    return r;
+        }
+        throw ramsey_exception("elf_object: bad register name");
+    }
+    // the size of a register operand, or 0 for any other operand
+    int operand_width(const asm_operand* operand)
+    {
+        int width = 0;
+        if (operand->kind == asm_operand::operand_register)
+            register_code(operand->text,width);
+        return width;
+    }
+    bool is_memory_or_register(const asm_operand* operand)
+    {
+        return operand->kind==asm_operand::operand_register || operand->kind==asm_operand::operand_memory;
+    }
+    bool is_immediate(const asm_operand* operand)
+    {
+        return operand->kind==asm_operand::operand_immediate || operand->kind==asm_operand::operand_literal;
+    }
+    bool fits_byte(int value)
+    {
+        return value>=-128 && value<=127;
+    }
+
+    void put(string& out,unsigned value,int width)
+    {
+        // the object is little-endian whatever the host is
+        for (int i = 0;i < width;++i,value >>= 8)
+            out += char(value & 0xff);
+    }
+    void align(string& out,size_t boundary)
+    {
+        while (out.size() % boundary != 0)
+            out += '\0';
+    }
+
+    // the opcodes of the two-operand instructions with a 32-bit operand; the 8-bit
+    // forms are one less, and 16-bit forms are the 32-bit ones with a 0x66 prefix
+    struct binary_form
+    {
+        unsigned char store; // register to register/memory
+        unsigned char load; // register/memory to register
+        unsigned char ext; // opcode extension of the immediate form
+        unsigned char acc; // immediate to the accumulator (0 if there is none)
+    };
+    const binary_form MOV_FORM = { 0x89, 0x8b, 0, 0 };
+    const binary_form ADD_FORM = { 0x01, 0x03, 0, 0x05 };
+    const binary_form SUB_FORM = { 0x29, 0x2b, 5, 0x2d };
+    const binary_form CMP_FORM = { 0x39, 0x3b, 7, 0x3d };
+
+    // ELF definitions used by the object
+    enum
+    {
+        ELF_HEADER_SIZE = 52,
+        ELF_SECTION_HEADER_SIZE = 40,
+        ELF_SYMBOL_SIZE = 16,
+        ELF_REL_SIZE = 8,
+        ET_REL = 1,
+        EM_386 = 3,
+        SHT_PROGBITS = 1,
+        SHT_SYMTAB = 2,
+        SHT_STRTAB = 3,
+        SHT_REL = 9,
+        SHF_ALLOC = 0x2,
+        SHF_EXECINSTR = 0x4,
+        SHF_INFO_LINK = 0x40,
+        STB_LOCAL = 0,
+        STB_GLOBAL = 1,
+        STT_NOTYPE = 0,
+        STT_FUNC = 2,
+        STT_SECTION = 3,
+        R_386_PC32 = 2
+    };
+    // the sections of the object, in order
+    enum
+    {
+        section_null,
+        section_text,
+        section_rel_text,
+        section_note_stack, // marks the object as not needing an executable stack
+        section_symtab,
+        section_strtab,
+        section_shstrtab,
+        section_count
+    };
+    const char SECTION_NAMES[] = "\0.text\0.rel.text\0.note.GNU-stack\0.symtab\0.strtab\0.shstrtab";
+    const int SECTION_NAME_OFFSETS[section_count] = { 0, 1, 7, 17, 33, 41, 49 };
+    const int LOCAL_SYMBOLS = 2; // the null symbol and the symbol of .text come before the functions
+}
+
+// elf_object
+elf_object::elf_object()
+    : _function(-1)
+{
+}
+void elf_object::begin_function(const char* name,int length)
+{
+    _function = symbol(name,length);
+    if (_symbols[_function].size >= 0)
+        throw assembler_error("symbol '%s' is already defined",_symbols[_function].name.c_str());
+}
+void elf_object::encode(asm_opcode op,const asm_operand* a,const asm_operand* b,bool before)
+{
+    // 'a' is the source and 'b' the destination (in the order that they are written)
+    string& out = before ? _before : _body;
+    const binary_form* form = NULL;
+    int width = 4;
+    switch (op) {
+    case op_pushl:
+    case op_push:
+    case op_popl:
+        if (operand_width(a) != 4)
+            mismatch(op);
+        out += char((op==op_popl ? 0x58 : 0x50) + register_code(a->text,width));
+        return;
+    case op_movw:
+    case op_cmpw:
+        width = 2;
+        break;
+    case op_movb:
+    case op_cmpb:
+        width = 1;
+        break;
+    case op_cmp: // the operand size is that of the register
+        if ((width = operand_width(b)) == 0 && (width = operand_width(a)) == 0)
+            mismatch(op);
+        break;
+    case op_movswl:
+    case op_movsbl:
+    case op_movzbl:
+        // register/memory to a wider register
+        if (operand_width(b) != 4 || !is_memory_or_register(a)
+                || (a->kind==asm_operand::operand_register && operand_width(a)!=(op==op_movswl ? 2 : 1)))
+            mismatch(op);
+        out += char(0x0f);
+        out += char(op==op_movswl ? 0xbf : op==op_movsbl ? 0xbe : 0xb6);
+        modrm(out,register_code(b->text,width),*a);
+        return;
+    case op_imull:
+        if (operand_width(b)!=4 || !is_memory_or_register(a) || (a->kind==asm_operand::operand_register && operand_width(a)!=4))
+            mismatch(op);
+        out += char(0x0f);
+        out += char(0xaf);
+        modrm(out,register_code(b->text,width),*a);
+        return;
+    case op_idivl:
+    case op_negl:
+        if (!is_memory_or_register(a) || (a->kind==asm_operand::operand_register && operand_width(a)!=4))
+            mismatch(op);
+        out += char(0xf7);
+        modrm(out,op==op_idivl ? 7 : 3,*a);
+        return;
+    case op_sete:
+        if (!is_memory_or_register(a) || (a->kind==asm_operand::operand_register && operand_width(a)!=1))
+            mismatch(op);
+        out += char(0x0f);
+        out += char(0x94);
+        modrm(out,0,*a);
+        return;
+    case op_cdq:
+        out += char(0x99);
+        return;
+    case op_leave:
+        out += char(0xc9);
+        return;
+    case op_ret:
+        out += char(0xc3);
+        return;
+    case op_nop:
+        out += char(0x90);
+        return;
+    case op_jmp:
+    case op_je:
+    case op_jne:
+    case op_jl:
+    case op_jg:
+    case op_jle:
+    case op_jge:
+        {
+            if (before || a->kind!=asm_operand::operand_label)
+                mismatch(op);
+            // the jump is inserted when the function ends; it is short until shown otherwise
+            fixup j = { int(_body.size()), int(_jumps.size()), a->value, (unsigned char)op, 2 };
+            _jumps.push_back(j);
+        }
+        return;
+    case op_call:
+        {
+            if (before || a->kind!=asm_operand::operand_symbol)
+                mismatch(op);
+            out += char(0xe8);
+            fixup c = { int(_body.size()), int(_jumps.size()), symbol(a->text,a->length), (unsigned char)op, 4 };
+            _calls.push_back(c);
+            put(out,unsigned(-4),4); // the addend: the displacement is from the end of the instruction
+        }
+        return;
+    default:
+        break;
+    }
+
+    // the remaining instructions move or combine two operands of 'width' bytes
+    if (op==op_movl || op==op_movw || op==op_movb)
+        form = &MOV_FORM;
+    else if (op == op_addl)
+        form = &ADD_FORM;
+    else if (op == op_subl)
+        form = &SUB_FORM;
+    else
+        form = &CMP_FORM;
+    int wa = operand_width(a), wb = operand_width(b);
+    if ((wa!=0 && wa!=width) || (wb!=0 && wb!=width) || !is_memory_or_register(b))
+        mismatch(op);
+    int byte = width==1 ? 1 : 0;
+    if (width == 2)
+        out += char(0x66);
+    if (is_immediate(a)) {
+        int value = immediate(*a);
+        if (form == &MOV_FORM) {
+            if (b->kind == asm_operand::operand_register)
+                out += char((width==1 ? 0xb0 : 0xb8) + register_code(b->text,wb));
+            else {
+                out += char(0xc7 - byte);
+                modrm(out,0,*b);
+            }
+            put(out,unsigned(value),width);
+        }
+        else if (width!=1 && fits_byte(value)) {
+            // a sign-extended byte
+            out += char(0x83);
+            modrm(out,form->ext,*b);
+            put(out,unsigned(value),1);
+        }
+        else {
+            if (b->kind==asm_operand::operand_register && register_code(b->text,wb)==0)
+                out += char(form->acc - byte);
+            else {
+                out += char(0x81 - byte);
+                modrm(out,form->ext,*b);
+            }
+            put(out,unsigned(value),width);
+        }
+    }
+    else if (a->kind == asm_operand::operand_register) {
+        out += char(form->store - byte);
+        modrm(out,register_code(a->text,wa),*b);
+    }
+    else if (a->kind==asm_operand::operand_memory && b->kind==asm_operand::operand_register) {
+        out += char(form->load - byte);
+        modrm(out,register_code(b->text,wb),*a);
+    }
+    else
+        mismatch(op);
+}
+void elf_object::label(int label)
+{
+    fixup l = { int(_body.size()), int(_jumps.size()), 0, 0, 0 };
+    _labels[label] = l;
+}
+void elf_object::end_function()
+{
+    /* lengthen each jump whose target is out of reach of the short form, until
+       every jump reaches its target: lengthening a jump can only put others out
+       of reach, so this ends; shift[k] is the length of the first k jumps */
+    size_t count = _jumps.size();
+    vector<int> shift(count+1,0), target(count), targetjumps(count);
+    for (size_t k = 0;k < count;++k) {
+        unordered_map<int,fixup>::const_iterator it = _labels.find(_jumps[k].target);
+        if (it == _labels.end())
+            throw ramsey_exception("elf_object::end_function: undefined label");
+        target[k] = it->second.pos;
+        targetjumps[k] = it->second.jumps;
+    }
+    bool grown;
+    do {
+        grown = false;
+        for (size_t k = 0;k < count;++k)
+            shift[k+1] = shift[k] + _jumps[k].size;
+        for (size_t k = 0;k < count;++k) {
+            int disp = (target[k] + shift[targetjumps[k]]) - (_jumps[k].pos + shift[k+1]);
+            if (_jumps[k].size==2 && !fits_byte(disp)) {
+                _jumps[k].size = _jumps[k].op==op_jmp ? 5 : 6;
+                grown = true;
+            }
+        }
+    } while (grown);
+
+    // write the code before the body, then the body with the jumps inserted
+    static const unsigned char CONDITIONS[] = { 0, 0x4, 0x5, 0xc, 0xf, 0xe, 0xd }; // by jump opcode from op_jmp
+    int base = int(_text.size()), start = base + int(_before.size());
+    _text += _before;
+    size_t p = 0;
+    for (size_t k = 0;k < count;++k) {
+        const fixup& j = _jumps[k];
+        _text.append(_body,p,j.pos - p);
+        p = j.pos;
+        int disp = (target[k] + shift[targetjumps[k]]) - (j.pos + shift[k+1]);
+        int cond = CONDITIONS[j.op - op_jmp];
+        if (j.size == 2) {
+            _text += char(j.op==op_jmp ? 0xeb : 0x70+cond);
+            put(_text,unsigned(disp),1);
+        }
+        else {
+            if (j.op == op_jmp)
+                _text += char(0xe9);
+            else {
+                _text += char(0x0f);
+                _text += char(0x80+cond);
+            }
+            put(_text,unsigned(disp),4);
+        }
+    }
+    _text.append(_body,p,string::npos);
+    for (size_t k = 0;k < _calls.size();++k) {
+        relocation r = { start + _calls[k].pos + shift[_calls[k].jumps], _calls[k].target };
+        _relocs.push_back(r);
+    }
+    _symbols[_function].offset = base;
+    _symbols[_function].size = int(_text.size()) - base;
+
+    // reset the function (the buffers keep their storage for the next function)
+    _function = -1;
+    _before.clear(); _body.clear();
+    _jumps.clear(); _calls.clear();
+    _labels.clear();
+}
+void elf_object::append(elf_object& part)
+{
+    int base = int(_text.size());
+    vector<int> symbols(part._symbols.size());
+    _text += part._text;
+    for (size_t i = 0;i < part._symbols.size();++i) {
+        const function_symbol& s = part._symbols[i];
+        symbols[i] = symbol(s.name.data(),int(s.name.size()));
+        if (s.size >= 0) {
+            function_symbol& t = _symbols[symbols[i]];
+            if (t.size >= 0)
+                throw assembler_error("symbol '%s' is already defined",t.name.c_str());
+            t.offset = base + s.offset;
+            t.size = s.size;
+        }
+    }
+    for (size_t i = 0;i < part._relocs.size();++i) {
+        relocation r = { base + part._relocs[i].offset, symbols[part._relocs[i].symb] };
+        _relocs.push_back(r);
+    }
+    part._text.clear();
+    part._symbols.clear();
+    part._symbolmap.clear();
+    part._relocs.clear();
+}
+void elf_object::write(ostream& output) const
+{
+    // the ELF header is written last, once the offset of the section headers is known
+    string out(ELF_HEADER_SIZE,'\0'), strtab(1,'\0');
+    int offsets[section_count], sizes[section_count];
+    offsets[section_null] = sizes[section_null] = 0;
+    offsets[section_text] = int(out.size());
+    out += _text;
+    sizes[section_text] = int(_text.size());
+    align(out,4);
+    offsets[section_rel_text] = int(out.size());
+    for (size_t i = 0;i < _relocs.size();++i) {
+        put(out,unsigned(_relocs[i].offset),4);
+        put(out,unsigned(_relocs[i].symb + LOCAL_SYMBOLS) << 8 | R_386_PC32,4);
+    }
+    sizes[section_rel_text] = int(out.size()) - offsets[section_rel_text];
+    offsets[section_note_stack] = int(out.size());
+    sizes[section_note_stack] = 0;
+    offsets[section_symtab] = int(out.size());
+    out.append(ELF_SYMBOL_SIZE,'\0'); // the null symbol
+    put(out,0,4); put(out,0,4); put(out,0,4); // .text
+    put(out,STB_LOCAL<<4 | STT_SECTION,1); put(out,0,1); put(out,section_text,2);
+    for (size_t i = 0;i < _symbols.size();++i) {
+        const function_symbol& s = _symbols[i];
+        bool defined = s.size >= 0;
+        put(out,unsigned(strtab.size()),4);
+        put(out,defined ? unsigned(s.offset) : 0,4);
+        put(out,defined ? unsigned(s.size) : 0,4);
+        put(out,STB_GLOBAL<<4 | (defined ? STT_FUNC : STT_NOTYPE),1);
+        put(out,0,1);
+        put(out,defined ? section_text : 0,2);
+        strtab.append(s.name.c_str(),s.name.size()+1);
+    }
+    sizes[section_symtab] = int(out.size()) - offsets[section_symtab];
+    offsets[section_strtab] = int(out.size());
+    out += strtab;
+    sizes[section_strtab] = int(strtab.size());
+    offsets[section_shstrtab] = int(out.size());
+    out.append(SECTION_NAMES,sizeof(SECTION_NAMES));
+    sizes[section_shstrtab] = int(sizeof(SECTION_NAMES));
+    align(out,4);
+
+    // section headers: the name, offset and size are filled in; the rest is
+    // type, flags, address, link, info, alignment and entry size
+    static const unsigned SECTIONS[section_count][7] = {
+        { 0, 0, 0, 0, 0, 0, 0 },
+        { SHT_PROGBITS, SHF_ALLOC|SHF_EXECINSTR, 0, 0, 0, 1, 0 },
+        { SHT_REL, SHF_INFO_LINK, 0, section_symtab, section_text, 4, ELF_REL_SIZE },
+        { SHT_PROGBITS, 0, 0, 0, 0, 1, 0 },
+        { SHT_SYMTAB, 0, 0, section_strtab, LOCAL_SYMBOLS, 4, ELF_SYMBOL_SIZE },
+        { SHT_STRTAB, 0, 0, 0, 0, 1, 0 },
+        { SHT_STRTAB, 0, 0, 0, 0, 1, 0 }
+    };
+    int shoff = int(out.size());
+    for (int i = 0;i < section_count;++i) {
+        const unsigned* s = SECTIONS[i];
+        put(out,i==section_null ? 0 : SECTION_NAME_OFFSETS[i],4);
+        put(out,s[0],4); put(out,s[1],4); put(out,s[2],4);
+        put(out,unsigned(offsets[i]),4); put(out,unsigned(sizes[i]),4);
+        put(out,s[3],4); put(out,s[4],4); put(out,s[5],4); put(out,s[6],4);
+    }
+
+    // ELF header
+    string header("\x7f" "ELF\x01\x01\x01",7);
+    header.resize(16,'\0');
+    put(header,ET_REL,2);
+    put(header,EM_386,2);
+    put(header,1,4); // version
+    put(header,0,4); // entry
+    put(header,0,4); // program headers
+    put(header,unsigned(shoff),4);
+    put(header,0,4); // flags
+    put(header,ELF_HEADER_SIZE,2);
+    put(header,0,2); put(header,0,2); // program header size and count
+    put(header,ELF_SECTION_HEADER_SIZE,2);
+    put(header,section_count,2);
+    put(header,section_shstrtab,2);
+    out.replace(0,ELF_HEADER_SIZE,header);
+    output.write(out.data(),out.size());
+}
+void elf_object::link(char* code) const
+{
+    memcpy(code,_text.data(),_text.size());
+    for (size_t i = 0;i < _relocs.size();++i) {
+        const relocation& r = _relocs[i];
+        const function_symbol& f = _symbols[r.symb];
+        if (f.size < 0)
+            throw assembler_error("undefined reference to '%s'",f.name.c_str());
+        string disp;
+        put(disp,unsigned(f.offset - (r.offset+4)),4);
+        memcpy(code+r.offset,disp.data(),4);
+    }
+}
+int elf_object::function_offset(const char* name) const
+{
+    unordered_map<string,int>::const_iterator it = _symbolmap.find(name);
+    if (it==_symbolmap.end() || _symbols[it->second].size<0)
+        return -1;
+    return _symbols[it->second].offset;
+}
+int elf_object::symbol(const char* name,int length)
+{
+    string s(name,length);
+    unordered_map<string,int>::const_iterator it = _symbolmap.find(s);
+    if (it != _symbolmap.end())
+        return it->second;
+    function_symbol f;
+    f.name = s;
+    f.offset = 0;
+    f.size = -1;
+    _symbols.push_back(f);
+    _symbolmap[s] = int(_symbols.size()) - 1;
+    return int(_symbols.size()) - 1;
+}
+void elf_object::modrm(string& out,int reg,const asm_operand& rm)
+{
+    int width;
+    if (rm.kind == asm_operand::operand_register)
+        out += char(0xc0 | reg<<3 | register_code(rm.text,width));
+    else if (fits_byte(rm.value)) { // disp8(%ebp)
+        out += char(0x45 | reg<<3);
+        put(out,unsigned(rm.value),1);
+    }
+    else { // disp32(%ebp)
+        out += char(0x85 | reg<<3);
+        put(out,unsigned(rm.value),4);
+    }
+}
+int elf_object::immediate(const asm_operand& operand)
+{
+    if (operand.kind == asm_operand::operand_immediate)
+        return operand.value;
+    // a literal is read as the assembler reads it ("0x..." is hexadecimal
+    // and a leading zero is octal), and is truncated to 32 bits
+    const char* p = operand.text, *e = p + operand.length;
+    unsigned base = 10, value = 0;
+    if (e-p>1 && p[0]=='0') {
+        base = 8;
+        ++p;
+        if (*p=='x' || *p=='X') {
+            base = 16;
+            ++p;
+        }
+    }
+    for (;p < e;++p) {
+        unsigned char c = (unsigned char)*p;
+        unsigned d = isdigit(c) ? unsigned(c-'0') : isxdigit(c) ? unsigned(tolower(c)-'a'+10) : base;
+        if (d >= base)
+            throw assembler_error("function '%s': bad number '%.*s'",_symbols[_function].name.c_str(),operand.length,operand.text);
+        value = value*base + d;
+    }
+    return int(value);
+}
+void elf_object::mismatch(asm_opcode op) const
+{
+    throw assembler_error("function '%s': operand type mismatch for '%s'",_symbols[_function].name.c_str(),MNEMONIC_NAMES[op]);
+}
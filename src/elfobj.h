@@ -0,0 +1,91 @@
+/* elfobj.h - integrated assembler: IA-32 machine code in an ELF32 object */
+#ifndef ELFOBJ_H
+#define ELFOBJ_H
+#include "codegen.h"
+#include "ramsey-error.h"
+#include <ostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace ramsey
+{
+    class assembler_error : public compiler_error_generic // errors reported to user
+    {
+    public:
+        assembler_error(const char* format, ...);
+        virtual ~assembler_error() throw() {}
+    };
+
+    /* elf_object: encodes the instructions that the code generator emits into
+       machine code, one function at a time, and writes the code as an ELF32
+       relocatable object that can be linked without running the assembler;
+       each function is a global symbol, and each call has an R_386_PC32
+       relocation against the function it calls; jumps are local to a function
+       and are resolved when the function ends: they are encoded in the short
+       form unless their target is out of its reach (as the GNU assembler does) */
+    class elf_object
+    {
+    public:
+        elf_object();
+
+        // encode a function; the code 'before' is placed ahead of its body (see code_generator)
+        void begin_function(const char* name,int length);
+        void encode(asm_opcode op,const asm_operand* a = NULL,const asm_operand* b = NULL,bool before = false);
+        void label(int label);
+        void end_function();
+
+        // move the functions encoded in 'part' to the end of this object
+        void append(elf_object& part);
+
+        void write(std::ostream& output) const;
+        size_t code_size() const
+        { return _text.size(); }
+
+        // link the code in place: copy it to 'code' (which holds 'code_size' bytes)
+        // with the calls resolved against the functions in this object; the
+        // calls are relative, so the code runs wherever it is copied
+        void link(char* code) const;
+        int function_offset(const char* name) const; // -1 if the object does not define 'name'
+    private:
+        struct function_symbol
+        {
+            std::string name;
+            int offset, size; // size is -1 if the function is not defined in the object
+        };
+        struct relocation
+        {
+            int offset, symb;
+        };
+        struct fixup // a jump or a call in the body of the function being encoded
+        {
+            int pos; // offset in '_body' where the jump is inserted, or of the call's displacement
+            int jumps; // number of jumps inserted before 'pos'
+            int target; // jump: label; call: symbol
+            unsigned char op; // jump: asm_opcode; call: op_call
+            unsigned char size; // jump: encoded length
+        };
+
+        std::string _text; // the code of the functions encoded so far
+        std::vector<function_symbol> _symbols;
+        std::unordered_map<std::string,int> _symbolmap;
+        std::vector<relocation> _relocs;
+
+        // the function being encoded
+        int _function;
+        std::string _before, _body;
+        std::vector<fixup> _jumps, _calls;
+        std::unordered_map<int,fixup> _labels; // the position of each label (its 'target' is unused)
+
+        int symbol(const char* name,int length);
+        void modrm(std::string& out,int reg,const asm_operand& rm);
+        int immediate(const asm_operand& operand);
+        void mismatch(asm_opcode op) const;
+
+        // disallow copying
+        elf_object(const elf_object&);
+        elf_object& operator =(const elf_object&);
+    };
+}
+
+#endif
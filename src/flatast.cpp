@@ -0,0 +1,301 @@
+/* flatast.cpp - lowering of the linked AST into the flat_ast arrays */
+#include "flatast.h"
+using namespace std;
+using namespace ramsey;
+
+// flat_ast::flat_symbol
+flat_ast::flat_symbol::flat_symbol(token identifier,token_t t,skind k,int line)
+    : id(identifier), type(t), kind(k), lineno(line), argtypes(-1), argtypes_ptr(NULL)
+{
+}
+
+// flat_ast::walk_frame
+flat_ast::walk_frame::walk_frame(int n)
+    : node(n), step(0), next(0), last(0), elf(-1), own(false), reg(NULL), dst(-1), acc(-1), lhs(-1), mark(0)
+{
+    labels[0] = labels[1] = labels[2] = 0;
+}
+
+// flat_ast
+flat_ast::flat_ast(const ast_node* root)
+{
+    const ast_function_node* head = static_cast<const ast_function_node*>(root);
+    // the function symbols come first so that function 'i' is symbol 'i'
+    for (const ast_function_node* f = head;f != NULL;f = f->get_next()) {
+        _symbols.push_back( flat_symbol(f->_id,f->_typespec.valid() ? f->_typespec.type() : token_in,
+                symbol::skind_function,f->get_lineno()) );
+        _symbols.back().argtypes = int(_argtypes.size());
+        const token_t* p = f->_argtypes.begin();
+        do _argtypes.push_back(*p); while (*p++ != token_invalid);
+    }
+    int i = 0;
+    for (const ast_function_node* f = head;f != NULL;f = f->get_next(),++i) {
+        function_node fn;
+        fn.symb = i;
+        fn.params.first = int(_symbols.size());
+        for (const ast_parameter_node* p = f->_param;p != NULL;p = p->get_next())
+            _symbols.push_back( flat_symbol(p->_id,p->_typespec.type(),symbol::skind_variable,p->get_lineno()) );
+        fn.params.count = int(_symbols.size()) - fn.params.first;
+        fn.body = lower_statements(f->_statements);
+        while ( !_lowerstmts.empty() ) { // lower the statements queued for the body
+            lower_statement_item item = _lowerstmts.back();
+            _lowerstmts.pop_back();
+            lower_statement(item.node,item.slot);
+        }
+        _functions.push_back(fn);
+    }
+    // the arrays are complete: resolve the parameter type lists
+    for (i = 0;i < int(_functions.size());++i)
+        _symbols[i].argtypes_ptr = &_argtypes[_symbols[i].argtypes];
+}
+flat_ast::range flat_ast::lower_statements(const ast_statement_node* list)
+{
+    // reserve a contiguous slot for each statement in the list, then queue
+    // each one on '_lowerstmts' to be lowered into its slot (their own
+    // children are placed after them)
+    range r;
+    r.first = int(_statements.size());
+    r.count = 0;
+    for (const ast_statement_node* n = list;n != NULL;n = n->get_next())
+        ++r.count;
+    _statements.resize(r.first + r.count);
+    // queue the statements last to first so that they are lowered in order
+    size_t base = _lowerstmts.size();
+    _lowerstmts.resize(base + r.count);
+    int slot = r.first;
+    for (const ast_statement_node* n = list;n != NULL;n = n->get_next(),++slot) {
+        lower_statement_item& item = _lowerstmts[base + r.first+r.count-1-slot];
+        item.node = n;
+        item.slot = slot;
+    }
+    return r;
+}
+void flat_ast::lower_statement(const ast_statement_node* node,int slot)
+{
+    statement_node s = statement_node();
+    s.a = s.b = -1;
+    // expression-statements are expression nodes linked into the statement list
+    const ast_expression_node* expr = dynamic_cast<const ast_expression_node*>(static_cast<const ast_node*>(node));
+    if (expr != NULL) {
+        s.kind = ast_statement_node::ast_expression_statement;
+        s.lineno = expr->get_lineno();
+        s.a = lower_expression(expr);
+        _statements[slot] = s;
+        return;
+    }
+    s.kind = node->get_kind();
+    s.lineno = node->get_lineno();
+    switch (node->get_kind()) {
+    case ast_statement_node::ast_declaration_statement:
+        {
+            const ast_declaration_statement_node* n = static_cast<const ast_declaration_statement_node*>(node);
+            s.a = int(_symbols.size());
+            _symbols.push_back( flat_symbol(n->_id,n->_typespec.type(),symbol::skind_variable,n->get_lineno()) );
+            if (n->_initializer != NULL)
+                s.b = lower_expression(n->_initializer);
+            _statements[slot] = s;
+        }
+        break;
+    case ast_statement_node::ast_selection_statement:
+        {
+            const ast_selection_statement_node* n = static_cast<const ast_selection_statement_node*>(node);
+            s.a = lower_expression(n->_condition);
+            s.body = lower_statements(n->_body);
+            s.b = lower_elf(n->_elf);
+            s.other = lower_statements(n->_else);
+            _statements[slot] = s;
+        }
+        break;
+    case ast_statement_node::ast_iterative_statement:
+        {
+            const ast_iterative_statement_node* n = static_cast<const ast_iterative_statement_node*>(node);
+            s.a = lower_expression(n->_condition);
+            s.body = lower_statements(n->_body);
+            _statements[slot] = s;
+        }
+        break;
+    case ast_statement_node::ast_jump_statement:
+        {
+            const ast_jump_statement_node* n = static_cast<const ast_jump_statement_node*>(node);
+            if (n->_expr != NULL)
+                s.a = lower_expression(n->_expr);
+            _statements[slot] = s;
+        }
+        break;
+    default:
+#ifdef RAMSEY_DEBUG
+        throw ast_exception("flat_ast::lower_statement: bad statement kind");
+#endif
+        break;
+    }
+}
+int flat_ast::lower_elf(const ast_elf_node* node)
+{
+    // lower a chain of elf statements (if any); each one links to the next
+    int first = -1, prev = -1;
+    for (;node != NULL;node = node->_elf) {
+        int slot = int(_statements.size());
+        statement_node s = statement_node();
+        s.kind = ast_statement_node::ast_selection_elf_statement;
+        s.lineno = node->get_lineno();
+        s.b = -1;
+        _statements.push_back(s);
+        s.a = lower_expression(node->_condition);
+        s.body = lower_statements(node->_body);
+        _statements[slot] = s;
+        if (prev >= 0)
+            _statements[prev].b = slot;
+        else
+            first = slot;
+        prev = slot;
+    }
+    return first;
+}
+int flat_ast::lower_expression(const ast_expression_node* node)
+{
+    // lower the expression tree with a stack of the nodes left to lower (each
+    // with the slot reserved for it), so its depth is not bound by recursion
+    int slot = reserve_expressions(1);
+    size_t base = _lowerexprs.size();
+    lower_expression_item item = { node, slot, 0 };
+    _lowerexprs.push_back(item);
+    do {
+        item = _lowerexprs.back();
+        _lowerexprs.pop_back();
+        lower_expression(item.node,item.slot,item.infix);
+    } while (_lowerexprs.size() > base);
+    return slot;
+}
+void flat_ast::lower_expression(const ast_expression_node* node,int slot,int infix)
+{
+    // the node is written to its slot, then its operands are queued to be
+    // lowered into the contiguous range reserved after it; they are queued
+    // last to first so that they are lowered in order
+    expression_node x;
+    lower_expression_item item;
+    x.kind = (unsigned char)node->get_kind();
+    x.op = 0;
+    x.infix = (unsigned char)infix;
+    x.type = token_invalid;
+    x.lineno = node->get_lineno();
+    x.a = x.b = 0;
+    switch (node->get_kind()) {
+    case ast_expression_node::ast_assignment_expression:
+        {
+            const ast_assignment_expression_node* n = static_cast<const ast_assignment_expression_node*>(node);
+            x.a = reserve_expressions(x.b = 2);
+            _expressions[slot] = x;
+            for (int i = 1;i >= 0;--i) {
+                item.node = n->_ops[i].node; item.slot = x.a+i; item.infix = 0;
+                _lowerexprs.push_back(item);
+            }
+        }
+        break;
+    case ast_expression_node::ast_logical_or_expression:
+    case ast_expression_node::ast_logical_and_expression:
+        {
+            const arena_array<ast_expression_node::operand>& ops = node->get_kind() == ast_expression_node::ast_logical_or_expression
+                ? static_cast<const ast_logical_or_expression_node*>(node)->_ops
+                : static_cast<const ast_logical_and_expression_node*>(node)->_ops;
+            x.a = reserve_expressions(x.b = int(ops.size()));
+            _expressions[slot] = x;
+            for (int i = x.b-1;i >= 0;--i) {
+                item.node = ops[i].node; item.slot = x.a+i; item.infix = 0;
+                _lowerexprs.push_back(item);
+            }
+        }
+        break;
+    case ast_expression_node::ast_equality_expression:
+    case ast_expression_node::ast_relational_expression:
+        {
+            const ast_expression_node::operand* ops;
+            if (node->get_kind() == ast_expression_node::ast_equality_expression) {
+                const ast_equality_expression_node* n = static_cast<const ast_equality_expression_node*>(node);
+                x.op = (unsigned char)n->_operator.type();
+                ops = n->_operands;
+            }
+            else {
+                const ast_relational_expression_node* n = static_cast<const ast_relational_expression_node*>(node);
+                x.op = (unsigned char)n->_operator.type();
+                ops = n->_operands;
+            }
+            x.a = reserve_expressions(x.b = 2);
+            _expressions[slot] = x;
+            for (int i = 1;i >= 0;--i) {
+                item.node = ops[i].node; item.slot = x.a+i; item.infix = 0;
+                _lowerexprs.push_back(item);
+            }
+        }
+        break;
+    case ast_expression_node::ast_additive_expression:
+    case ast_expression_node::ast_multiplicative_expression:
+        {
+            const arena_array<ast_expression_node::operand>* ops;
+            const arena_array<token>* opers;
+            if (node->get_kind() == ast_expression_node::ast_additive_expression) {
+                const ast_additive_expression_node* n = static_cast<const ast_additive_expression_node*>(node);
+                ops = &n->_operands; opers = &n->_operators;
+            }
+            else {
+                const ast_multiplicative_expression_node* n = static_cast<const ast_multiplicative_expression_node*>(node);
+                ops = &n->_operands; opers = &n->_operators;
+            }
+            x.a = reserve_expressions(x.b = int(ops->size()));
+            _expressions[slot] = x;
+            for (int i = x.b-1;i >= 0;--i) {
+                item.node = (*ops)[i].node; item.slot = x.a+i;
+                // each operand after the first records the operator that precedes it
+                item.infix = i > 0 ? (unsigned char)(*opers)[i-1].type() : 0;
+                _lowerexprs.push_back(item);
+            }
+        }
+        break;
+    case ast_expression_node::ast_prefix_expression:
+        {
+            const ast_prefix_expression_node* n = static_cast<const ast_prefix_expression_node*>(node);
+            x.op = (unsigned char)n->_operator.type();
+            x.a = reserve_expressions(x.b = 1);
+            _expressions[slot] = x;
+            item.node = n->_operand.node; item.slot = x.a; item.infix = 0;
+            _lowerexprs.push_back(item);
+        }
+        break;
+    case ast_expression_node::ast_postfix_expression:
+        {
+            // the callee and its arguments form one contiguous range
+            const ast_postfix_expression_node* n = static_cast<const ast_postfix_expression_node*>(node);
+            x.b = 1;
+            for (const ast_expression_node* p = n->_expList;p != NULL;p = p->get_next())
+                ++x.b;
+            x.a = reserve_expressions(x.b);
+            _expressions[slot] = x;
+            size_t top = _lowerexprs.size();
+            _lowerexprs.resize(top + x.b);
+            int i = x.b-1;
+            _lowerexprs[top+i].node = n->_op.node;
+            for (const ast_expression_node* p = n->_expList;p != NULL;p = p->get_next())
+                _lowerexprs[top + --i].node = p;
+            for (i = 0;i < x.b;++i) {
+                _lowerexprs[top+i].slot = x.a + x.b-1-i;
+                _lowerexprs[top+i].infix = 0;
+            }
+        }
+        break;
+    case ast_expression_node::ast_primary_expression:
+        {
+            const ast_primary_expression_node* n = static_cast<const ast_primary_expression_node*>(node);
+            x.op = (unsigned char)n->_tok.type();
+            x.a = int(_tokens.size());
+            x.b = -1;
+            _tokens.push_back(n->_tok);
+            _expressions[slot] = x;
+        }
+        break;
+    }
+}
+int flat_ast::reserve_expressions(int count)
+{
+    int first = int(_expressions.size());
+    _expressions.resize(first + count);
+    return first;
+}
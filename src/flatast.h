@@ -0,0 +1,183 @@
+/* flatast.h - data-oriented form of the abstract syntax tree */
+#ifndef FLATAST_H
+#define FLATAST_H
+#include "ast.h" // gets lexer.h, stable.h, codegen.h
+#include <vector>
+
+namespace ramsey
+{
+    class bytecode_module;
+
+    /* flat_ast: the AST lowered into contiguous arrays of plain nodes (one
+       array per construct: functions, statements, expressions) that refer
+       to their children by 32-bit index; every list of children (a statement
+       body, the operands of an expression, a call and its arguments) is a
+       contiguous index range, so both passes walk the arrays linearly and
+       dispatch with a switch on the node kind instead of virtual calls; the
+       passes perform the same checks and produce the same output as the
+       ast_node passes */
+    class flat_ast
+    {
+    public:
+        flat_ast(const ast_node* root); // lower the function list built by the parser
+
+        void check_semantics(stable& symtable); // a scope should already exist in 'symtable'
+        void generate_code(code_generator& generator); // semantic analysis must have bound the identifiers
+        void generate_bytecode(bytecode_module& module); // (see bytecode.h) likewise
+
+        int function_count() const
+        { return int(_functions.size()); }
+        int statement_count() const
+        { return int(_statements.size()); }
+        int expression_count() const
+        { return int(_expressions.size()); }
+    private:
+        struct range
+        {
+            int first, count;
+        };
+        struct function_node
+        {
+            int symb; // index of the function's symbol
+            range params; // parameter symbols
+            range body; // statements
+        };
+        struct statement_node
+        {
+            unsigned char kind; // ast_statement_node::ast_statement_kind
+            int lineno;
+            /* declaration:  a=symbol, b=initializer (or -1)
+               expression:   a=expression
+               selection:    a=condition, b=elf statement (or -1), body=if-body, other=else-body
+               elf:          a=condition, b=next elf statement (or -1), body=elf-body
+               iterative:    a=condition, body=loop-body
+               jump:         a=toss expression (or -1 for smash) */
+            int a, b;
+            range body, other;
+        };
+        struct expression_node
+        {
+            unsigned char kind; // ast_expression_node::ast_expression_kind
+            unsigned char op; // token kind of a primary expression; operator of prefix, equality and relational expressions
+            unsigned char infix; // operator preceding this operand in an additive or multiplicative expression
+            signed char type; // evaluated type (token_t); set by semantic analysis
+            int lineno;
+            /* primary:  a=token index, b=bound symbol (or -1); set by semantic analysis
+               others:   operands a..a+b-1 (postfix: the callee followed by the arguments) */
+            int a, b;
+        };
+        class flat_symbol : public symbol
+        {
+        public:
+            flat_symbol(token id,token_t type,skind kind,int lineno);
+
+            token id;
+            token_t type;
+            skind kind;
+            int lineno;
+            int argtypes; // function: index of parameter types in '_argtypes'
+            const token_t* argtypes_ptr;
+        private:
+            virtual std::string get_name_impl() const
+            { return id.source_string(); }
+            virtual int get_ident_impl() const
+            { return id.ident(); }
+            virtual token_t get_type_impl() const
+            { return type; }
+            virtual skind get_kind_impl() const
+            { return kind; }
+            virtual const token_t* get_argtypes_impl() const
+            { return argtypes_ptr; }
+        };
+
+        std::vector<function_node> _functions;
+        std::vector<statement_node> _statements;
+        std::vector<expression_node> _expressions;
+        std::vector<flat_symbol> _symbols; // functions first (in source order), then parameters and declarations
+        std::vector<token> _tokens; // tokens of primary expressions
+        std::vector<token_t> _argtypes; // parameter types of each function (each list terminated by token_invalid)
+        std::vector<token_t> _argstack; // scratch: argument types of the call being checked
+
+        /* the lowering and both passes walk nested constructs with explicit stacks
+           instead of recursing, so the depth of the tree does not bound the native
+           stack; lowering keeps the nodes left to lower, and each pass keeps on
+           '_walk' the expressions and statement blocks it is visiting */
+        struct lower_statement_item
+        {
+            const ast_statement_node* node;
+            int slot;
+        };
+        struct lower_expression_item
+        {
+            const ast_expression_node* node;
+            int slot;
+            unsigned char infix;
+        };
+        enum block_kind
+        {
+            block_function,
+            block_if,
+            block_elf,
+            block_else,
+            block_loop
+        };
+        struct walk_frame
+        {
+            walk_frame(int n);
+
+            int node; // expression, or statement that owns a block
+            int step; // expression: next step; block: block_kind
+            int next, last; // operands (or statements of a block) left to visit
+            int elf; // elf statement that owns a block
+            int labels[3];
+            bool own; // did the expression allocate its result register?
+            const char* reg;
+            int dst, acc, lhs, mark; // bytecode: target, result and left operand registers; registers in use before the operands
+        };
+        struct condition_item // bytecode: jump to 'label' if expression 'e' is 'when' (or bind 'label' if 'e' is -1)
+        {
+            int e, label;
+            bool when;
+        };
+        std::vector<lower_statement_item> _lowerstmts;
+        std::vector<lower_expression_item> _lowerexprs;
+        std::vector<walk_frame> _walk;
+        std::vector<condition_item> _conditions;
+        std::vector<bool> _assigns; // bytecode: does the expression contain an assignment?
+
+        // lowering
+        range lower_statements(const ast_statement_node* list);
+        void lower_statement(const ast_statement_node* node,int slot);
+        int lower_elf(const ast_elf_node* node);
+        int lower_expression(const ast_expression_node* node);
+        void lower_expression(const ast_expression_node* node,int slot,int infix);
+        int reserve_expressions(int count);
+
+        // semantic analysis
+        const flat_symbol* lookup(const stable& symtable,int ident) const;
+        walk_frame& open_block(range body,int kind,int stmt);
+        void semantics_statements(stable& symtable,range body);
+        token_t semantics_expression(stable& symtable,int e);
+        int semantics_step(stable& symtable,walk_frame& w);
+
+        // code generation
+        void codegen_statements(code_generator& cgen,range body);
+        void codegen_condition(code_generator& cgen,int e);
+        const char* codegen_expression(code_generator& cgen,int e,bool alloc = false);
+        int codegen_step(code_generator& cgen,walk_frame& w);
+
+        // bytecode generation
+        void bytecode_statements(bytecode_module& module,range body);
+        void bytecode_condition(bytecode_module& module,int e,int label,bool when);
+        int bytecode_expression(bytecode_module& module,int e,int dst);
+        int bytecode_step(bytecode_module& module,walk_frame& w,int& value,int& dst);
+        void bytecode_store(bytecode_module& module,const flat_symbol& var,int value,int mark);
+        bool bytecode_literal(int e,int& value) const;
+
+        // disallow copying
+        flat_ast(const flat_ast&);
+        flat_ast& operator =(const flat_ast&);
+    };
+}
+
+#endif
@@ -2,6 +2,7 @@
 #ifndef GCCBUILD_H
 #define GCCBUILD_H
 #include <ostream>
+#include <string>
 #include "ramsey-error.h"
 
 namespace ramsey
@@ -15,11 +16,13 @@ namespace ramsey
 
     // invoke GCC tools to build binary executable file
     // given a command-line and compiled ramsey source (as
-    // a stream of ASM code)
+    // a stream of ASM code, or an object file)
     class gccbuilder
     {
     public:
-        gccbuilder(int argc,const char* argv[]);
+        // 'object': the code stream is an ELF object (see elfobj.h), which is written to a
+        // temporary file and linked; otherwise the stream is assembly, piped to gcc
+        gccbuilder(int argc,const char* argv[],bool object = false);
         ~gccbuilder(); // wait for the process to build
 
         const char* ramfile() const
@@ -27,7 +30,10 @@ namespace ramsey
         const char* cfile() const
         { return _cfile; }
 
+        // start gcc: assembly is read as it is written to the code stream, while
+        // an object must be complete (gcc only links it)
         void execute();
+        void abort(); // stop the build (if it is executing) so that nothing is built; the code stream is dropped
         std::ostream& get_code_stream()
         { return _stream; }
     private:
@@ -42,6 +48,7 @@ namespace ramsey
         const char* _ramfile;
         const char* _cfile;
         short _flags;
+        std::string _objfile; // the temporary object file
         void* _pi;
     };
 }
@@ -1,9 +1,14 @@
 /* gccbuild_posix.cpp */
 #include "gccbuild.h"
 #include <streambuf>
+#include <fstream>
 #include <cstring>
+#include <cstdlib>
+#include <cerrno>
 #include <unistd.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 using namespace std;
 using namespace ramsey;
@@ -17,7 +22,8 @@ gccbuilder_error::gccbuilder_error(const char* format, ...)
     va_end(args);
 }
 
-// pipebuf
+// pipebuf: small writes are gathered in a large buffer; a write that does not
+// fit is sent along with the buffered data in one 'writev', so it is never copied
 class pipebuf : public streambuf
 {
 public:
@@ -28,11 +34,16 @@ public:
     { return _pfd[0]; }
     void close_write_fd();
     void close_read_fd();
+    void discard() // drop the data in the buffer
+    { setp(_buffer,_buffer+BUFSIZE); }
 private:
-    static const ptrdiff_t BUFSIZE = 4096;
+    static const ptrdiff_t BUFSIZE = 65536;
+    static const int PIPESIZE = 1048576; // requested pipe capacity
 
     virtual int_type overflow(int_type);
     virtual int sync();
+    virtual streamsize xsputn(const char*,streamsize);
+    void write_all(iovec* iov,int cnt);
 
     // disallow copying
     pipebuf(const pipebuf&);
@@ -46,6 +57,11 @@ pipebuf::pipebuf()
 {
     if (pipe(_pfd) == -1)
         throw ramsey_exception("fail pipe()");
+#ifdef F_SETPIPE_SZ
+    // a larger pipe lets the generator run ahead of the assembler; the
+    // default capacity is kept if the system limit is lower
+    fcntl(_pfd[1],F_SETPIPE_SZ,PIPESIZE);
+#endif
     setp(_buffer,_buffer+BUFSIZE);
 }
 pipebuf::~pipebuf()
@@ -76,8 +92,9 @@ streambuf::int_type pipebuf::overflow(streambuf::int_type ch)
     char* base = pbase(), *e = pptr();
     ptrdiff_t n = e - base;
     *e = ch; // guarenteed to be present at end of buffer
-    if (write(_pfd[1],base,n+1) == -1)
-        throw ramsey_exception("fail write()");
+    iovec iov;
+    iov.iov_base = base; iov.iov_len = n+1;
+    write_all(&iov,1);
     pbump(-n);
     return ch;
 }
@@ -87,16 +104,53 @@ int pipebuf::sync()
     char* base = pbase(), *e = pptr();
     ptrdiff_t n = e - base;
     if (n > 0) {
-        if (write(_pfd[1],base,n) == -1)
-            throw ramsey_exception("fail write()");
+        iovec iov;
+        iov.iov_base = base; iov.iov_len = n;
+        write_all(&iov,1);
         pbump(-n);
     }
     return 0;
 }
+streamsize pipebuf::xsputn(const char* s,streamsize n)
+{
+    char* base = pbase(), *e = pptr();
+    if (n <= epptr() - e) {
+        memcpy(e,s,n);
+        pbump(int(n));
+        return n;
+    }
+    // write the buffered data followed by 's' directly from the caller's memory
+    iovec iov[2];
+    iov[0].iov_base = base; iov[0].iov_len = e - base;
+    iov[1].iov_base = const_cast<char*>(s); iov[1].iov_len = n;
+    write_all(iov,2);
+    setp(_buffer,_buffer+BUFSIZE);
+    return n;
+}
+void pipebuf::write_all(iovec* iov,int cnt)
+{
+    // 'writev' may return early if interrupted; continue where it stopped
+    while (cnt > 0) {
+        ssize_t r = writev(_pfd[1],iov,cnt);
+        if (r == -1) {
+            if (errno == EINTR)
+                continue;
+            throw ramsey_exception("fail write()");
+        }
+        while (cnt > 0 && size_t(r) >= iov->iov_len) {
+            r -= iov->iov_len;
+            ++iov; --cnt;
+        }
+        if (cnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + r;
+            iov->iov_len -= r;
+        }
+    }
+}
 
 // gccbuilder
-gccbuilder::gccbuilder(int argc,const char* argv[])
-    : _buf(new pipebuf), _stream(_buf)
+gccbuilder::gccbuilder(int argc,const char* argv[],bool object)
+    : _buf(NULL), _stream(NULL)
 {
     // read arguments; find exactly one .c file and 1 .ram file
     _cfile = NULL; _ramfile = NULL;
@@ -123,14 +177,42 @@ gccbuilder::gccbuilder(int argc,const char* argv[])
         throw gccbuilder_error("no .c file provided");
     if (_ramfile == NULL)
         throw gccbuilder_error("no .ram file provided");
-    _flags = 0;
+    if (object) {
+#ifdef RAMSEY_APPLE
+        throw gccbuilder_error("cannot link ELF objects on this system; use the assembler");
+#else
+        // the object is written to a temporary file, which gcc is given to link
+        const char* dir = getenv("TMPDIR");
+        _objfile = string(dir!=NULL && *dir!='\0' ? dir : "/tmp") + "/ramseyXXXXXX";
+        int fd = mkstemp(&_objfile[0]);
+        if (fd == -1)
+            throw gccbuilder_error("cannot create temporary file '%s'",_objfile.c_str());
+        close(fd);
+        filebuf* file = new filebuf;
+        if (file->open(_objfile.c_str(),ios_base::out | ios_base::binary) == NULL) {
+            delete file;
+            unlink(_objfile.c_str());
+            throw gccbuilder_error("cannot open temporary file '%s'",_objfile.c_str());
+        }
+        _buf = file;
+        _flags = gccbuilder_object;
+#endif
+    }
+    else {
+        _buf = new pipebuf;
+        _flags = gccbuilder_asm;
+    }
+    _stream.rdbuf(_buf);
     _pi = new pid_t(-1);
 }
 gccbuilder::~gccbuilder()
 {
-    // flush any remaining data in the stream buffer and close the pipe
+    // flush any remaining data in the stream buffer and close the pipe (or the object file)
     _buf->pubsync();
-    static_cast<pipebuf*>(_buf)->close_write_fd();
+    if (_flags == gccbuilder_object)
+        static_cast<filebuf*>(_buf)->close();
+    else
+        static_cast<pipebuf*>(_buf)->close_write_fd();
     delete _buf;
     // wait on the child process
     pid_t pidChild;
@@ -144,6 +226,8 @@ gccbuilder::~gccbuilder()
         else
             kill(pid,SIGKILL);
     }
+    if ( !_objfile.empty() )
+        unlink(_objfile.c_str());
 }
 void gccbuilder::execute()
 {
@@ -151,7 +235,9 @@ void gccbuilder::execute()
     // and compile the .c driver program; eventually,
     // it will invoke the linker and build an executable
     pid_t gcc;
-    pipebuf* pip = static_cast<pipebuf*>(_buf);
+    pipebuf* pip = _flags==gccbuilder_object ? NULL : static_cast<pipebuf*>(_buf);
+    if (pip==NULL && static_cast<filebuf*>(_buf)->close()==NULL)
+        throw gccbuilder_error("cannot write temporary file '%s'",_objfile.c_str());
     gcc = fork();
     if (gcc == -1)
         throw ramsey_exception("fail fork()");
@@ -177,16 +263,34 @@ void gccbuilder::execute()
             "-xc", _cfile, // compile .c file (this is the driver program)
             NULL
         };
-        // redirect stdin to read from pipebuf; assembler code will be written to this pipe
-        if (dup2(pip->get_read_fd(),STDIN_FILENO) != STDIN_FILENO)
-            throw ramsey_exception("fail dup2()");
-        pip->close_read_fd(); pip->close_write_fd();
+        if (pip == NULL) {
+            // link the object file instead (its name does not give its type)
+            args[5] = "-xnone";
+            args[6] = _objfile.c_str();
+        }
+        else {
+            // redirect stdin to read from pipebuf; assembler code will be written to this pipe
+            if (dup2(pip->get_read_fd(),STDIN_FILENO) != STDIN_FILENO)
+                throw ramsey_exception("fail dup2()");
+            pip->close_read_fd(); pip->close_write_fd();
+        }
         // execute the child process
         if (execvp("gcc",(char*const*)args) == -1)
             throw gccbuilder_error("cannot execute 'gcc'; is the software installed in the system PATH?");
         // control not in this program
     }
     // close pipe read end and save the pid for the child process
-    pip->close_read_fd();
+    if (pip != NULL)
+        pip->close_read_fd();
     *reinterpret_cast<pid_t*>(_pi) = gcc;
 }
+void gccbuilder::abort()
+{
+    // kill the process while it still waits for the end of its input, so it
+    // cannot assemble or link what it has read
+    pid_t pid = *reinterpret_cast<pid_t*>(_pi);
+    if (pid != -1)
+        kill(pid,SIGKILL);
+    if (_flags != gccbuilder_object)
+        static_cast<pipebuf*>(_buf)->discard();
+}
@@ -15,6 +15,8 @@ gccbuilder_error::gccbuilder_error(const char* format, ...)
     va_end(args);
 }
 
+// pipebuf: small writes are gathered in a large buffer; a write that does not
+// fit is passed to the pipe directly after the buffered data
 class pipebuf : public streambuf
 {
 public:
@@ -26,11 +28,15 @@ public:
                 
     void close_write();
     void close_read();
+    void discard() // drop the data in the buffer
+    { setp(_buffer,_buffer+BUFSIZE); }
 private:
-    static const ptrdiff_t BUFSIZE = 4096;
+    static const ptrdiff_t BUFSIZE = 65536;
+    static const DWORD PIPESIZE = 1048576; // suggested pipe capacity
         
     virtual int_type overflow(int_type);
     virtual int_type sync();
+    virtual streamsize xsputn(const char*,streamsize);
                 
     // disallow copying
     pipebuf(const pipebuf&);
@@ -42,7 +48,7 @@ private:
 
 pipebuf::pipebuf()
 {
-    if(!CreatePipe(&io[0], &io[1], NULL, 0))
+    if(!CreatePipe(&io[0], &io[1], NULL, PIPESIZE))
         throw ramsey_exception("CreatePipe() failure");
     // set only the read end as inheritable
     if (!SetHandleInformation(io[0],HANDLE_FLAG_INHERIT,HANDLE_FLAG_INHERIT))
@@ -98,14 +104,28 @@ int pipebuf::sync()
     }
     return 0;
 }
+streamsize pipebuf::xsputn(const char* s,streamsize n)
+{
+    if (n <= epptr() - pptr()) {
+        memcpy(pptr(),s,n);
+        pbump(int(n));
+        return n;
+    }
+    // flush the buffered data, then write 's' from the caller's memory
+    sync();
+    DWORD doofus;
+    if (!WriteFile(io[1], s, DWORD(n), &doofus, NULL))
+        throw ramsey_exception("WriteFile() failure");
+    return n;
+}
 
 struct proc{
     PROCESS_INFORMATION procinf;
     STARTUPINFO startinf;
 };
 
-gccbuilder::gccbuilder(int argc,const char* argv[])
-    : _buf(new pipebuf), _stream(_buf)
+gccbuilder::gccbuilder(int argc,const char* argv[],bool object)
+    : _buf(NULL), _stream(NULL)
 {
     // read arguments; find exactly one .c file and 1 .ram file
     _cfile = NULL; _ramfile = NULL;
@@ -132,7 +152,11 @@ gccbuilder::gccbuilder(int argc,const char* argv[])
         throw gccbuilder_error("no .c file provided");
     if (_ramfile == NULL)
         throw gccbuilder_error("no .ram file provided");
-    _flags = 0;
+    if (object) // MinGW links COFF objects
+        throw gccbuilder_error("cannot link ELF objects on this system; use the assembler");
+    _buf = new pipebuf;
+    _stream.rdbuf(_buf);
+    _flags = gccbuilder_asm;
     //_pi = new pid_t(-1);
     proc* p = new proc;
     ZeroMemory(&p->procinf, sizeof(p->procinf));
@@ -179,3 +203,12 @@ void gccbuilder::execute()
         throw gccbuilder_error("CreateProcess() failure; is GCC installed?");
     static_cast<pipebuf*>(_buf)->close_read();
 }
+void gccbuilder::abort()
+{
+    // terminate the process while it still waits for the end of its input,
+    // so it cannot assemble or link what it has read
+    proc* p = reinterpret_cast<proc*>(_pi);
+    if (p->procinf.hProcess != NULL)
+        TerminateProcess(p->procinf.hProcess,1);
+    static_cast<pipebuf*>(_buf)->discard();
+}
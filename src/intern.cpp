@@ -0,0 +1,67 @@
+/* intern.cpp */
+#include "intern.h"
+#include <cstring>
+using namespace std;
+using namespace ramsey;
+
+static unsigned hash_spelling(const char* s,int length)
+{
+    // FNV-1a: identifiers are short, so a byte-at-a-time hash is fine
+    unsigned h = 2166136261u;
+    for (int i = 0;i < length;++i)
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+identifier_table::identifier_table()
+    : _slots(64)
+{
+}
+int identifier_table::intern(const char* s,int length)
+{
+    unsigned h = hash_spelling(s,length), mask = unsigned(_slots.size()) - 1;
+    for (unsigned i = h & mask;;i = (i+1) & mask) {
+        int slot = _slots[i];
+        if (slot == 0)
+            break;
+        const name& n = _names[slot-1];
+        if (n.hash==h && n.length==length && memcmp(n.s,s,length)==0)
+            return slot-1;
+    }
+    // add new spelling; keep the load factor at or below one half
+    name n = { s, length, h };
+    _names.push_back(n);
+    if (_names.size()*2 > _slots.size())
+        _grow();
+    else {
+        unsigned i = h & mask;
+        while (_slots[i] != 0)
+            i = (i+1) & mask;
+        _slots[i] = int(_names.size());
+    }
+    return int(_names.size()) - 1;
+}
+int identifier_table::find(const char* s,int length) const
+{
+    unsigned h = hash_spelling(s,length), mask = unsigned(_slots.size()) - 1;
+    for (unsigned i = h & mask;;i = (i+1) & mask) {
+        int slot = _slots[i];
+        if (slot == 0)
+            return -1;
+        const name& n = _names[slot-1];
+        if (n.hash==h && n.length==length && memcmp(n.s,s,length)==0)
+            return slot-1;
+    }
+}
+void identifier_table::_grow()
+{
+    // rebuild the index at twice the size (this also indexes the newest name)
+    _slots.assign(_slots.size()*2,0);
+    unsigned mask = unsigned(_slots.size()) - 1;
+    for (size_t id = 0;id < _names.size();++id) {
+        unsigned i = _names[id].hash & mask;
+        while (_slots[i] != 0)
+            i = (i+1) & mask;
+        _slots[i] = int(id) + 1;
+    }
+}
@@ -0,0 +1,40 @@
+/* intern.h - CS355 Compiler Project */
+#ifndef INTERN_H
+#define INTERN_H
+#include <vector>
+
+namespace ramsey
+{
+    // maps identifier spellings to dense integer IDs (0, 1, 2, ... in order
+    // of first appearance); the lexer interns every identifier so later stages
+    // compare and look up names by ID; spellings are views into the source
+    // buffer, which must outlive the table
+    class identifier_table
+    {
+    public:
+        identifier_table();
+
+        int intern(const char* s,int length); // get the ID for a spelling, assigning the next ID if it is new
+        int find(const char* s,int length) const; // get the ID for a spelling, or -1 if it was never interned
+        int size() const
+        { return int(_names.size()); }
+        const char* spelling(int id) const // NOT null-terminated
+        { return _names[id].s; }
+        int length(int id) const
+        { return _names[id].length; }
+    private:
+        struct name
+        {
+            const char* s;
+            int length;
+            unsigned hash;
+        };
+
+        std::vector<name> _names; // indexed by ID
+        std::vector<int> _slots; // open-addressed hash index: ID+1, or 0 if empty (size is a power of two)
+
+        void _grow();
+    };
+}
+
+#endif
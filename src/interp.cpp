@@ -0,0 +1,236 @@
+/* interp.cpp - bytecode interpreter */
+#include "bytecode.h"
+using namespace std;
+using namespace ramsey;
+
+#ifdef __GNUC__
+#define RAMSEY_THREADED_CODE // dispatch through the addresses of labels (a GNU extension)
+#endif
+
+namespace
+{
+    const int STACK_REGISTERS = 1 << 22; // for the frames of the calls in progress (16 MB)
+    const int STACK_FRAMES = 1 << 20; // calls in progress
+}
+
+// bytecode_interpreter
+bytecode_interpreter::bytecode_interpreter(const bytecode_module& module)
+    : _module(module), _handlers(NULL), _registers(NULL), _frames(NULL)
+{
+    // thread the code: each word of the module becomes a slot, with the address of the
+    // code of each opcode and a pointer for each jump target and function
+    const vector<int>& code = module.code();
+    _code.resize(code.size());
+    _callees.resize(module.function_count());
+    for (int i = 0;i < module.function_count();++i) {
+        const bytecode_module::function& f = module.get_function(i);
+        _callees[i].entry = &_code[0] + f.entry;
+        _callees[i].registers = f.registers;
+        _callees[i].params = int(f.params.size());
+    }
+    run(NULL,NULL);
+    for (size_t p = 0;p < code.size();) {
+        bytecode_opcode op = bytecode_opcode(code[p]);
+#ifdef RAMSEY_THREADED_CODE
+        _code[p++].handler = _handlers[op];
+#else
+        _code[p++].operand = op;
+#endif
+        for (const char* k = bytecode_module::operands(op);*k != '\0';++k,++p) {
+            if (*k == 't')
+                _code[p].target = &_code[0] + code[p];
+            else if (*k == 'f')
+                _code[p].function = &_callees[code[p]];
+            else
+                _code[p].operand = code[p];
+        }
+    }
+    // (the pages of the stacks are not touched until they are used)
+    _registers = new int[STACK_REGISTERS];
+    _frames = new frame[STACK_FRAMES];
+}
+bytecode_interpreter::~bytecode_interpreter()
+{
+    delete[] _registers;
+    delete[] _frames;
+}
+int bytecode_interpreter::call(const char* name,const vector<int>& args)
+{
+    int i = _module.find_function(name);
+    if (i < 0)
+        throw bytecode_error("function '%s' is not in the program",name);
+    const callee& f = _callees[i];
+    if (int(args.size()) < f.params)
+        throw bytecode_error("too few arguments to function '%s'",name);
+    if (int(args.size()) > f.params)
+        throw bytecode_error("too many arguments to function '%s'",name);
+    if (f.registers > STACK_REGISTERS)
+        throw bytecode_error("stack overflow");
+    for (int r = 0;r < f.registers;++r)
+        _registers[r] = r < f.params ? args[r] : 0;
+    return run(&f,_registers);
+}
+int bytecode_interpreter::run(const callee* func,int* regs)
+{
+    // 'pc' is the next instruction and 'r' the frame of the function that runs; a call
+    // saves them in the next frame record, and the callee's frame begins at the caller's
+    // arguments; a variable is zero until it is assigned
+#ifdef RAMSEY_THREADED_CODE
+    static const void* const HANDLERS[] = { // (in the order of bytecode_opcode)
+        __extension__ &&op_ldi, __extension__ &&op_mov, __extension__ &&op_sx16, __extension__ &&op_sx8,
+        __extension__ &&op_neg, __extension__ &&op_not,
+        __extension__ &&op_add, __extension__ &&op_sub, __extension__ &&op_mul, __extension__ &&op_div,
+        __extension__ &&op_mod, __extension__ &&op_addi,
+        __extension__ &&op_eq, __extension__ &&op_ne, __extension__ &&op_lt, __extension__ &&op_gt,
+        __extension__ &&op_le, __extension__ &&op_ge,
+        __extension__ &&op_jmp, __extension__ &&op_jz, __extension__ &&op_jnz,
+        __extension__ &&op_jeq, __extension__ &&op_jne, __extension__ &&op_jlt, __extension__ &&op_jgt,
+        __extension__ &&op_jle, __extension__ &&op_jge,
+        __extension__ &&op_jeqi, __extension__ &&op_jnei, __extension__ &&op_jlti, __extension__ &&op_jgti,
+        __extension__ &&op_jlei, __extension__ &&op_jgei,
+        __extension__ &&op_call, __extension__ &&op_ret
+    };
+#define INSTRUCTION(name) op_##name:
+#define DISPATCH() __extension__ ({ goto *pc->handler; })
+    if (func == NULL) {
+        _handlers = HANDLERS;
+        return 0;
+    }
+#else
+#define INSTRUCTION(name) case bc_##name:
+#define DISPATCH() continue
+    if (func == NULL)
+        return 0;
+#endif
+#define D r[pc[1].operand] // the register written
+#define A r[pc[2].operand]
+#define B r[pc[3].operand]
+#define NEXT(n) pc += n; DISPATCH()
+#define BINARY(name,expr) INSTRUCTION(name) { int a = A, b = B; D = (expr); } NEXT(4);
+#define JUMP(name,cond) INSTRUCTION(name) pc = (cond) ? pc[3].target : pc+4; DISPATCH();
+    const slot* pc = func->entry;
+    int* r = regs;
+    frame* fp = _frames;
+    int* const rend = _registers + STACK_REGISTERS;
+    frame* const fend = _frames + STACK_FRAMES;
+
+#ifdef RAMSEY_THREADED_CODE
+    DISPATCH();
+#else
+    for (;;) switch (pc->operand) {
+#endif
+    INSTRUCTION(ldi)
+        D = pc[2].operand;
+        NEXT(3);
+    INSTRUCTION(mov)
+        D = A;
+        NEXT(3);
+    INSTRUCTION(sx16)
+        D = short(A);
+        NEXT(3);
+    INSTRUCTION(sx8)
+        D = (signed char)A;
+        NEXT(3);
+    INSTRUCTION(neg)
+        D = int(0u - unsigned(A));
+        NEXT(3);
+    INSTRUCTION(not)
+        D = A == 0;
+        NEXT(3);
+    // the arithmetic wraps as the processor's does; dividing the least integer by -1 (which
+    // overflows) gives the least integer and a remainder of zero
+    BINARY(add, int(unsigned(a) + unsigned(b)))
+    BINARY(sub, int(unsigned(a) - unsigned(b)))
+    BINARY(mul, int(unsigned(a) * unsigned(b)))
+    INSTRUCTION(div)
+        {
+            int a = A, b = B;
+            if (b == 0)
+                goto division_by_zero;
+            D = b == -1 ? int(0u - unsigned(a)) : a / b;
+        }
+        NEXT(4);
+    INSTRUCTION(mod)
+        {
+            int a = A, b = B;
+            if (b == 0)
+                goto division_by_zero;
+            D = b == -1 ? 0 : a % b;
+        }
+        NEXT(4);
+    INSTRUCTION(addi)
+        D = int(unsigned(A) + unsigned(pc[3].operand));
+        NEXT(4);
+    BINARY(eq, a == b)
+    BINARY(ne, a != b)
+    BINARY(lt, a < b)
+    BINARY(gt, a > b)
+    BINARY(le, a <= b)
+    BINARY(ge, a >= b)
+    INSTRUCTION(jmp)
+        pc = pc[1].target;
+        DISPATCH();
+    INSTRUCTION(jz)
+        pc = r[pc[1].operand] == 0 ? pc[2].target : pc+3;
+        DISPATCH();
+    INSTRUCTION(jnz)
+        pc = r[pc[1].operand] != 0 ? pc[2].target : pc+3;
+        DISPATCH();
+    // (operands: a b t, or a i t)
+    JUMP(jeq, r[pc[1].operand] == A)
+    JUMP(jne, r[pc[1].operand] != A)
+    JUMP(jlt, r[pc[1].operand] < A)
+    JUMP(jgt, r[pc[1].operand] > A)
+    JUMP(jle, r[pc[1].operand] <= A)
+    JUMP(jge, r[pc[1].operand] >= A)
+    JUMP(jeqi, r[pc[1].operand] == pc[2].operand)
+    JUMP(jnei, r[pc[1].operand] != pc[2].operand)
+    JUMP(jlti, r[pc[1].operand] < pc[2].operand)
+    JUMP(jgti, r[pc[1].operand] > pc[2].operand)
+    JUMP(jlei, r[pc[1].operand] <= pc[2].operand)
+    JUMP(jgei, r[pc[1].operand] >= pc[2].operand)
+    INSTRUCTION(call)
+        {
+            const callee* f = pc[2].function;
+            int* base = r + pc[3].operand;
+            if (fp==fend || f->registers>rend-base)
+                goto stack_overflow;
+            fp->pc = pc + 4;
+            fp->regs = r;
+            fp->dst = pc[1].operand;
+            ++fp;
+            r = base;
+            for (int i = f->params;i < f->registers;++i)
+                r[i] = 0;
+            pc = f->entry;
+        }
+        DISPATCH();
+    INSTRUCTION(ret)
+        {
+            int value = r[pc[1].operand];
+            if (fp == _frames)
+                return value;
+            --fp;
+            r = fp->regs;
+            r[fp->dst] = value;
+            pc = fp->pc;
+        }
+        DISPATCH();
+#ifndef RAMSEY_THREADED_CODE
+    }
+#endif
+#undef INSTRUCTION
+#undef DISPATCH
+#undef D
+#undef A
+#undef B
+#undef NEXT
+#undef BINARY
+#undef JUMP
+
+division_by_zero:
+    throw bytecode_error("division by zero");
+stack_overflow:
+    throw bytecode_error("stack overflow (more than %d calls in progress, or their frames take more than %d registers)",
+        STACK_FRAMES,STACK_REGISTERS);
+}
@@ -0,0 +1,47 @@
+/* jit.h - run compiled code in the compiler's own process */
+#ifndef JIT_H
+#define JIT_H
+#include <vector>
+#include <cstddef>
+#include "ramsey-error.h"
+
+namespace ramsey
+{
+    class elf_object;
+
+    class jit_error : public compiler_error_generic // errors reported to user
+    {
+    public:
+        jit_error(const char* format, ...);
+        virtual ~jit_error() throw() {}
+    };
+
+    /* jit_program: links the functions encoded in an object into executable
+       memory so that they can be called without building a program; the code
+       is IA-32, so on an x86-64 host a call switches the processor into 32-bit
+       (compatibility) mode and back, and the code runs on a stack of its own:
+       the code, that stack and the arguments are all placed below 4 GB, where
+       32-bit code can address them */
+    class jit_program
+    {
+    public:
+        jit_program(const elf_object& object); // 'object' must outlive this; throws jit_error
+        ~jit_program();
+
+        // call function 'name' with the arguments passed as the generated code
+        // passes them (each in a 32-bit slot); returns the contents of EAX
+        int call(const char* name,const std::vector<int>& args) const;
+    private:
+        const elf_object& _object;
+        unsigned char* _code; // call thunk, then the linked functions
+        std::size_t _codesize;
+        unsigned char* _data; // guard page and stack (x86-64), then the call block
+        std::size_t _datasize;
+
+        // disallow copying
+        jit_program(const jit_program&);
+        jit_program& operator =(const jit_program&);
+    };
+}
+
+#endif
@@ -0,0 +1,219 @@
+/* jit_posix.cpp */
+#include "jit.h"
+#include "elfobj.h"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+using namespace std;
+using namespace ramsey;
+
+// jit_error
+jit_error::jit_error(const char* format, ...)
+{
+    va_list args;
+    va_start(args,format);
+    _cstor(format,args);
+    va_end(args);
+}
+
+#if defined(__x86_64__) && defined(__linux__)
+#define RAMSEY_JIT_COMPAT // 64-bit host: the thunk switches to compatibility mode
+#elif defined(__i386__)
+#define RAMSEY_JIT_NATIVE // 32-bit host: the thunk is an ordinary function
+#endif
+
+#if defined(RAMSEY_JIT_COMPAT) || defined(RAMSEY_JIT_NATIVE)
+namespace
+{
+    /* the call block holds what the thunk needs to make a call; it is the last
+       page of the data mapping, and the stack of the 32-bit code lies below it
+       (above a guard page): the offsets of its fields in bytes are */
+    enum block_field
+    {
+        block_entry = 0, // address of the function called
+        block_argc = 4,
+        block_stack = 8, // top of the 32-bit stack
+        block_rsp = 16, // stack pointer of the caller (64 bits)
+        block_back = 24, // far pointer back to 64-bit code: offset, then selector at 28
+        block_thunk32 = 32, // address of the 32-bit thunk (64 bits, for a far return)
+        block_ds = 40, // data segment selectors of the caller
+        block_es = 42,
+        block_args = 64 // each in a 32-bit slot
+    };
+    const size_t BLOCK_SIZE = 4096;
+    const size_t MAX_ARGS = (BLOCK_SIZE-block_args) / 4;
+    const size_t THUNK_SIZE = 128; // the functions are linked after the thunk
+
+#ifdef RAMSEY_JIT_COMPAT
+    const size_t STACK_SIZE = 8 << 20;
+
+    // enter64 (at 0): called with the block in RDI; saves the registers that the
+    // caller needs, then does a far return to 'thunk32' in the 32-bit code segment
+    const unsigned char ENTER64[] = {
+        0x53, 0x55, 0x41,0x54, 0x41,0x55, 0x41,0x56, 0x41,0x57, // push rbx, rbp, r12-r15
+        0x48,0x89,0x67,block_rsp,                              // mov [rdi+rsp], rsp
+        0x8c,0x4f,block_back+4,                                // mov [rdi+back+4], cs
+        0x8c,0x5f,block_ds,                                    // mov [rdi+ds], ds
+        0x8c,0x47,block_es,                                    // mov [rdi+es], es
+        0x8b,0x67,block_stack,                                 // mov esp, [rdi+stack]
+        0x6a,0x23,                                             // push 0x23 (Linux's 32-bit user code segment)
+        0xff,0x77,block_thunk32,                               // push qword [rdi+thunk32]
+        0x48,0xcb                                              // retfq
+    };
+    // thunk32 (at 48): makes the call in 32-bit code (the low half of RDI still
+    // holds the block); DS and ES may be null, so they are loaded with SS
+    const size_t THUNK32 = 48;
+    const size_t THUNK32_BLOCK = 23; // the block address in 'mov edi'
+    const unsigned char THUNK32_CODE[] = {
+        0x8c,0xd0,                     // mov eax, ss
+        0x8e,0xd8,                     // mov ds, eax
+        0x8e,0xc0,                     // mov es, eax
+        0x8b,0x4f,block_argc,          // mov ecx, [edi+argc]
+        0x85,0xc9,                     // 1: test ecx, ecx
+        0x74,0x07,                     // jz 2f
+        0xff,0x74,0x8f,block_args-4,   // push [edi+ecx*4+args-4]
+        0x49,                          // dec ecx
+        0xeb,0xf5,                     // jmp 1b
+        0xff,0x17,                     // 2: call [edi+entry]
+        0xbf,0,0,0,0,                  // mov edi, block (the callee need not preserve EDI)
+        0xff,0x6f,block_back           // jmp far [edi+back]
+    };
+    // back64 (at 96): restores the caller's state and returns to it (with the result in EAX)
+    const size_t BACK64 = 96;
+    const unsigned char BACK64_CODE[] = {
+        0x89,0xff,                                        // mov edi, edi
+        0x8e,0x5f,block_ds,                               // mov ds, [rdi+ds]
+        0x8e,0x47,block_es,                               // mov es, [rdi+es]
+        0x48,0x8b,0x67,block_rsp,                         // mov rsp, [rdi+rsp]
+        0x41,0x5f, 0x41,0x5e, 0x41,0x5d, 0x41,0x5c, 0x5d, 0x5b, // pop r15-r12, rbp, rbx
+        0xc3                                              // ret
+    };
+#else
+    const size_t STACK_SIZE = 0; // the code runs on the caller's stack
+
+    // enter32 (at 0): a cdecl function given the block; the callee need not
+    // preserve EBX, ESI or EDI, so they are saved here
+    const unsigned char ENTER32[] = {
+        0x55,                          // push ebp
+        0x89,0xe5,                     // mov ebp, esp
+        0x53, 0x56, 0x57,              // push ebx, esi, edi
+        0x8b,0x7d,0x08,                // mov edi, [ebp+8]
+        0x8b,0x4f,block_argc,          // mov ecx, [edi+argc]
+        0x85,0xc9,                     // 1: test ecx, ecx
+        0x74,0x07,                     // jz 2f
+        0xff,0x74,0x8f,block_args-4,   // push [edi+ecx*4+args-4]
+        0x49,                          // dec ecx
+        0xeb,0xf5,                     // jmp 1b
+        0xff,0x17,                     // 2: call [edi+entry]
+        0x8d,0x65,0xf4,                // lea esp, [ebp-12]
+        0x5f, 0x5e, 0x5b,              // pop edi, esi, ebx
+        0x5d,                          // pop ebp
+        0xc3                           // ret
+    };
+#endif
+
+    void put32(unsigned char* p,unsigned value)
+    {
+        memcpy(p,&value,4); // x86 is little-endian, as the code is
+    }
+    unsigned address32(const void* p)
+    {
+        return unsigned(reinterpret_cast<size_t>(p));
+    }
+
+    unsigned char* map_low(size_t size)
+    {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef RAMSEY_JIT_COMPAT
+        flags |= MAP_32BIT; // (the low 2 GB)
+#endif
+        void* p = mmap(NULL,size,PROT_READ|PROT_WRITE,flags,-1,0);
+        if (p == MAP_FAILED)
+            throw jit_error("cannot map memory for the code: %s",strerror(errno));
+        return static_cast<unsigned char*>(p);
+    }
+}
+
+// jit_program
+jit_program::jit_program(const elf_object& object)
+    : _object(object), _code(NULL), _codesize(0), _data(NULL), _datasize(0)
+{
+    size_t page = size_t(sysconf(_SC_PAGESIZE));
+    _codesize = (THUNK_SIZE + object.code_size() + page-1) / page * page;
+    _datasize = (STACK_SIZE == 0 ? 0 : page+STACK_SIZE) + BLOCK_SIZE;
+    _code = map_low(_codesize);
+    try {
+        _data = map_low(_datasize);
+        object.link(reinterpret_cast<char*>(_code+THUNK_SIZE));
+    } catch (...) {
+        munmap(_code,_codesize);
+        if (_data != NULL)
+            munmap(_data,_datasize);
+        throw;
+    }
+    memset(_code,0xcc,THUNK_SIZE); // (int3 between the pieces)
+    unsigned char* block = _data + _datasize - BLOCK_SIZE;
+#ifdef RAMSEY_JIT_COMPAT
+    memcpy(_code,ENTER64,sizeof(ENTER64));
+    memcpy(_code+THUNK32,THUNK32_CODE,sizeof(THUNK32_CODE));
+    put32(_code+THUNK32+THUNK32_BLOCK,address32(block));
+    memcpy(_code+BACK64,BACK64_CODE,sizeof(BACK64_CODE));
+    put32(block+block_stack,address32(block));
+    put32(block+block_back,address32(_code+BACK64));
+    put32(block+block_thunk32,address32(_code+THUNK32));
+    put32(block+block_thunk32+4,0);
+    if (mprotect(_data,page,PROT_NONE) == -1) { // an overflow of the stack faults instead of reaching other memory
+        int err = errno;
+        munmap(_code,_codesize);
+        munmap(_data,_datasize);
+        throw jit_error("cannot protect the end of the stack: %s",strerror(err));
+    }
+#else
+    memcpy(_code,ENTER32,sizeof(ENTER32));
+#endif
+    if (mprotect(_code,_codesize,PROT_READ|PROT_EXEC) == -1) {
+        int err = errno;
+        munmap(_code,_codesize);
+        munmap(_data,_datasize);
+        throw jit_error("cannot make the code executable: %s",strerror(err));
+    }
+}
+jit_program::~jit_program()
+{
+    munmap(_code,_codesize);
+    munmap(_data,_datasize);
+}
+int jit_program::call(const char* name,const vector<int>& args) const
+{
+    int offset = _object.function_offset(name);
+    if (offset < 0)
+        throw jit_error("function '%s' is not in the program",name);
+    if (args.size() > MAX_ARGS)
+        throw jit_error("too many arguments to function '%s'",name);
+    unsigned char* block = _data + _datasize - BLOCK_SIZE;
+    put32(block+block_entry,address32(_code+THUNK_SIZE+offset));
+    put32(block+block_argc,unsigned(args.size()));
+    for (size_t i = 0;i < args.size();++i)
+        put32(block+block_args+i*4,unsigned(args[i]));
+
+    // the thunk is called as 'int thunk(void* block)' in the host's convention
+    int (*thunk)(void*);
+    memcpy(&thunk,&_code,sizeof(thunk));
+    return thunk(block);
+}
+#else
+// the code can only run on an x86 processor
+jit_program::jit_program(const elf_object& object)
+    : _object(object), _code(NULL), _codesize(0), _data(NULL), _datasize(0)
+{
+    throw jit_error("cannot run code in process on this system (an x86 system is required)");
+}
+jit_program::~jit_program()
+{
+}
+int jit_program::call(const char*,const vector<int>&) const
+{
+    return 0;
+}
+#endif
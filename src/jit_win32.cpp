@@ -0,0 +1,123 @@
+/* jit_win32.cpp */
+#include "jit.h"
+#include "elfobj.h"
+#include <cstring>
+#include <windows.h>
+using namespace std;
+using namespace ramsey;
+
+// jit_error
+jit_error::jit_error(const char* format, ...)
+{
+    va_list args;
+    va_start(args,format);
+    _cstor(format,args);
+    va_end(args);
+}
+
+#ifndef _WIN64
+namespace
+{
+    // the call block: the address of the function, the number of arguments,
+    // then the arguments (each in a 32-bit slot)
+    enum block_field
+    {
+        block_entry = 0,
+        block_argc = 4,
+        block_args = 64
+    };
+    const size_t BLOCK_SIZE = 4096;
+    const size_t MAX_ARGS = (BLOCK_SIZE-block_args) / 4;
+    const size_t THUNK_SIZE = 128; // the functions are linked after the thunk
+
+    // enter32 (at 0): a cdecl function given the block; the callee need not
+    // preserve EBX, ESI or EDI, so they are saved here
+    const unsigned char ENTER32[] = {
+        0x55,                          // push ebp
+        0x89,0xe5,                     // mov ebp, esp
+        0x53, 0x56, 0x57,              // push ebx, esi, edi
+        0x8b,0x7d,0x08,                // mov edi, [ebp+8]
+        0x8b,0x4f,block_argc,          // mov ecx, [edi+argc]
+        0x85,0xc9,                     // 1: test ecx, ecx
+        0x74,0x07,                     // jz 2f
+        0xff,0x74,0x8f,block_args-4,   // push [edi+ecx*4+args-4]
+        0x49,                          // dec ecx
+        0xeb,0xf5,                     // jmp 1b
+        0xff,0x17,                     // 2: call [edi+entry]
+        0x8d,0x65,0xf4,                // lea esp, [ebp-12]
+        0x5f, 0x5e, 0x5b,              // pop edi, esi, ebx
+        0x5d,                          // pop ebp
+        0xc3                           // ret
+    };
+
+    void put32(unsigned char* p,unsigned value)
+    {
+        memcpy(p,&value,4);
+    }
+}
+
+// jit_program
+jit_program::jit_program(const elf_object& object)
+    : _object(object), _code(NULL), _codesize(0), _data(NULL), _datasize(0)
+{
+    _codesize = THUNK_SIZE + object.code_size();
+    _datasize = BLOCK_SIZE;
+    _code = static_cast<unsigned char*>(VirtualAlloc(NULL,_codesize,MEM_COMMIT|MEM_RESERVE,PAGE_READWRITE));
+    if (_code == NULL)
+        throw jit_error("cannot allocate memory for the code: error code %d",(int)GetLastError());
+    try {
+        object.link(reinterpret_cast<char*>(_code+THUNK_SIZE));
+    } catch (...) {
+        VirtualFree(_code,0,MEM_RELEASE);
+        throw;
+    }
+    memset(_code,0xcc,THUNK_SIZE);
+    memcpy(_code,ENTER32,sizeof(ENTER32));
+
+    _data = static_cast<unsigned char*>(VirtualAlloc(NULL,_datasize,MEM_COMMIT|MEM_RESERVE,PAGE_READWRITE));
+    DWORD old;
+    if (_data==NULL || !VirtualProtect(_code,_codesize,PAGE_EXECUTE_READ,&old)) {
+        int err = (int)GetLastError();
+        VirtualFree(_code,0,MEM_RELEASE);
+        if (_data != NULL)
+            VirtualFree(_data,0,MEM_RELEASE);
+        throw jit_error("cannot make the code executable: error code %d",err);
+    }
+    FlushInstructionCache(GetCurrentProcess(),_code,_codesize);
+}
+jit_program::~jit_program()
+{
+    VirtualFree(_code,0,MEM_RELEASE);
+    VirtualFree(_data,0,MEM_RELEASE);
+}
+int jit_program::call(const char* name,const vector<int>& args) const
+{
+    int offset = _object.function_offset(name);
+    if (offset < 0)
+        throw jit_error("function '%s' is not in the program",name);
+    if (args.size() > MAX_ARGS)
+        throw jit_error("too many arguments to function '%s'",name);
+    put32(_data+block_entry,unsigned(reinterpret_cast<size_t>(_code+THUNK_SIZE+offset)));
+    put32(_data+block_argc,unsigned(args.size()));
+    for (size_t i = 0;i < args.size();++i)
+        put32(_data+block_args+i*4,unsigned(args[i]));
+
+    int (*thunk)(void*);
+    memcpy(&thunk,&_code,sizeof(thunk));
+    return thunk(_data);
+}
+#else
+// the code is IA-32, and a 64-bit Windows process cannot run it
+jit_program::jit_program(const elf_object& object)
+    : _object(object), _code(NULL), _codesize(0), _data(NULL), _datasize(0)
+{
+    throw jit_error("cannot run code in process on this system (a 32-bit build of the compiler is required)");
+}
+jit_program::~jit_program()
+{
+}
+int jit_program::call(const char*,const vector<int>&) const
+{
+    return 0;
+}
+#endif
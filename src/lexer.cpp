@@ -1,5 +1,7 @@
 /* lexer.cpp */
 #include "lexer.h"
+#include "lexsimd.h"
+#include "threadpool.h"
 #include <cstdio>
 #include <cstdarg>
 #include <cerrno>
@@ -24,52 +26,291 @@ lexer_exception::lexer_exception(const char* format, ...)
     va_end(args);
 }
 
+// scanner tables: the lexer is a maximal-munch DFA over character classes;
+// both the character class table and the state transition table are
+// generated at compile time from the constexpr functions below
+namespace
+{
+    enum char_class
+    {
+        cc_other, // not valid in program text (outside of comments and strings)
+        cc_space, // whitespace other than '\n'
+        cc_eol, // '\n'
+        cc_hash, // '#'
+        cc_quote, // '"'
+        cc_zero, // '0'
+        cc_digit, // '1'-'9'
+        cc_hexletter, // 'a'-'f', 'A'-'F'
+        cc_x, // 'x', 'X'
+        cc_letter, // any other letter or '_'
+        cc_plus, cc_minus, cc_star, cc_slash,
+        cc_lt, cc_gt, cc_equal, cc_bang,
+        cc_oparen, cc_cparen, cc_comma,
+        cc_count
+    };
+
+    enum scan_state
+    {
+        s_stop, // no transition: the token ends before the current character
+        s_start,
+        s_space, s_comment, s_eol, s_string,
+        s_ident, s_zero, s_number, s_hex,
+        s_add, s_subtract, s_multiply, s_divide,
+        s_less, s_le, s_assign, s_greater, s_ge, s_equal, s_bang, s_nequal,
+        s_oparen, s_cparen, s_comma,
+        s_count
+    };
+
+    // special accept actions (all other accept values are token kinds)
+    const int accept_error = -1, accept_skip = -2, accept_string = -3;
+
+    constexpr int char_class_of(int ch)
+    {
+        return ch=='\n' ? cc_eol
+            : (ch==' ' || ch=='\t' || ch=='\r' || ch=='\v' || ch=='\f') ? cc_space
+            : ch=='#' ? cc_hash
+            : ch=='\"' ? cc_quote
+            : ch=='0' ? cc_zero
+            : (ch>='1' && ch<='9') ? cc_digit
+            : ((ch>='a' && ch<='f') || (ch>='A' && ch<='F')) ? cc_hexletter
+            : (ch=='x' || ch=='X') ? cc_x
+            : ((ch>='a' && ch<='z') || (ch>='A' && ch<='Z') || ch=='_') ? cc_letter
+            : ch=='+' ? cc_plus
+            : ch=='-' ? cc_minus
+            : ch=='*' ? cc_star
+            : ch=='/' ? cc_slash
+            : ch=='<' ? cc_lt
+            : ch=='>' ? cc_gt
+            : ch=='=' ? cc_equal
+            : ch=='!' ? cc_bang
+            : ch=='(' ? cc_oparen
+            : ch==')' ? cc_cparen
+            : ch==',' ? cc_comma
+            : cc_other;
+    }
+
+    constexpr bool is_word_class(int c)
+    { return c==cc_zero || c==cc_digit || c==cc_hexletter || c==cc_x || c==cc_letter; }
+    constexpr bool is_digit_class(int c)
+    { return c==cc_zero || c==cc_digit; }
+
+    constexpr int start_transition(int c)
+    {
+        return c==cc_space ? s_space
+            : c==cc_eol ? s_eol
+            : c==cc_hash ? s_comment
+            : c==cc_quote ? s_string
+            : c==cc_zero ? s_zero
+            : c==cc_digit ? s_number
+            : (c==cc_hexletter || c==cc_x || c==cc_letter) ? s_ident
+            : c==cc_plus ? s_add
+            : c==cc_minus ? s_subtract
+            : c==cc_star ? s_multiply
+            : c==cc_slash ? s_divide
+            : c==cc_lt ? s_less
+            : c==cc_gt ? s_greater
+            : c==cc_equal ? s_equal
+            : c==cc_bang ? s_bang
+            : c==cc_oparen ? s_oparen
+            : c==cc_cparen ? s_cparen
+            : c==cc_comma ? s_comma
+            : s_stop;
+    }
+
+    constexpr int transition(int s,int c)
+    {
+        return s==s_start ? start_transition(c)
+            : s==s_space ? (c==cc_space ? s_space : s_stop)
+            : s==s_comment ? (c!=cc_eol ? s_comment : s_stop) // the '\n' is left to end the line
+            : s==s_ident ? (is_word_class(c) ? s_ident : s_stop)
+            : s==s_zero ? (c==cc_x ? s_hex : is_digit_class(c) ? s_number : s_stop)
+            : s==s_number ? (is_digit_class(c) ? s_number : s_stop)
+            : s==s_hex ? ((is_digit_class(c) || c==cc_hexletter) ? s_hex : s_stop)
+            : s==s_less ? (c==cc_equal ? s_le : c==cc_minus ? s_assign : s_stop)
+            : s==s_greater ? (c==cc_equal ? s_ge : s_stop)
+            : s==s_bang ? (c==cc_equal ? s_nequal : s_stop)
+            : s_stop;
+    }
+
+    constexpr int accept_of(int s)
+    {
+        return (s==s_space || s==s_comment) ? accept_skip
+            : s==s_string ? accept_string
+            : s==s_eol ? token_eol
+            : s==s_ident ? token_id // may be reclassified as a keyword
+            : (s==s_zero || s==s_number) ? token_number
+            : s==s_hex ? token_number_hex
+            : s==s_add ? token_add
+            : s==s_subtract ? token_subtract
+            : s==s_multiply ? token_multiply
+            : s==s_divide ? token_divide
+            : s==s_less ? token_less
+            : s==s_le ? token_le
+            : s==s_assign ? token_assign
+            : s==s_greater ? token_greater
+            : s==s_ge ? token_ge
+            : s==s_equal ? token_equal
+            : s==s_nequal ? token_nequal
+            : s==s_oparen ? token_oparen
+            : s==s_cparen ? token_cparen
+            : s==s_comma ? token_comma
+            : accept_error;
+    }
+
+    // compile-time table generation: expand 'F(0)...F(N-1)' into a static array
+    template<int... I> struct index_list {};
+    template<int N,int... I> struct make_index_list : make_index_list<N-1,N-1,I...> {};
+    template<int... I> struct make_index_list<0,I...> { typedef index_list<I...> type; };
+
+    template<typename T,typename L> struct scan_table;
+    template<typename T,int... I> struct scan_table<T,index_list<I...> >
+    {
+        static const signed char value[sizeof...(I)];
+    };
+    template<typename T,int... I>
+    const signed char scan_table<T,index_list<I...> >::value[sizeof...(I)] = { T::at(I)... };
+
+    // keywords (and boolean-literals) are recognized with a perfect hash over the
+    // first character, last character and length of an identifier; the slot table
+    // is generated from this list and the hash is verified to be collision-free
+    struct keyword
+    {
+        const char* spelling;
+        int length;
+        token_t kind;
+    };
+    constexpr int cstrlen(const char* s)
+    { return *s ? 1+cstrlen(s+1) : 0; }
+#define RAMSEY_KEYWORD(spelling,kind) { spelling, cstrlen(spelling), kind }
+    constexpr keyword KEYWORDS[] = {
+        RAMSEY_KEYWORD("in",token_in), RAMSEY_KEYWORD("big",token_big), RAMSEY_KEYWORD("small",token_small),
+        RAMSEY_KEYWORD("boo",token_boo), RAMSEY_KEYWORD("if",token_if), RAMSEY_KEYWORD("elf",token_elf),
+        RAMSEY_KEYWORD("else",token_else), RAMSEY_KEYWORD("endif",token_endif), RAMSEY_KEYWORD("while",token_while),
+        RAMSEY_KEYWORD("smash",token_smash), RAMSEY_KEYWORD("endwhile",token_endwhile), RAMSEY_KEYWORD("fun",token_fun),
+        RAMSEY_KEYWORD("as",token_as), RAMSEY_KEYWORD("endfun",token_endfun), RAMSEY_KEYWORD("toss",token_toss),
+        /*RAMSEY_KEYWORD("take",token_take), RAMSEY_KEYWORD("give",token_give), // removed from language*/
+        RAMSEY_KEYWORD("mod",token_mod), RAMSEY_KEYWORD("or",token_or), RAMSEY_KEYWORD("and",token_and),
+        RAMSEY_KEYWORD("not",token_not), RAMSEY_KEYWORD("true",token_bool_true), RAMSEY_KEYWORD("false",token_bool_false)
+    };
+#undef RAMSEY_KEYWORD
+    const int KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+    const int KEYWORD_SLOTS = 32; // must be a power of 2
+
+    constexpr int keyword_hash(int first,int last,int length)
+    { return (first*26 + last*6 + length) & (KEYWORD_SLOTS-1); }
+    constexpr int keyword_hash_of(int k)
+    { return keyword_hash(KEYWORDS[k].spelling[0],KEYWORDS[k].spelling[KEYWORDS[k].length-1],KEYWORDS[k].length); }
+    constexpr int keyword_in_slot(int slot,int k)
+    { return k>=KEYWORD_COUNT ? -1 : keyword_hash_of(k)==slot ? k : keyword_in_slot(slot,k+1); }
+    constexpr bool keyword_hash_collides(int i,int j)
+    {
+        return i>=KEYWORD_COUNT ? false
+            : j>=KEYWORD_COUNT ? keyword_hash_collides(i+1,i+2)
+            : keyword_hash_of(i)==keyword_hash_of(j) ? true
+            : keyword_hash_collides(i,j+1);
+    }
+    static_assert(!keyword_hash_collides(0,1),"keyword hash is not perfect; choose new multipliers in keyword_hash()");
+
+    struct char_class_gen
+    { static constexpr int at(int i) { return char_class_of(i); } };
+    struct transition_gen
+    { static constexpr int at(int i) { return transition(i/cc_count,i%cc_count); } };
+    struct accept_gen
+    { static constexpr int at(int i) { return accept_of(i); } };
+    struct keyword_slot_gen
+    { static constexpr int at(int i) { return keyword_in_slot(i,0); } };
+
+    typedef scan_table<char_class_gen,make_index_list<256>::type> char_classes;
+    typedef scan_table<transition_gen,make_index_list<s_count*cc_count>::type> transitions;
+    typedef scan_table<accept_gen,make_index_list<s_count>::type> accepts;
+    typedef scan_table<keyword_slot_gen,make_index_list<KEYWORD_SLOTS>::type> keyword_slots;
+}
+
 // token
-token::token(token_t kind)
-    : _tkind(kind), _tsource(NULL)
+// ramsey::token_table
+token_table::token_table(const char* base,const identifier_table* names)
+    : _base(base), _names(names)
 {
 }
-token::token(token_t kind,const char* source)
-    : _tkind(kind)
+void token_table::clear()
 {
-    _alloc(source,strlen(source));
+    _kinds.clear();
+    _offsets.clear();
+    _lengths.clear();
+    _lines.clear();
+    _text.clear();
 }
-token::token(token_t kind,const char* source,int length)
-    : _tkind(kind)
+void token_table::resize(int count)
 {
-    if (length < 0)
-        throw lexer_exception("negative length specified for token source string");
-    _alloc(source,length);
+    // the text of the dropped tokens is at the end of the text buffer
+    for (int i = count;i < size();++i) {
+        if (_offsets[i]!=NO_SOURCE && (_offsets[i] & TEXT_BIT)) {
+            _text.resize(_offsets[i] & ~TEXT_BIT);
+            break;
+        }
+    }
+    _kinds.resize(count);
+    _offsets.resize(count);
+    _lengths.resize(count);
+    _lines.resize(count);
 }
-token::token(const token& obj)
-    : _tkind(obj._tkind)
+void token_table::reserve(int count)
 {
-    if (obj._tsource != NULL)
-        _alloc(obj._tsource,strlen(obj._tsource));
-    else
-        _tsource = NULL;
+    _kinds.reserve(count);
+    _offsets.reserve(count);
+    _lengths.reserve(count);
+    _lines.reserve(count);
+}
+void token_table::push_text(token_t kind,int line,const char* text,int length)
+{
+    _push(kind,line,unsigned(_text.size()) | TEXT_BIT,length);
+    _text.append(text,length);
 }
-token::~token()
+void token_table::push(const token& tok)
 {
-    if (_tsource != NULL)
-        delete[] _tsource;
+    // source text that is not addressed from this table's base is copied
+    const char* src = tok.source();
+    if (tok.type() == token_id)
+        push_ident(tok.line(),tok.ident());
+    else if (src == NULL)
+        push(tok.type(),tok.line());
+    else if ((tok._table->_offsets[tok._index] & TEXT_BIT) || tok._table->_base!=_base)
+        push_text(tok.type(),tok.line(),src,tok.source_length());
+    else
+        push(tok.type(),tok.line(),src,tok.source_length());
 }
-token& token::operator =(const token& obj)
+void token_table::append(const token_table& other,int lineoffset,const int* idmap)
 {
-    if (this != &obj) {
-        if (_tsource != NULL)
-            delete[] _tsource;
-        _tkind = obj._tkind;
-        if (obj._tsource == NULL)
-            _tsource = NULL;
-        else
-            _alloc(obj._tsource,strlen(obj._tsource));
+    unsigned textoffset = unsigned(_text.size());
+    _kinds.insert(_kinds.end(),other._kinds.begin(),other._kinds.end());
+    for (size_t i = 0;i < other._offsets.size();++i) {
+        unsigned offset = other._offsets[i], length = other._lengths[i];
+        if (offset!=NO_SOURCE && (offset & TEXT_BIT))
+            offset += textoffset;
+        else if (idmap!=NULL && other._kinds[i]==token_id)
+            length = unsigned(idmap[length]);
+        _offsets.push_back(offset);
+        _lengths.push_back(length);
+        _lines.push_back(other._lines[i] + lineoffset);
     }
-    return *this;
+    _text += other._text;
+}
+
+// ramsey::token
+const char* token::source() const
+{
+    if (type() == token_id)
+        return _table->_names->spelling(ident());
+    unsigned offset = _table->_offsets[_index];
+    if (offset == token_table::NO_SOURCE)
+        return NULL;
+    if (offset & token_table::TEXT_BIT)
+        return _table->_text.data() + (offset & ~token_table::TEXT_BIT);
+    return _table->_base + offset;
 }
 const char* token::to_string_kind() const
 {
-    switch (_tkind) {
+    switch (type()) {
     case token_invalid:
         return "token_invalid";
     case token_id:
@@ -166,332 +407,294 @@ const char* token::to_string_kind() const
 string token::to_string() const
 {
     string result = to_string_kind();
-    if (_tsource != NULL) {
+    if (const char* src = source()) {
         result += " { ";
-        result += _tsource;
+        result.append(src,source_length());
         result += " }";
     }
     return result;
 }
-void token::_alloc(const char* source,int length)
-{
-    int i;
-    // allocate a buffer to store the source string
-    _tsource = new char[length+1]; // (account for the null character)
-    // copy the source string to the buffer
-    for (i = 0;i < length;++i)
-        _tsource[i] = source[i];
-    _tsource[i] = 0;
-}
 
 // ramsey::lexer
-lexer::lexer(const char* file)
+lexer::lexer(const char* file,thread_pool* pool,bool ondemand)
+    : _source(file), _stream(_source.begin(),&_names), _tokens(&_stream), _iter(0), _next(_source.begin()), _line(1),
+      _window(NULL), _winline(1), _ondemand(ondemand), _kept(_source.begin(),&_names), _end(_source.begin(),&_names)
+{
+    _end.push(token_eol,0);
+    if (ondemand) {
+        // scan just the first window; the rest is scanned as the parser advances
+        _refill();
+        return;
+    }
+    // token tables address source text by 31-bit offsets (on-demand mode
+    // addresses it from the window, so the file may be larger)
+    if (_source.size() >= token_table::TEXT_BIT)
+        throw lexer_error("input file is too large: %s",file);
+    // decompose the mapped input file into lexical tokens
+    if (pool!=NULL && pool->size()>1)
+        _scan_parallel(*pool);
+    else
+        _line = _scan(_source.begin(),_source.end(),1,_stream,_names);
+    _next = _source.end();
+}
+lexer::lexer(const lexer& whole,const position& pos)
+    : _tokens(whole._tokens), _iter(pos.index), _next(NULL), _line(whole._line), _window(NULL), _winline(1),
+      _ondemand(false)
 {
-    vector<ptoken> ptoks;
-    // open input file and decompose it into preprocessing tokens
-    _preprocess(file,ptoks);
-    // convert preprocessing tokens into lexical tokens
-    _convert(ptoks);
-    // set iterator at beginning
-    _iter = _stream.begin();
+    // the stream is never refilled (there is no source left to scan), so
+    // this lexer only reads the tokens of 'whole'; it can do so while
+    // other lexers read them too
+    _end.push(token_eol,0);
 }
-lexer& lexer::operator ++()
+token lexer::keeptok()
 {
-    ++_iter;
-    return *this;
+    if (_next == _source.end())
+        return curtok(); // the table is never refilled again
+    _kept.push(curtok());
+    return token(&_kept,_kept.size()-1);
 }
-lexer lexer::operator ++(int)
+void lexer::release(int count)
 {
-    lexer tmp = *this;
-    _iter++;
-    return tmp;
+    _kept.resize(count);
+}
+lexer::position lexer::mark() const
+{
+    position pos;
+    pos.window = _window;
+    pos.line = _winline;
+    pos.index = _iter;
+    return pos;
+}
+void lexer::seek(const position& pos)
+{
+    // in on-demand mode the window holding the token is scanned again
+    // unless it is the current one; a window always begins at the same
+    // place, so it is scanned into the same tokens
+    if (pos.window != _window) {
+        _next = pos.window;
+        _line = pos.line;
+        _refill();
+    }
+    _iter = pos.index;
+}
+void lexer::_refill()
+{
+    /* scan the next window of source into the (reused) token table; a window
+       is at least WINDOW bytes and is extended to the end of a line, since every
+       lexical construct ends at or before a '\n' */
+    static const size_t WINDOW = 4096;
+    const char* e = _source.end();
+    _stream.clear();
+    while (_stream.size()==0 && _next<e) {
+        const char* p = e;
+        if (size_t(e - _next) > WINDOW) {
+            p = scan_comment(_next + WINDOW,e);
+            if (p < e)
+                ++p;
+        }
+        if (size_t(p - _next) >= token_table::TEXT_BIT)
+            throw lexer_error("line %d: line is too long",_line);
+        _window = _next;
+        _winline = _line;
+        _stream._base = _window;
+        _line = _scan(_next,p,_line,_stream,_names);
+        _next = p;
+    }
+    _iter = 0;
 }
 #ifdef RAMSEY_DEBUG
 void lexer::output(ostream& stream) const
 {
-    vector<token>::const_iterator iter = _stream.begin();
-    if (iter != _stream.end()) {
-        int i = 1;
-        stream << *iter;
-        for (;iter != _stream.end();++iter) {
-            if (i++%5 == 0)
+    if (_ondemand)
+        throw lexer_exception("lexer::output: token stream was not scanned whole");
+    if (_stream.size() > 0) {
+        stream << token(&_stream,0);
+        for (int i = 0;i < _stream.size();++i) {
+            if ((i+1)%5 == 0)
                 stream << ",\n";
             else
                 stream << ", ";
-            stream << *iter;
+            stream << token(&_stream,i);
         }
     }
 }
 #endif
-/*static*/ void lexer::_preprocess(const char* file,vector<ptoken>& ptoks)
+void lexer::_scan_parallel(thread_pool& pool)
 {
-    /* preprocess the input stream; this involves partial token
-       decomposition; the tokens produced here will be converted
-       into lexical tokens; note: a single ptoken may be converted
-       into more than one lexical token (e.g. through maximal munch) */
-    FILE* input;
-    // open input file
-    input = fopen(file,"r");
-    if (input == NULL)
-        throw lexer_error("can't read input file: %s",strerror(errno));
-    while (true) {
-        ptoken tok;
-        int ch = fgetc(input);
-        // end of file
-        if (ch == EOF)
-            break;
-        if (isspace(ch)) {
-            // handle whitespace
-            if (ch == '\n')
-                // only count '\n' for logical lines
-                tok.kind = ptoken_eol;
-            else
-                // ignore all other whitespace
-                continue;
-        }
-        else if (ch == '#') {
-            // '#' denotes a comment; strip it out
-            while (true) {
-                ch = fgetc(input);
-                if (ch == '\n') {
-                    ungetc(ch,input);
-                    break;
-                }
-            }
+    /* the lexical grammar is line-local: comments end at '\n' and string literals
+       may not contain one; so the source can be cut after any '\n' and the pieces
+       lexed independently; the token streams are then concatenated in order (the
+       '\n' tokens come along, so the parser counts the same line numbers) */
+    static const size_t MIN_CHUNK = 64 * 1024;
+    const char* b = _source.begin(), *e = _source.end();
+    size_t n = size_t(pool.size()) * 4; // oversplit a little to balance the load
+    if (_source.size() / MIN_CHUNK < n)
+        n = _source.size() / MIN_CHUNK;
+    if (n <= 1) {
+        _line = _scan(b,e,1,_stream,_names);
+        return;
+    }
+    // find the chunk boundaries: just past the first '\n' at or after each even split point
+    vector<const char*> bounds;
+    bounds.push_back(b);
+    for (size_t i = 1;i < n;++i) {
+        const char* p = b + _source.size() / n * i;
+        if (p < bounds.back())
             continue;
-        }
-        else if (isdigit(ch)) {
-            // number token
-            tok.kind = ptoken_number;
-            if (ch == '0') {
-                // check for hexadecimal literal
-                int chnext = fgetc(input);
-                if (chnext=='x' || chnext=='X')
-                    tok.kind = ptoken_number_hex;
-                else
-                    ungetc(chnext,input);
-            }
-            do {
-                tok.payload.push_back(ch);
-                ch = fgetc(input);
-            } while (isdigit(ch) || (tok.kind==ptoken_number_hex && ishexletter(ch)));
-            ungetc(ch,input);
-        }
-        else if (isalpha(ch) || ch=='_') {
-            // identifier token
-            tok.kind = ptoken_identifier;
-            do {
-                tok.payload.push_back(ch);
-                ch = fgetc(input);
-            } while (isalpha(ch) || ch=='_' || isdigit(ch));
-            ungetc(ch,input);
-        }
-        else if (ch == '\"') {
-            // string token
-            tok.kind = ptoken_string;
-            while (true) {
-                ch = fgetc(input);
-                // check for end of string
-                if (ch == '\"')
-                    break;
-                if (ch=='\r' || ch=='\n')
-                    throw lexer_error("found newline in string literal");
-                // handle escape characters
-                if (ch == '\\') {
-                    // translate the escape character to its actual value
-                    //  valid escape characters include: \\ \" \n \r \t \0
-                    ch = fgetc(input);
-                    if (ch == 'n')
-                        ch = '\n';
-                    else if (ch == 'r')
-                        ch = '\r';
-                    else if (ch == 't')
-                        ch = '\t';
-                    else if (ch == '0')
-                        ch = 0;
-                    else if (ch!='\\' && ch!='\"') // anything else (excluding as-is escape characters)
-                        // should this be a warning?
-                        throw lexer_error("escape character '\\%c' is not supported",ch);
-                }
-                tok.payload.push_back(ch);
-            }
-        }
-        else if (isoppunc(ch)) {
-            // operator-punctuator token
-            tok.kind = ptoken_puncop;
-            do {
-                tok.payload.push_back(ch);
-                ch = fgetc(input);
-            } while (isoppunc(ch));
-            ungetc(ch,input);
-        }
-        else
-            throw lexer_error("stray '%c' character in program text",ch);
-        // add the preprocessing token
-        ptoks.push_back(tok);
+        p = scan_comment(p,e);
+        if (p >= e)
+            break;
+        bounds.push_back(p + 1);
+    }
+    bounds.push_back(e);
+    // lex the chunks, numbering lines relative to the chunk start and interning
+    // identifiers into chunk-local tables
+    int chunks = int(bounds.size()) - 1;
+    vector<identifier_table> names(chunks);
+    vector<token_table> toks;
+    vector<int> lines(chunks);
+    for (int i = 0;i < chunks;++i)
+        toks.emplace_back(b,&names[i]);
+    pool.run(chunks,[&](int i) {
+        lines[i] = _scan(bounds[i],bounds[i+1],0,toks[i],names[i]);
+    });
+    // concatenate the results
+    int total = 0;
+    for (int i = 0;i < chunks;++i)
+        total += toks[i].size();
+    _stream.reserve(total);
+    _line = 1;
+    for (int i = 0;i < chunks;++i) {
+        // merging the chunk tables in order assigns the same IDs as a serial scan
+        vector<int> idmap(names[i].size());
+        for (int id = 0;id < names[i].size();++id)
+            idmap[id] = _names.intern(names[i].spelling(id),names[i].length(id));
+        _stream.append(toks[i],_line,idmap.empty() ? NULL : &idmap[0]);
+        _line += lines[i];
     }
-    fclose(input);
 }
-void lexer::_convert(vector<ptoken>& ptoks)
+/*static*/ int lexer::_scan(const char* p,const char* e,int line,token_table& toks,identifier_table& names)
 {
-    // convert preprocessor tokens into lexical tokens
-    for (auto iter = ptoks.begin();iter != ptoks.end();++iter) {
-        switch (iter->kind) {
-            // an identifier could be a keyword of some sort (or boolean-literal)
-        case ptoken_identifier:
-        {
-            token_t t;
-            bool isKeyword = true;
-            // if the identifier is a keyword then flag it
-            if (iter->payload == "in")
-                t = token_in;
-            else if (iter->payload == "big")
-                t = token_big;
-            else if (iter->payload == "small")
-                t = token_small;
-            else if (iter->payload == "boo")
-                t = token_boo;
-            else if (iter->payload == "if")
-                t = token_if;
-            else if (iter->payload == "elf")
-                t = token_elf;
-            else if (iter->payload == "else")
-                t = token_else;
-            else if (iter->payload == "endif")
-                t = token_endif;
-            else if (iter->payload == "while")
-                t = token_while;
-            else if (iter->payload == "smash")
-                t = token_smash;
-            else if (iter->payload == "endwhile")
-                t = token_endwhile;
-            else if (iter->payload == "fun")
-                t = token_fun;
-            else if (iter->payload == "as")
-                t = token_as;
-            else if (iter->payload == "endfun")
-                t = token_endfun;
-            else if (iter->payload == "toss")
-                t = token_toss;
-            /*else if (iter->payload == "take") // removed from language
-                t = token_take;
-            else if (iter->payload == "give")
-                t = token_give;*/
-            else if (iter->payload == "mod")
-                t = token_mod;
-            else if (iter->payload == "or")
-                t = token_or;
-            else if (iter->payload == "and")
-                t = token_and;
-            else if (iter->payload == "not")
-                t = token_not;
-            else if (iter->payload == "true")
-                t = token_bool_true;
-            else if (iter->payload == "false")
-                t = token_bool_false;
-            else {
-                isKeyword = false;
-                t = token_id;
+    /* scan the source buffer, emitting lexical tokens directly; each token
+       is recognized by running the DFA from the start state until it has no
+       transition on the next character (maximal munch); token payloads are
+       views into the source buffer */
+    const signed char* classes = char_classes::value;
+    const signed char* next = transitions::value;
+    while (p < e) {
+        const char* start = p;
+        int state = next[s_start*cc_count + classes[(unsigned char)*p]], s;
+        if (state == s_stop)
+            throw lexer_error("stray '%c' character in program text",*p);
+        ++p;
+        // runs of whitespace, comment text and identifier characters make up most
+        // of the input; these states only loop on themselves, so their runs are
+        // consumed by the (vectorized) scanning kernels rather than the DFA
+        if (state == s_space)
+            p = scan_space(p,e);
+        else if (state == s_comment)
+            p = scan_comment(p,e);
+        else if (state == s_ident)
+            p = scan_word(p,e);
+        else {
+            while (p<e && (s = next[state*cc_count + classes[(unsigned char)*p]]) != s_stop) {
+                state = s;
+                ++p;
             }
-
-            if (isKeyword)
-                _stream.emplace_back(t);
-            else
-                // save payload for non-keyword identifier
-                _stream.emplace_back(t,iter->payload.c_str());
-            break;
         }
-        // simply convert number, number-hex, string, and eol tokens to 
-        // their lexical counterparts
-        case ptoken_number:
-            _stream.emplace_back(token_number,iter->payload.c_str());
+        switch (int kind = accepts::value[state]) {
+        case accept_skip:
             break;
-        case ptoken_number_hex:
-            _stream.emplace_back(token_number_hex,iter->payload.c_str());
+        case accept_string:
+            p = _scan_string(p,e,line,toks);
             break;
-        case ptoken_string:
-            _stream.emplace_back(token_string,iter->payload.c_str());
+        case accept_error:
+            throw lexer_error("stray '%c' character in program text",*start);
+        case token_id:
+            kind = keyword_kind(start,int(p - start));
+            if (kind != token_id) {
+                toks.push(token_t(kind),line);
+                break;
+            }
+            // save payload for non-keyword identifier
+            toks.push_ident(line,names.intern(start,int(p - start)));
             break;
-        case ptoken_eol:
-            _stream.emplace_back(token_eol);
+        case token_number:
+        case token_number_hex:
+            // the hexadecimal view includes the '0x' prefix
+            toks.push(token_t(kind),line,start,int(p - start));
             break;
-            // a punctuator-operator at the preprocessing level is a sequence of potential
-            // operator punctuators; here the sequence must be separated into valid lexical
-            // tokens of the longest valid token kind (maximal munch)
-        case ptoken_puncop:
-        {
-            char swp = 0;
-            char* str = &iter->payload[0];
-            size_t sz = iter->payload.length();
-            size_t i = sz;
-            while (i > 0) {
-                while (true) {
-                    token_t t = token_invalid;
-                    if (strcmp(str,"+") == 0)
-                        t = token_add;
-                    else if (strcmp(str,"-") == 0)
-                        t = token_subtract;
-                    else if (strcmp(str,"*") == 0)
-                        t = token_multiply;
-                    else if (strcmp(str,"/") == 0)
-                        t = token_divide;
-                    else if (strcmp(str,"<") == 0)
-                        t = token_less;
-                    else if (strcmp(str,">") == 0)
-                        t = token_greater;
-                    else if (strcmp(str,"<=") == 0)
-                        t = token_le;
-                    else if (strcmp(str,">=") == 0)
-                        t = token_ge;
-                    else if (strcmp(str,"=") == 0)
-                        t = token_equal;
-                    else if (strcmp(str,"!=") == 0)
-                        t = token_nequal;
-                    else if (strcmp(str,"<-") == 0)
-                        t = token_assign;
-                    else if (strcmp(str,"(") == 0)
-                        t = token_oparen;
-                    else if (strcmp(str,")") == 0)
-                        t = token_cparen;
-                    /*else if (strcmp(str,"[") == 0) // removed from language
-                        t = token_lscript;
-                    else if (strcmp(str,"]") == 0)
-                        t = token_rscript;*/
-                    else if (strcmp(str,",") == 0)
-                        t = token_comma;
-                    else if (i == 0) {
-                        str[i] = swp;
-                        throw lexer_exception("couldn't process puncop preprocessing token: '%s'",iter->payload.c_str());
-                    }
-                    str[i] = swp;
-                    if (t != token_invalid) {
-                        _stream.emplace_back(t);
-                        break;
-                    }
-                    --i;
-                    swp = str[i];
-                    str[i] = 0;
-                }
-                str += i;
-                sz -= i;
-                i = sz;
-                swp = str[i];
-            }
+        case token_eol:
+            toks.push(token_eol,line++);
             break;
-        }
         default:
-            throw lexer_exception("bad preprocessing token in ptoken stream");
+            // operators and punctuators carry no payload
+            toks.push(token_t(kind),line);
         }
     }
+    return line;
 }
-/*static*/ inline bool lexer::ishexletter(int ch)
+/*static*/ const char* lexer::_scan_string(const char* p,const char* e,int line,token_table& toks)
 {
-    return (ch>='A' && ch<='F') || (ch>='a' && ch<='f');
+    /* scan a string literal starting after its opening '"'; the payload
+       is a view of the literal's text unless it contains escape characters,
+       in which case it is translated into a copy owned by the token table */
+    const char* start = p;
+    string translated;
+    bool escaped = false;
+    while (true) {
+        int ch;
+        if (p >= e)
+            throw lexer_error("unterminated string literal");
+        ch = (unsigned char)*p;
+        // check for end of string
+        if (ch == '\"')
+            break;
+        if (ch=='\r' || ch=='\n')
+            throw lexer_error("found newline in string literal");
+        // handle escape characters
+        if (ch == '\\') {
+            if (!escaped) {
+                translated.assign(start,p-start);
+                escaped = true;
+            }
+            if (++p >= e)
+                throw lexer_error("unterminated string literal");
+            // translate the escape character to its actual value
+            //  valid escape characters include: \\ \" \n \r \t \0
+            ch = (unsigned char)*p;
+            if (ch == 'n')
+                ch = '\n';
+            else if (ch == 'r')
+                ch = '\r';
+            else if (ch == 't')
+                ch = '\t';
+            else if (ch == '0')
+                ch = 0;
+            else if (ch!='\\' && ch!='\"') // anything else (excluding as-is escape characters)
+                // should this be a warning?
+                throw lexer_error("escape character '\\%c' is not supported",ch);
+            translated.push_back(ch);
+        }
+        else if (escaped)
+            translated.push_back(ch);
+        ++p;
+    }
+    if (escaped)
+        toks.push_text(token_string,line,translated.data(),int(translated.length()));
+    else
+        toks.push(token_string,line,start,int(p - start));
+    return p + 1; // skip closing '"'
 }
-/*static*/ inline bool lexer::isoppunc(int ch)
+/*static*/ token_t lexer::keyword_kind(const char* s,int length)
 {
-    static const string acceptChars("+-*/<>=!,()");
-    return acceptChars.find(char(ch)) != string::npos;
+    // if the identifier is a keyword (or boolean-literal) then flag it; the
+    // perfect hash selects the only keyword that could match, so at most one
+    // comparison is made
+    int k = keyword_slots::value[keyword_hash((unsigned char)s[0],(unsigned char)s[length-1],length)];
+    if (k>=0 && KEYWORDS[k].length==length && memcmp(s,KEYWORDS[k].spelling,length)==0)
+        return KEYWORDS[k].kind;
+    return token_id;
 }
 
 // ostream operator overloads for debugging
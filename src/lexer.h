@@ -4,9 +4,13 @@
 #include <exception>
 #include <vector>
 #include "ramsey-error.h" // gets <string>, <ostream>
+#include "srcmap.h"
+#include "intern.h"
 
 namespace ramsey
 {
+    class thread_pool;
+
     // exception types
     class lexer_error : public compiler_error_generic // errors reported to user
     {
@@ -79,75 +83,163 @@ namespace ramsey
         token_eol // '\n' (we have to denote the end of a statement)
     };
 
-    // represents a lexical token
-    class token
+    class token;
+
+    // stores a sequence of lexical tokens as parallel arrays (kind, source
+    // offset, source length, line number); a token's source text is located
+    // by an offset from the table's base (the start of the source buffer, or
+    // of the window scanned in on-demand mode) or, for translated string
+    // literals, into the table's own text buffer; for identifiers the length
+    // slot holds the interned ID instead (the spelling is the identifier
+    // table's)
+    class token_table
     {
     public:
-        token(token_t kind);
-        token(token_t kind,const char* source);
-        token(token_t kind,const char* source,int length);
-        token(const token&);
-        ~token();
+        token_table(const char* base = NULL,const identifier_table* names = NULL);
+
+        int size() const
+        { return int(_kinds.size()); }
+        void clear();
+        void resize(int count); // drop the tokens after the first 'count'
+        void reserve(int count);
+        void push(token_t kind,int line)
+        { _push(kind,line,NO_SOURCE,0); }
+        void push(token_t kind,int line,const char* source,int length) // 'source' lies in the source buffer
+        { _push(kind,line,unsigned(source - _base),length); }
+        void push_ident(int line,int id)
+        { _push(token_id,line,NO_SOURCE,id); }
+        void push_text(token_t kind,int line,const char* text,int length); // copies 'text' into the table
+        void push(const token& tok); // copy a token from another table (sharing this table's identifiers)
+        // append 'other', which must share this table's source buffer; its identifier IDs are
+        // translated through 'idmap' (if given) and its line numbers offset by 'lineoffset'
+        void append(const token_table& other,int lineoffset,const int* idmap = NULL);
+    private:
+        friend class token;
+        friend class lexer;
+        static const unsigned NO_SOURCE = 0xffffffff;
+        static const unsigned TEXT_BIT = 0x80000000;
+
+        const char* _base;
+        const identifier_table* _names;
+        std::vector<unsigned char> _kinds;
+        std::vector<unsigned> _offsets;
+        std::vector<unsigned> _lengths;
+        std::vector<int> _lines;
+        std::string _text; // translated string literals (referred to by offsets with TEXT_BIT set)
+
+        void _push(token_t kind,int line,unsigned offset,int length)
+        {
+            _kinds.push_back((unsigned char)kind);
+            _offsets.push_back(offset);
+            _lengths.push_back(unsigned(length));
+            _lines.push_back(line);
+        }
+    };
 
-        token& operator =(const token&);
+    // represents a lexical token; a token is a cursor designating an entry in
+    // a token table, so it is cheap to copy and is only valid for the lifetime
+    // of that table; its source text is NOT null-terminated
+    class token
+    {
+    public:
+        token() // the null token
+            : _table(NULL), _index(0) {}
+        token(const token_table* table,int index)
+            : _table(table), _index(index) {}
 
+        bool valid() const
+        { return _table != NULL; }
         token_t type() const
-        { return _tkind; }
-        const char* source_string() const
-        { return _tsource; }
+        { return token_t(_table->_kinds[_index]); }
+        int line() const
+        { return _table->_lines[_index]; }
+        const char* source() const; // NULL if the token carries no payload
+        int source_length() const
+        { return type()==token_id ? _table->_names->length(ident()) : int(_table->_lengths[_index]); }
+        int ident() const // interned identifier ID (identifiers only)
+        { return int(_table->_lengths[_index]); }
+        std::string source_string() const // copy the source text (for diagnostics)
+        { return std::string(source(),source_length()); }
 
         // get human-readable strings describing the token (for testing)
         const char* to_string_kind() const; // just the kind
         std::string to_string() const; // kind plus any payload
     private:
-        token_t _tkind;
-        char* _tsource;
-
-        void _alloc(const char* source,int length);
+        friend class token_table;
+        const token_table* _table;
+        int _index;
     };
-    
-    // the lexer class, reads the file and creates a stream of tokens
+
+    // the lexer class, reads the file and creates a stream of tokens; the
+    // stream is either scanned whole up front or, in on-demand mode, a small
+    // window of source at a time as the tokens are consumed
     class lexer
     {
     public:
-        lexer(const char* file);
+        // a position in the token stream that scanning can be resumed at
+        struct position
+        {
+            const char* window; // where the window holding the token begins (on-demand mode)
+            int line; // line number at 'window'
+            int index; // index of the token in its window (or in the whole stream)
+        };
+
+        lexer(const char* file,thread_pool* pool = NULL,bool ondemand = false); // lex in parallel chunks if 'pool' is given
+        lexer(const lexer& whole,const position& pos); // read the stream of a lexer that scanned it whole, beginning at 'pos'
         // provide means to access tokens
-        const token& curtok() const
-        { return *_iter; }
+        token curtok() const // past the last token this is an end-of-line that cannot be consumed
+        { return endtok() ? token(&_end,0) : token(_tokens,_iter); }
+        token keeptok(); // get a cursor to the current token that stays valid for the lexer's lifetime
+        int kept() const // number of tokens kept by 'keeptok' (in on-demand mode)
+        { return _kept.size(); }
+        void release(int count); // drop the tokens kept after the first 'count' (their cursors become invalid)
+        int curline() const // line number of the current token (one past the last line at the end)
+        { return endtok() ? _line : _tokens->_lines[_iter]; }
+        const identifier_table& identifiers() const
+        { return _names; }
         bool endtok() const
-        { return _iter == _stream.end(); }
-        lexer& operator ++();
-        lexer operator ++(int);
+        { return _iter == _tokens->size(); }
+        position mark() const; // get the position of the current token
+        void seek(const position& pos); // make the token at 'pos' (a position from 'mark') current
+        lexer& operator ++()
+        {
+            if (++_iter == _tokens->size() && _next != _source.end())
+                _refill();
+            return *this;
+        }
+
+        static token_t keyword_kind(const char* s,int length); // classify identifier (token_id if not a keyword)
 
 #ifdef RAMSEY_DEBUG
         void output(std::ostream&) const;
 #endif
     private:
-        std::vector<token> _stream;
-        std::vector<token>::const_iterator _iter;
-        std::string _input;
-
-        // preprocessing token flags
-        enum {
-            ptoken_identifier,
-            ptoken_number,
-            ptoken_number_hex,
-            ptoken_string,
-            ptoken_puncop,
-            ptoken_eol
-        };
-        struct ptoken
-        {
-            int kind;
-            std::string payload;
-        };
-
-        static void _preprocess(const char* file,std::vector<ptoken>& ptoks); // compile preprocessing tokens
-        void _convert(std::vector<ptoken>& ptoks); // convert preprocessing tokens to lexical tokens
-
-        // helpers for character classes
-        static inline bool ishexletter(int ch);
-        static inline bool isoppunc(int ch);
+        // disallow copying (tokens refer into the source mapping)
+        lexer(const lexer&);
+        lexer& operator =(const lexer&);
+
+        source_map _source;
+        identifier_table _names;
+        token_table _stream; // all tokens, or the current window in on-demand mode
+        const token_table* _tokens; // the stream read: '_stream', or that of the lexer this one reads
+        int _iter; // index of the current token in '_stream'
+        const char* _next; // where the next window begins (end of source when scanned whole)
+        int _line; // line number at '_next'
+        const char* _window; // where the current window begins (NULL when scanned whole)
+        int _winline; // line number at '_window'
+        bool _ondemand;
+        token_table _kept; // tokens kept by 'keeptok' in on-demand mode
+        token_table _end; // the token returned by 'curtok' at the end of the stream
+
+        void _scan_parallel(thread_pool& pool);
+        void _refill();
+
+        // scan [p,e) into lexical tokens in a single pass, numbering lines from 'line'; the
+        // range must begin at the start of a line (all lexical constructs end at or before
+        // a '\n'); returns the line number at 'e'
+        static int _scan(const char* p,const char* e,int line,token_table& toks,identifier_table& names);
+        // scan string literal body; returns position past closing '"'
+        static const char* _scan_string(const char* p,const char* e,int line,token_table& toks);
     };
 
 #ifdef RAMSEY_DEBUG
@@ -0,0 +1,186 @@
+/* lexsimd.cpp */
+#include "lexsimd.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAMSEY_SCAN_X86
+#include <immintrin.h>
+#endif
+using namespace ramsey;
+
+// scalar kernels; these also finish the tail of a vectorized scan
+static inline bool is_space_char(int ch)
+{
+    return ch==' ' || ch=='\t' || ch=='\r' || ch=='\v' || ch=='\f';
+}
+static inline bool is_word_char(int ch)
+{
+    return (ch>='a' && ch<='z') || (ch>='A' && ch<='Z') || (ch>='0' && ch<='9') || ch=='_';
+}
+static const char* scan_space_scalar(const char* p,const char* e)
+{
+    while (p<e && is_space_char(*p))
+        ++p;
+    return p;
+}
+static const char* scan_comment_scalar(const char* p,const char* e)
+{
+    while (p<e && *p!='\n')
+        ++p;
+    return p;
+}
+static const char* scan_word_scalar(const char* p,const char* e)
+{
+    while (p<e && is_word_char(*p))
+        ++p;
+    return p;
+}
+
+#ifdef RAMSEY_SCAN_X86
+/* the vector kernels compute a mask of the bytes that still belong to the run;
+   the first clear bit (if any) marks the end of the run; only whole blocks are
+   loaded so that the scan never touches memory past 'e' */
+
+__attribute__((target("sse2")))
+static inline unsigned space_mask_sse2(__m128i v)
+{
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8(' ')),_mm_cmpeq_epi8(v,_mm_set1_epi8('\t')));
+    m = _mm_or_si128(m,_mm_cmpeq_epi8(v,_mm_set1_epi8('\r')));
+    m = _mm_or_si128(m,_mm_cmpeq_epi8(v,_mm_set1_epi8('\v')));
+    m = _mm_or_si128(m,_mm_cmpeq_epi8(v,_mm_set1_epi8('\f')));
+    return unsigned(_mm_movemask_epi8(m));
+}
+__attribute__((target("sse2")))
+static inline unsigned word_mask_sse2(__m128i v)
+{
+    // fold case so that one range check covers both cases of letter; bytes above
+    // 0x7f compare as negative and so never fall inside a range
+    __m128i l = _mm_or_si128(v,_mm_set1_epi8(0x20));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(l,_mm_set1_epi8('a'-1)),_mm_cmpgt_epi8(_mm_set1_epi8('z'+1),l));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v,_mm_set1_epi8('0'-1)),_mm_cmpgt_epi8(_mm_set1_epi8('9'+1),v));
+    __m128i under = _mm_cmpeq_epi8(v,_mm_set1_epi8('_'));
+    return unsigned(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha,digit),under)));
+}
+__attribute__((target("sse2")))
+static const char* scan_space_sse2(const char* p,const char* e)
+{
+    for (;e-p >= 16;p += 16) {
+        unsigned m = ~space_mask_sse2(_mm_loadu_si128((const __m128i*)p)) & 0xffff;
+        if (m != 0)
+            return p + __builtin_ctz(m);
+    }
+    return scan_space_scalar(p,e);
+}
+__attribute__((target("sse2")))
+static const char* scan_comment_sse2(const char* p,const char* e)
+{
+    const __m128i eol = _mm_set1_epi8('\n');
+    for (;e-p >= 16;p += 16) {
+        unsigned m = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p),eol)));
+        if (m != 0)
+            return p + __builtin_ctz(m);
+    }
+    return scan_comment_scalar(p,e);
+}
+__attribute__((target("sse2")))
+static const char* scan_word_sse2(const char* p,const char* e)
+{
+    for (;e-p >= 16;p += 16) {
+        unsigned m = ~word_mask_sse2(_mm_loadu_si128((const __m128i*)p)) & 0xffff;
+        if (m != 0)
+            return p + __builtin_ctz(m);
+    }
+    return scan_word_scalar(p,e);
+}
+
+__attribute__((target("avx2")))
+static inline unsigned space_mask_avx2(__m256i v)
+{
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v,_mm256_set1_epi8(' ')),_mm256_cmpeq_epi8(v,_mm256_set1_epi8('\t')));
+    m = _mm256_or_si256(m,_mm256_cmpeq_epi8(v,_mm256_set1_epi8('\r')));
+    m = _mm256_or_si256(m,_mm256_cmpeq_epi8(v,_mm256_set1_epi8('\v')));
+    m = _mm256_or_si256(m,_mm256_cmpeq_epi8(v,_mm256_set1_epi8('\f')));
+    return unsigned(_mm256_movemask_epi8(m));
+}
+__attribute__((target("avx2")))
+static inline unsigned word_mask_avx2(__m256i v)
+{
+    __m256i l = _mm256_or_si256(v,_mm256_set1_epi8(0x20));
+    __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(l,_mm256_set1_epi8('a'-1)),_mm256_cmpgt_epi8(_mm256_set1_epi8('z'+1),l));
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v,_mm256_set1_epi8('0'-1)),_mm256_cmpgt_epi8(_mm256_set1_epi8('9'+1),v));
+    __m256i under = _mm256_cmpeq_epi8(v,_mm256_set1_epi8('_'));
+    return unsigned(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha,digit),under)));
+}
+__attribute__((target("avx2")))
+static const char* scan_space_avx2(const char* p,const char* e)
+{
+    for (;e-p >= 32;p += 32) {
+        unsigned m = ~space_mask_avx2(_mm256_loadu_si256((const __m256i*)p));
+        if (m != 0)
+            return p + __builtin_ctz(m);
+    }
+    return scan_space_sse2(p,e);
+}
+__attribute__((target("avx2")))
+static const char* scan_comment_avx2(const char* p,const char* e)
+{
+    const __m256i eol = _mm256_set1_epi8('\n');
+    for (;e-p >= 32;p += 32) {
+        unsigned m = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p),eol)));
+        if (m != 0)
+            return p + __builtin_ctz(m);
+    }
+    return scan_comment_sse2(p,e);
+}
+__attribute__((target("avx2")))
+static const char* scan_word_avx2(const char* p,const char* e)
+{
+    for (;e-p >= 32;p += 32) {
+        unsigned m = ~word_mask_avx2(_mm256_loadu_si256((const __m256i*)p));
+        if (m != 0)
+            return p + __builtin_ctz(m);
+    }
+    return scan_word_sse2(p,e);
+}
+#endif
+
+// kernel selection: done once during static initialization
+namespace
+{
+    struct scan_kernels
+    {
+        const char* (*space)(const char*,const char*);
+        const char* (*comment)(const char*,const char*);
+        const char* (*word)(const char*,const char*);
+    };
+
+    scan_kernels select_kernels()
+    {
+#ifdef RAMSEY_SCAN_X86
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports("avx2") ) {
+            scan_kernels k = { scan_space_avx2, scan_comment_avx2, scan_word_avx2 };
+            return k;
+        }
+        if ( __builtin_cpu_supports("sse2") ) {
+            scan_kernels k = { scan_space_sse2, scan_comment_sse2, scan_word_sse2 };
+            return k;
+        }
+#endif
+        scan_kernels k = { scan_space_scalar, scan_comment_scalar, scan_word_scalar };
+        return k;
+    }
+
+    const scan_kernels KERNELS = select_kernels();
+}
+
+const char* ramsey::scan_space(const char* p,const char* e)
+{
+    return KERNELS.space(p,e);
+}
+const char* ramsey::scan_comment(const char* p,const char* e)
+{
+    return KERNELS.comment(p,e);
+}
+const char* ramsey::scan_word(const char* p,const char* e)
+{
+    return KERNELS.word(p,e);
+}
@@ -0,0 +1,16 @@
+/* lexsimd.h - CS355 Compiler Project */
+#ifndef LEXSIMD_H
+#define LEXSIMD_H
+
+namespace ramsey
+{
+    // scanning kernels used by the lexer for the runs that dominate program
+    // text; each returns a pointer to the first character in [p,e) that is not
+    // part of the run (or 'e'); vectorized (SSE2/AVX2) versions are selected
+    // at startup according to CPUID, otherwise scalar versions are used
+    const char* scan_space(const char* p,const char* e); // skip ' ', '\t', '\r', '\v', '\f'
+    const char* scan_comment(const char* p,const char* e); // find the next '\n'
+    const char* scan_word(const char* p,const char* e); // skip [A-Za-z0-9_]
+}
+
+#endif
@@ -1,5 +1,6 @@
 /* parser.cpp */
 #include "parser.h"
+#include "threadpool.h"
 #include <cerrno>
 #include <cstring>
 #include <cctype>
@@ -14,6 +15,13 @@ parser_error::parser_error(const char* format, ...)
     _cstor(format,args);
     va_end(args);
 }
+entry_error::entry_error(const char* format, ...)
+{
+    va_list args;
+    va_start(args,format);
+    _cstor(format,args);
+    va_end(args);
+}
 parser_exception::parser_exception(const char* format, ...)
 {
     va_list args;
@@ -22,18 +30,114 @@ parser_exception::parser_exception(const char* format, ...)
     va_end(args);
 }
 
+// precedence levels of the binary operators, loosest first; an operator
+// of level 'n' takes operands of level 'n+1' (assignment takes its right
+// operand at its own level since it is right-associative)
+enum operator_level
+{
+    level_none,
+    level_assignment,
+    level_logical_or,
+    level_logical_and,
+    level_equality,
+    level_relational,
+    level_additive,
+    level_multiplicative
+};
+
+static operator_level get_operator_level(token_t type)
+{
+    switch (type) {
+    case token_assign:
+        return level_assignment;
+    case token_or:
+        return level_logical_or;
+    case token_and:
+        return level_logical_and;
+    case token_equal:
+    case token_nequal:
+        return level_equality;
+    case token_less:
+    case token_greater:
+    case token_le:
+    case token_ge:
+        return level_relational;
+    case token_add:
+    case token_subtract:
+        return level_additive;
+    case token_multiply:
+    case token_divide:
+    case token_mod:
+        return level_multiplicative;
+    default:
+        return level_none;
+    }
+}
+
+// n-ary operators collect all of the operands of a sequence in one node
+static bool is_nary_operator(int level)
+{
+    return level==level_logical_or || level==level_logical_and || level==level_additive || level==level_multiplicative;
+}
+
+// kinds of constructs that can be open on the parser's 'pending' stack
+enum pending_kind
+{
+    pending_if_body, // statement list of an if-statement
+    pending_elf_body, // statement list of an elf-clause
+    pending_else_body, // statement list of an else-clause
+    pending_while_body, // statement list of an iterative-statement
+    pending_operator, // operands of a binary operator ('level' is its operator_level)
+    pending_prefix, // operand of a prefix operator
+    pending_parentheses, // parenthesized expression ('line' is where it began)
+    pending_argument // argument of a function call
+};
+
 // ramsey::parser
 
-parser::parser(const char* file)
-    : linenumber(1), lex(file), ast(NULL)
+parser::parser(const char* file,thread_pool* pool,bool ondemand,const vector<const char*>* entries,bool stream)
+    : lex(file,pool,ondemand || stream), ast(NULL), kept(0)
 {
-    program();
+    // functions are parsed in parallel if there is more than one thread to
+    // parse with and the token stream is scanned whole; streaming always lexes
+    // on demand, so the tokens of the whole program are never held at once
+    program(entries,pool!=NULL && pool->size()>1 && !ondemand && !stream ? pool : NULL,stream);
+}
+parser::parser(const parser& whole,const vector<int>& funcs,int first,int last)
+    : lex(whole.lex,whole.extents[funcs[first]].start), ast(NULL), kept(0)
+{
+    // parse a run of the functions delimited by the pre-parser of 'whole'
+    elements.open_frame();
+    extent_list(whole.extents,funcs,first,last);
+    ast = ast_function_builder(nodes,elements).build();
+    elements.close_frame();
 }
 
-parser::~parser()
+const ast_node* parser::next_function()
 {
-    if (ast != NULL)
-        delete ast;
+    if ( streamed.empty() ) {
+        nodes.clear();
+        lex.release(kept);
+        return NULL;
+    }
+    lex.seek(extents[streamed.back()].start);
+    streamed.pop_back();
+    return streamed_function();
+}
+
+void parser::parse_remaining()
+{
+    // functions are streamed last to first, so those left to stream are the
+    // earliest in the source; each one is parsed in a frame of its own, above
+    // any that a function with an error left open
+    pending.clear();
+    for (size_t i = 0;i < streamed.size();++i) {
+        lex.seek(extents[streamed[i]].start);
+        streamed_function();
+    }
+    streamed.clear();
+    nodes.clear();
+    lex.release(kept);
 }
 
 bool parser::eol()    // eat all endlines and return whether there were any
@@ -43,83 +147,397 @@ bool parser::eol()    // eat all endlines and return whether there were any
     {
         ans = true;
         ++lex;
-        linenumber++;
     }
     return ans;
 }
 
-// recursive call definitions
+template<typename Builder>
+void parser::build_construct()
+{
+    // build a node from the elements of the current frame, then add it to
+    // the frame of the enclosing construct
+    ast_node* node = Builder(nodes,elements).build();
+    elements.close_frame();
+    elements.add_node(node);
+}
 
-void parser::program()
+void parser::open_pending(int kind,int level,int line)
 {
-    // parse the program and build the abstract syntax tree
-    ast_function_builder builder;
-    builders.push(&builder);
-    function_list();
-    builders.pop();
-    if ( !builder.is_empty() ) // source file could have been empty...
-        ast = builder.build();
+    pending_construct c;
+    c.kind = (unsigned char)kind;
+    c.level = (unsigned char)level;
+    c.line = line;
+    pending.push_back(c);
 }
 
-void parser::function_list()
+// grammar rule definitions; constructs that nest (statement blocks and
+// expressions) are parsed by loops that keep the open constructs on the
+// 'pending' stack, so the native stack does not grow with nesting depth
+
+void parser::program(const vector<const char*>* entries,thread_pool* pool,bool stream)
 {
-    eol();
-    if (lex.endtok())
-        return;
-    else if (lex.curtok().type() == token_fun)
-    {
-        function();
+    // parse the program and build the abstract syntax tree; if only some
+    // functions are to be parsed, the functions are parsed in parallel, or
+    // they are streamed, the pre-parser delimits them first
+    elements.open_frame();
+    lexer::position start = lex.mark();
+    if (entries==NULL && pool==NULL && !stream)
         function_list();
+    else if ( !preparse_function_list(entries != NULL) ) {
+        // the functions cannot be delimited (or one has an error): parse the
+        // program as usual so that the error is reported just as it is
+        // without pre-parsing
+        pending.clear();
+        lex.seek(start);
+        function_list(stream);
+    }
+    else {
+        vector<int> funcs;
+        const char* missing = entries!=NULL ? reachable_functions(*entries,funcs) : NULL;
+        if (missing != NULL) {
+            // an entry point is not a function: parse the program in full so
+            // that a syntax error the pre-parser passed is reported first
+            lex.seek(start);
+            function_list();
+            throw entry_error("entry point '%s' is not a function in this program", missing);
+        }
+        if (entries == NULL)
+            for (int i = 0;i < int(extents.size());++i)
+                funcs.push_back(i);
+        if (stream)
+            ast = declaration_list(funcs);
+        else if (pool!=NULL && funcs.size()>1)
+            ast = parallel_function_list(funcs,*pool);
+        else
+            extent_list(extents,funcs,0,int(funcs.size()));
+    }
+    if ( !elements.is_empty() ) // source file could have been empty...
+        ast = ast_function_builder(nodes,elements).build();
+    elements.close_frame();
+    if (stream) {
+        declarations.adopt(nodes);
+        kept = lex.kept();
+    }
+}
+
+void parser::function_list(bool stream)
+{
+    // when streaming, each function is released once it is parsed; this only
+    // happens if the functions cannot be delimited, so an error will be found
+    while (true) {
+        eol();
+        if (lex.endtok()) {
+            if (stream)
+                throw parser_exception("parser::function_list: the pre-parser rejected a program that parsed");
+            return;
+        }
+        else if (lex.curtok().type() == token_fun) {
+            if (stream)
+                streamed_function();
+            else
+                function();
+        }
+        else
+            throw parser_error("line %d: stray %s outside function body", lex.curline(), lex.curtok().to_string().c_str());
+    }
+}
+
+void parser::extent_list(const vector<function_extent>& from,const vector<int>& funcs,int first,int last)
+{
+    // parse the functions 'funcs[first..last)' of those delimited in 'from'
+    for (int i = first;i < last;++i) {
+        lex.seek(from[funcs[i]].start);
+        function();
+    }
+}
+
+ast_function_node* parser::parallel_function_list(const vector<int>& funcs,thread_pool& pool)
+{
+    /* nothing nests across functions, so runs of consecutive functions are
+       parsed by separate parsers into separate subtrees (and arenas); the
+       subtrees are then joined in source order, and the pool reports the
+       error from the earliest run, so errors are reported as they are by a
+       serial parse; the runs hold about equal numbers of tokens */
+    long long total = 0, sum = 0;
+    for (size_t i = 0;i < funcs.size();++i)
+        total += extents[funcs[i]].length;
+    long long n = pool.size() * 4; // oversplit a little to balance the load
+    if (n > (long long)funcs.size())
+        n = funcs.size();
+    vector<int> bounds(1,0);
+    for (int i = 0;i+1 < int(funcs.size());++i) {
+        sum += extents[funcs[i]].length;
+        if (sum*n >= total*(long long)bounds.size())
+            bounds.push_back(i+1);
+    }
+    bounds.push_back(int(funcs.size()));
+    int runs = int(bounds.size()) - 1;
+    vector<ast_function_node*> lists(runs);
+    vector<arena> arenas(runs);
+    pool.run(runs,[&](int i) {
+        parser worker(*this,funcs,bounds[i],bounds[i+1]);
+        lists[i] = static_cast<ast_function_node*>(worker.ast);
+        arenas[i].adopt(worker.nodes);
+    });
+    ast_function_node* head = NULL;
+    for (int i = runs-1;i >= 0;--i) {
+        head = ast_function_builder::join(lists[i],head);
+        nodes.adopt(arenas[i]);
+    }
+    return head;
+}
+
+ast_function_node* parser::declaration_list(const vector<int>& funcs)
+{
+    // streaming: parse just the declaration of each function (as a function
+    // with an empty body); the bodies are parsed by 'next_function'; each one
+    // is built apart, so the element stack holds one declaration at a time
+    ast_function_node* head = NULL, *tail = NULL;
+    for (size_t i = 0;i < funcs.size();++i) {
+        lex.seek(extents[funcs[i]].start);
+        elements.open_frame();
+        elements.add_line(lex.curline());
+        ++lex; // move past 'fun' token
+        try {
+            function_declaration();
+        } catch (parser_error&) {
+            // a syntax error in an earlier body is reported first (as it is
+            // without streaming)
+            streamed.assign(funcs.begin(),funcs.begin()+i);
+            parse_remaining();
+            throw;
+        }
+        elements.add_node(NULL);
+        ast_function_node* node = ast_function_builder(nodes,elements).build();
+        elements.close_frame();
+        if (tail != NULL)
+            ast_function_builder::join(tail,node); // the tail is a single node
+        else
+            head = node;
+        tail = node;
+    }
+    streamed = funcs;
+    return head;
+}
+
+ast_function_node* parser::streamed_function()
+{
+    // parse the function at the current token by itself, after releasing the
+    // function parsed before it
+    nodes.clear();
+    lex.release(kept);
+    elements.open_frame();
+    function();
+    ast_function_node* node = ast_function_builder(nodes,elements).build();
+    elements.close_frame();
+    return node;
+}
+
+bool parser::preparse_function_list(bool calls)
+{
+    // delimit the functions; returns false if they cannot be delimited
+    while (true) {
+        eol();
+        if (lex.endtok())
+            return true;
+        else if (lex.curtok().type()!=token_fun || !preparse_function(calls))
+            return false;
+    }
+}
+
+// classes of tokens for the checks of the pre-parser (see 'preparse_function')
+enum preparse_class
+{
+    preparse_operand = 1, // identifier or literal
+    preparse_operator = 2, // binary or prefix operator
+    preparse_closer = 4, // ')'
+    preparse_end = 8, // ')', ',' or newline
+    preparse_structure = 16 // parenthesis, newline or block keyword
+};
+
+static int get_preparse_class(token_t type)
+{
+    switch (type) {
+    case token_id:
+    case token_number:
+    case token_number_hex:
+    case token_bool_true:
+    case token_bool_false:
+        return preparse_operand;
+    case token_not:
+        return preparse_operator;
+    case token_cparen:
+        return preparse_closer | preparse_end | preparse_structure;
+    case token_comma:
+        return preparse_end;
+    case token_eol:
+        return preparse_end | preparse_structure;
+    case token_oparen:
+    case token_if:
+    case token_elf:
+    case token_else:
+    case token_endif:
+    case token_while:
+    case token_endwhile:
+        return preparse_structure;
+    default:
+        return get_operator_level(type)!=level_none ? preparse_operator : 0;
+    }
+}
+
+bool parser::preparse_function(bool calls)
+{
+    /* skip the function: a body cannot contain a function, so it ends at the
+       first 'endfun'; a call in it is an identifier followed by '(' (noted if
+       'calls' is set); returns false if the function does not end properly or
+       breaks one of these rules, so that the program is parsed in full and the
+       error is reported (a function that is not reached is not parsed, so
+       these are all of its syntax that is checked):
+           the blocks are nested properly and closed
+           the parentheses of each line are balanced
+           an operator is not followed by ')', ',' or a newline
+           an operand is not followed by another, or follows ')' */
+    function_extent f;
+    f.start = lex.mark();
+    f.calls = int(callees.size());
+    f.same = -1;
+    f.reached = false;
+    ++lex; // move past 'fun' token
+    if (lex.curtok().type() != token_id)
+        return false;
+    f.ident = lex.curtok().ident();
+    int callee = -1, depth = 0, last = 0;
+    while (!lex.endtok() && lex.curtok().type()!=token_endfun && lex.curtok().type()!=token_fun) {
+        token tok = lex.curtok();
+        token_t type = tok.type();
+        if (type==token_oparen && callee>=0 && calls)
+            callees.push_back(callee);
+        callee = type==token_id ? tok.ident() : -1;
+        int cls = get_preparse_class(type);
+        if (((last & preparse_operator) && (cls & preparse_end))
+            || ((cls & preparse_operand) && (last & (preparse_operand|preparse_closer))))
+            return false;
+        last = cls;
+        ++lex;
+        if ( !(cls & preparse_structure) )
+            continue;
+        if (type == token_oparen)
+            ++depth;
+        else if (type == token_cparen) {
+            if (--depth < 0)
+                return false;
+        }
+        else if (type == token_eol) {
+            if (depth != 0)
+                return false;
+        }
+        else if (type == token_if)
+            open_pending(pending_if_body);
+        else if (type == token_while)
+            open_pending(pending_while_body);
+        else if (type == token_endwhile) {
+            if (pending.empty() || pending.back().kind!=pending_while_body)
+                return false;
+            pending.pop_back();
+        }
+        else { // 'elf', 'else' or 'endif'
+            if (pending.empty() || pending.back().kind!=pending_if_body)
+                return false;
+            if (type == token_endif)
+                pending.pop_back();
+        }
+    }
+    f.ncalls = int(callees.size()) - f.calls;
+    if (lex.curtok().type()!=token_endfun || !pending.empty())
+        return false;
+    ++lex;
+    f.length = lex.mark().index - f.start.index;
+    if (!eol())
+        return false;
+    extents.push_back(f);
+    return true;
+}
+
+const char* parser::reachable_functions(const vector<const char*>& entries,vector<int>& funcs)
+{
+    // find (in source order) the functions reachable through calls from
+    // the entry points; returns the first entry point that is not a function
+    // (or NULL)
+    const identifier_table& names = lex.identifiers();
+    vector<int> byname(names.size(),-1), work;
+    for (int i = int(extents.size())-1;i >= 0;--i) {
+        extents[i].same = byname[extents[i].ident];
+        byname[extents[i].ident] = i;
+    }
+    for (size_t i = 0;i < entries.size();++i) {
+        int id = names.find(entries[i],int(strlen(entries[i])));
+        if (id < 0 || byname[id] < 0)
+            return entries[i];
+        reach_function(byname[id],work);
+    }
+    while ( !work.empty() ) {
+        const function_extent& f = extents[work.back()];
+        work.pop_back();
+        for (int i = f.calls;i < f.calls+f.ncalls;++i)
+            if (byname[callees[i]] >= 0)
+                reach_function(byname[callees[i]],work);
+    }
+    for (int i = 0;i < int(extents.size());++i)
+        if (extents[i].reached)
+            funcs.push_back(i);
+    return NULL;
+}
+
+void parser::reach_function(int first,vector<int>& work)
+{
+    // mark the functions of a name (beginning with extent 'first') as reached
+    for (int i = first;i >= 0;i = extents[i].same) {
+        if (!extents[i].reached) {
+            extents[i].reached = true;
+            work.push_back(i);
+        }
     }
-    else
-        throw parser_error("line %d: stray %s outside function body", linenumber, lex.curtok().to_string().c_str());
 }
 
 void parser::function()
 {
-    builders.top()->add_line(linenumber);
+    elements.add_line(lex.curline());
+    ++lex; // move past 'fun' token
     function_declaration();
     // parse statement list and add statements to AST
-    ast_statement_builder statementBuilder;
-    builders.push(&statementBuilder);
     statement_list();
-    builders.pop();
-    builders.top()->add_node( statementBuilder.build() );
     if (lex.curtok().type() == token_endfun)
         ++lex;
     else
-        throw parser_error("line %d: expected 'endfun' after function body", linenumber);
+        throw parser_error("line %d: expected 'endfun' after function body", lex.curline());
     if (!eol())
-        throw parser_error("line %d: expected newline after function", linenumber);
+        throw parser_error("line %d: expected newline after function", lex.curline());
 }
 
 void parser::function_declaration()
 {
-    ++lex; // move past 'fun' token
     if (lex.curtok().type() == token_id) {
         // keep the identifier in the AST
-        builders.top()->add_token(&lex.curtok());
+        elements.add_token(lex.keeptok());
         ++lex;
     }
     else
-        throw parser_error("line %d: expected identifier in function declaration", linenumber);
+        throw parser_error("line %d: expected identifier in function declaration", lex.curline());
     if (lex.curtok().type() == token_oparen)
         ++lex;
     else
-        throw parser_error("line %d: expected '(' after function name", linenumber);
+        throw parser_error("line %d: expected '(' after function name", lex.curline());
     // parse the parameter declaration and put it in the AST
-    ast_parameter_builder paramBuilder;
-    builders.push(&paramBuilder);
+    elements.open_frame();
     parameter_declaration();
-    builders.pop();
-    builders.top()->add_node( paramBuilder.build() );
+    build_construct<ast_parameter_builder>();
     if (lex.curtok().type() == token_cparen)
         ++lex;
     else
-        throw parser_error("line %d: expected ')' after function declaration", linenumber);
+        throw parser_error("line %d: expected ')' after function declaration", lex.curline());
     function_type_specifier();
     if (!eol())
-        throw parser_error("line %d: expected newline after function declaration", linenumber);
+        throw parser_error("line %d: expected newline after function declaration", lex.curline());
 }
 
 void parser::function_type_specifier()
@@ -131,12 +549,12 @@ void parser::function_type_specifier()
     }
     else if (lex.curtok().type() == token_eol) {
         // if no specifier is found, then a function defaults to type "in"; place
-        // a NULL pointer in the builder to account for this
-        builders.top()->add_token(NULL);
+        // a null token in the builder to account for this
+        elements.add_token(token());
         return;
     }
     else
-        throw parser_error("line %d: bad function type specifier", linenumber);
+        throw parser_error("line %d: bad function type specifier", lex.curline());
 }
 
 void parser::parameter_declaration()
@@ -150,116 +568,182 @@ void parser::parameter_declaration()
     else if (lex.curtok().type() == token_cparen)
         return;
     else
-        throw parser_error("line %d: bad parameter declaration", linenumber);
+        throw parser_error("line %d: bad parameter declaration", lex.curline());
 }
 
 void parser::parameter()
 {
-    builders.top()->add_line(linenumber);
+    elements.add_line(lex.curline());
     type_name();
     if (lex.curtok().type() == token_id) {
-        builders.top()->add_token(&lex.curtok());
+        elements.add_token(lex.keeptok());
         ++lex;
     }
     else
-        throw parser_error("line %d: missing parameter name", linenumber);
+        throw parser_error("line %d: missing parameter name", lex.curline());
 }
 
 void parser::parameter_list()
 {
-    if (lex.curtok().type() == token_comma)
+    while (lex.curtok().type() == token_comma)
     {
         ++lex;
         parameter();
-        parameter_list();
     }
-    else if (lex.curtok().type() == token_cparen)
+    if (lex.curtok().type() == token_cparen)
         return;
+    // next token is an identifier, user needs comma
+    if (lex.curtok().type() == token_in || lex.curtok().type() == token_big
+        || lex.curtok().type() == token_small || lex.curtok().type() == token_boo)
+        throw parser_error("line %d: expected ',' in parameter list", lex.curline());
+    // next token indicates end of parameters, user needs cparen
+    else if (lex.curtok().type() == token_as || lex.curtok().type() == token_eol)
+        throw parser_error("line %d: expected ')' after parameter list", lex.curline());
     else
-    {
-        // next token is an identifier, user needs comma
-        if (lex.curtok().type() == token_in || lex.curtok().type() == token_big
-            || lex.curtok().type() == token_small || lex.curtok().type() == token_boo)
-            throw parser_error("line %d: expected ',' in parameter list", linenumber);
-        // next token indicates end of parameters, user needs cparen
-        else if (lex.curtok().type() == token_as || lex.curtok().type() == token_eol)
-            throw parser_error("line %d: expected ')' after parameter list", linenumber);
-        else
-            throw parser_error("line %d: unexpected token in parameter list '%s'", linenumber, lex.curtok().to_string().c_str());
-    }
+        throw parser_error("line %d: unexpected token in parameter list '%s'", lex.curline(), lex.curtok().to_string().c_str());
 }
 
 void parser::statement()
 {
+    // parse a statement that does not contain a statement list; if- and
+    // iterative-statements are handled by 'statement_list'
     if (lex.curtok().type() == token_in || lex.curtok().type() == token_big || lex.curtok().type() == token_small
         || lex.curtok().type() == token_boo) {
-        ast_declaration_statement_builder declStatBuilder;
-        builders.push(&declStatBuilder);
-        declStatBuilder.add_line(linenumber);
+        elements.open_frame();
+        elements.add_line(lex.curline());
         declaration_statement();
-        builders.pop();
-        builders.top()->add_node( declStatBuilder.build() );
+        build_construct<ast_declaration_statement_builder>();
     }
     else if (lex.curtok().type() == token_cparen || lex.curtok().type() == token_not
         || lex.curtok().type() == token_id || lex.curtok().type() == token_bool_true
         || lex.curtok().type() == token_bool_false || lex.curtok().type() == token_number
         || lex.curtok().type() == token_number_hex || lex.curtok().type() == token_string
         || lex.curtok().type() == token_oparen) {
-        ast_expression_statement_builder expStatBuilder;
-        builders.push(&expStatBuilder);
-        expStatBuilder.add_line(linenumber);
+        elements.open_frame();
+        elements.add_line(lex.curline());
         expression_statement();
-        builders.pop();
-        builders.top()->add_node( expStatBuilder.build() );
-    }
-    else if (lex.curtok().type() == token_if) {
-        ast_selection_statement_builder selBuilder;
-        builders.push(&selBuilder);
-        selBuilder.add_line(linenumber);
-        selection_statement();
-        builders.pop();
-        builders.top()->add_node( selBuilder.build() );
-    }
-    else if (lex.curtok().type() == token_while) {
-        ast_iterative_statement_builder iterBuilder;
-        builders.push(&iterBuilder);
-        iterBuilder.add_line(linenumber);
-        iterative_statement();
-        builders.pop();
-        builders.top()->add_node( iterBuilder.build() );
+        build_construct<ast_expression_statement_builder>();
     }
     else if (lex.curtok().type() == token_toss || lex.curtok().type() == token_smash) {
-        ast_jump_statement_builder jumpBuilder;
-        builders.push(&jumpBuilder);
-        jumpBuilder.add_line(linenumber);
+        elements.open_frame();
+        elements.add_line(lex.curline());
         jump_statement();
-        builders.pop();
-        builders.top()->add_node( jumpBuilder.build() );
+        build_construct<ast_jump_statement_builder>();
     }
     else
-        throw parser_error("line %d: malformed statement", linenumber);
+        throw parser_error("line %d: malformed statement", lex.curline());
 }
 
 void parser::statement_list()
 {
-    if (lex.curtok().type() == token_in || lex.curtok().type() == token_big ||
-        lex.curtok().type() == token_small || lex.curtok().type() == token_boo ||
-        lex.curtok().type() == token_id || lex.curtok().type() == token_number ||
-        lex.curtok().type() == token_number_hex || lex.curtok().type() == token_bool_true ||
-        lex.curtok().type() == token_bool_false || lex.curtok().type() == token_string ||
-        lex.curtok().type() == token_oparen || lex.curtok().type() == token_if ||
-        lex.curtok().type() == token_while || lex.curtok().type() == token_toss ||
-        lex.curtok().type() == token_smash)
-    {
-        statement();
-        statement_list();
+    // parse the statement list of a function body; the statement lists nested
+    // in it are parsed by the same loop, which keeps the blocks that are open
+    // on the 'pending' stack
+    size_t base = pending.size();
+    elements.open_frame();
+    while (true) {
+        if (lex.curtok().type() == token_if) {
+            elements.open_frame();
+            elements.add_line(lex.curline());
+            selection_statement();
+            open_pending(pending_if_body);
+            elements.open_frame();
+        }
+        else if (lex.curtok().type() == token_while) {
+            elements.open_frame();
+            elements.add_line(lex.curline());
+            iterative_statement();
+            open_pending(pending_while_body);
+            elements.open_frame();
+        }
+        else if (lex.curtok().type() == token_in || lex.curtok().type() == token_big ||
+            lex.curtok().type() == token_small || lex.curtok().type() == token_boo ||
+            lex.curtok().type() == token_id || lex.curtok().type() == token_number ||
+            lex.curtok().type() == token_number_hex || lex.curtok().type() == token_bool_true ||
+            lex.curtok().type() == token_bool_false || lex.curtok().type() == token_string ||
+            lex.curtok().type() == token_oparen || lex.curtok().type() == token_toss ||
+            lex.curtok().type() == token_smash)
+            statement();
+        else if (lex.curtok().type() == token_else || lex.curtok().type() == token_elf ||
+            lex.curtok().type() == token_endif || lex.curtok().type() == token_endfun ||
+            lex.curtok().type() == token_endwhile)
+        {
+            // the innermost statement list ends here
+            build_construct<ast_statement_builder>();
+            if (pending.size() == base)
+                return;
+            block_concluder();
+        }
+        else
+            throw parser_error("line %d: expected end-construct after statement", lex.curline());
     }
-    else if (lex.curtok().type() == token_else || lex.curtok().type() == token_elf ||
-        lex.curtok().type() == token_endif || lex.curtok().type() == token_endfun ||
-        lex.curtok().type() == token_endwhile)
+}
+
+void parser::block_concluder()
+{
+    // the statement list of the innermost open block was added to the frame of
+    // its statement; parse what follows it
+    if (pending.back().kind == pending_while_body) {
+        pending.pop_back();
+        if (lex.curtok().type() == token_endwhile)
+            ++lex;
+        else
+            throw parser_error("line %d: expected 'endwhile'", lex.curline());
+        if (!eol())
+            throw parser_error("line %d: expected newline after 'endwhile'", lex.curline());
+        build_construct<ast_iterative_statement_builder>();
         return;
+    }
+    if (pending.back().kind == pending_else_body) {
+        pending.pop_back();
+        if (lex.curtok().type() == token_endif)
+            ++lex;
+        else
+            throw parser_error("line %d: expected 'endif' after else block", lex.curline());
+        if (!eol())
+            throw parser_error("line %d: expected newline after 'endif'", lex.curline());
+        build_construct<ast_selection_statement_builder>();
+        return;
+    }
+    // an if-body or elf-body ends; build another selection statement node to
+    // handle an elf-clause if it exists
+    elements.open_frame();
+    elements.add_line(lex.curline());
+    if (lex.curtok().type() == token_elf)
+    {
+        ++lex;
+        if (lex.curtok().type() == token_oparen)
+            ++lex;
+        else
+            throw parser_error("line %d: expected '(' after 'elf'", lex.curline());
+        elements.open_frame();
+        elements.add_line(lex.curline());
+        expression();
+        build_construct<ast_expression_builder>();
+        if (lex.curtok().type() == token_cparen)
+            ++lex;
+        else
+            throw parser_error("line %d: expected ')' after elf-statement condition", lex.curline());
+        if (!eol())
+            throw parser_error("line %d: expected newline after elf-statement condition", lex.curline());
+        open_pending(pending_elf_body);
+        elements.open_frame();
+        return;
+    }
+    else if (lex.curtok().type() == token_else || lex.curtok().type() == token_endif) {
+        // no elf-clause follows
+        elements.close_frame();
+        elements.add_node(NULL);
+    }
     else
-        throw parser_error("line %d: expected end-construct after statement", linenumber);
+        throw parser_error("line %d: expected 'elf', 'else' or 'endif' after if-statement body", lex.curline());
+    // every elf-clause of the statement is complete
+    while (pending.back().kind == pending_elf_body) {
+        pending.pop_back();
+        build_construct<ast_elf_builder>();
+    }
+    pending.pop_back(); // the if-body
+    if_concluder();
 }
 
 void parser::declaration_statement()
@@ -267,14 +751,14 @@ void parser::declaration_statement()
     type_name();
     if (lex.curtok().type() == token_id) {
         // keep the identifier in the AST
-        builders.top()->add_token(&lex.curtok());
+        elements.add_token(lex.keeptok());
         ++lex;
     }
     else
-        throw parser_error("line %d: expected identifier in declaration statement", linenumber);
+        throw parser_error("line %d: expected identifier in declaration statement", lex.curline());
     initializer();
     if (!eol())
-        throw parser_error("line %d: newline expected after declaration statement", linenumber);
+        throw parser_error("line %d: newline expected after declaration statement", lex.curline());
 }
 
 void parser::type_name()
@@ -282,11 +766,11 @@ void parser::type_name()
     if (lex.curtok().type()==token_in || lex.curtok().type() == token_big ||
         lex.curtok().type() == token_small || lex.curtok().type()==token_boo) {
         // keep the type name specifier in the AST
-        builders.top()->add_token(&lex.curtok());
+        elements.add_token(lex.keeptok());
         ++lex;
     }
     else
-        throw parser_error("line %d: expected typename specifier", linenumber);
+        throw parser_error("line %d: expected typename specifier", lex.curline());
 }
 
 void parser::initializer()
@@ -295,19 +779,17 @@ void parser::initializer()
     {
         assignment_operator();
         // parse the expression and put it in the AST
-        ast_expression_builder expBuilder;
-        builders.push(&expBuilder);
-        expBuilder.add_line(linenumber);
+        elements.open_frame();
+        elements.add_line(lex.curline());
         expression();
-        builders.pop();
-        builders.top()->add_node( expBuilder.build() );
+        build_construct<ast_expression_builder>();
     }
     else if (lex.curtok().type() == token_eol) {
-        builders.top()->add_node(NULL); // store empty initializer in AST
+        elements.add_node(NULL); // store empty initializer in AST
         return;
     }
     else
-        throw parser_error("line %d: malformed initializer", linenumber);
+        throw parser_error("line %d: malformed initializer", lex.curline());
 }
 
 void parser::assignment_operator()
@@ -316,7 +798,7 @@ void parser::assignment_operator()
     if (lex.curtok().type() == token_assign)
         ++lex;
     else
-        throw parser_error("line %d: expected assignment operator in expression",linenumber);
+        throw parser_error("line %d: expected assignment operator in expression",lex.curline());
     /* note: if we wanted to add compound assignment operators to the grammar, then a new grammar
        rule would have to be created since compound assignment operators would not be usable in
        some contexts where an assignment operator is valid (e.g. declaration initializers) */
@@ -326,375 +808,218 @@ void parser::expression_statement()
 {
     expression_list();
     if (!eol())
-        throw parser_error("line %d: expected newline after expression statement", linenumber);
-}
-
-void parser::expression()
-{
-    if (lex.curtok().type() == token_id || lex.curtok().type() == token_number ||
-        lex.curtok().type() == token_number_hex || lex.curtok().type() == token_bool_true ||
-        lex.curtok().type() == token_bool_false || lex.curtok().type() == token_oparen ||
-        lex.curtok().type() == token_subtract || lex.curtok().type() == token_not)
-        assignment_expression();
-    else
-        throw parser_error("line %d: unexpected token in expression: '%s'", linenumber, lex.curtok().to_string().c_str());
+        throw parser_error("line %d: expected newline after expression statement", lex.curline());
 }
 
 void parser::expression_list()
 {
-    // there should already be an expression builder on the stack
-    // for building the list; this new expression builder builds
-    // a single list item for the expression list
-    ast_expression_builder expBuilder;
-    builders.push(&expBuilder);
-    expBuilder.add_line(linenumber);
-    expression();
-    builders.pop();
-    builders.top()->add_node( expBuilder.build() );
-    expression_list_item();
-}
-
-void parser::expression_list_item()
-{
-    if (lex.curtok().type() == token_comma)
-    {
-        ++lex;
-        expression_list();
+    // there should already be an expression builder frame open for building
+    // the list; each list item is built by an expression builder of its own
+    while (true) {
+        elements.open_frame();
+        elements.add_line(lex.curline());
+        expression();
+        build_construct<ast_expression_builder>();
+        if (lex.curtok().type() == token_comma)
+            ++lex;
+        else if (lex.curtok().type() == token_eol || lex.curtok().type() == token_cparen)
+            return;
+        else
+            throw parser_error("line %d: malformed expression", lex.curline());
     }
-    else if (lex.curtok().type() == token_eol || lex.curtok().type() == token_cparen)
-        return;
-    else
-        throw parser_error("line %d: malformed expression", linenumber);
-}
-
-void parser::assignment_expression()
-{
-    // build assignment expression if it exists
-    ast_assignment_expression_builder assignBuilder;
-    builders.push(&assignBuilder);
-    logical_or_expression();
-    assignment_expression_opt();
-    builders.pop();
-    if (assignBuilder.size() > 1)
-        builders.top()->add_node( assignBuilder.build() );
-    else
-        builders.top()->collapse(assignBuilder);
 }
 
-void parser::assignment_expression_opt()
+void parser::expression()
 {
-    if (lex.curtok().type() == token_assign)
-    {
-        builders.top()->add_line(linenumber);
-        assignment_operator();
-        assignment_expression();
+    // parse an expression with one loop over its operands; the constructs
+    // that are open around the current operand (binary and prefix operators,
+    // parentheses and function call arguments) are kept on 'pending'
+    size_t base = pending.size();
+    while (true) {
+        if ( !prefix_expression() )
+            continue; // a nested expression begins
+        // the operand is complete: fold it into the constructs around it
+        while (true) {
+            while (pending.size() > base && pending.back().kind == pending_prefix) {
+                pending.pop_back();
+                build_construct<ast_prefix_expression_builder>();
+            }
+            if ( operator_expression(base) )
+                break; // an operator takes another operand
+            // the innermost expression is complete; it must end at something that can follow it
+            if (lex.curtok().type() != token_cparen && lex.curtok().type() != token_eol &&
+                lex.curtok().type() != token_comma)
+                throw parser_error("line %d: unexpected token in expression: '%s'", lex.curline(), lex.curtok().to_string().c_str());
+            if (pending.size() == base)
+                return;
+            if (pending.back().kind == pending_parentheses) {
+                int line = pending.back().line;
+                pending.pop_back();
+                build_construct<ast_expression_builder>();
+                if (lex.curtok().type() == token_cparen)
+                    ++lex;
+                else
+                    throw parser_error("line %d: expected ')' in primary expression", lex.curline());
+                if ( !postfix_expression(line) )
+                    break; // the call has arguments
+            }
+            else { // pending_argument
+                pending.pop_back();
+                build_construct<ast_expression_builder>();
+                if (lex.curtok().type() == token_comma) {
+                    ++lex;
+                    elements.open_frame();
+                    elements.add_line(lex.curline());
+                    open_pending(pending_argument);
+                    break;
+                }
+                else if (lex.curtok().type() != token_eol && lex.curtok().type() != token_cparen)
+                    throw parser_error("line %d: malformed expression", lex.curline());
+                // the argument list is complete
+                build_construct<ast_expression_builder>();
+                if (lex.curtok().type() == token_cparen)
+                    ++lex;
+                else
+                    throw parser_error("line %d: expected ')' in function call", lex.curline());
+                build_construct<ast_postfix_expression_builder>();
+            }
+        }
     }
-    else if (lex.curtok().type() == token_cparen || lex.curtok().type() == token_eol ||
-        lex.curtok().type() == token_comma)
-        return;
-    else
-        throw parser_error("line %d: unexpected token in expression: '%s'", linenumber, lex.curtok().to_string().c_str());
 }
 
-void parser::logical_or_expression()
+bool parser::operator_expression(size_t base)
 {
-    // build logical-or expression if it exists
-    ast_logical_or_expression_builder orBuilder;
-    builders.push(&orBuilder);
-    logical_and_expression();
-    logical_or_expression_opt();
-    builders.pop();
-    if (orBuilder.size() > 1)
-        builders.top()->add_node( orBuilder.build() );
-    else
-        builders.top()->collapse(orBuilder);
-}
-
-void parser::logical_or_expression_opt()
-{
-    if (lex.curtok().type() == token_or)
-    {
-        builders.top()->add_line(linenumber);
-        ++lex;
-        logical_and_expression();
-        logical_or_expression_opt();
+    // fold the operand just parsed into the binary operators that are open in
+    // the current expression, then open any operator that follows; returns true
+    // if an operator takes another operand
+    while (true) {
+        operator_level next = get_operator_level(lex.curtok().type());
+        if (pending.size() > base && pending.back().kind == pending_operator) {
+            int level = pending.back().level;
+            if (next > level || (next == level_assignment && level == level_assignment)) {
+                // the next operator binds more tightly (assignment is right-associative)
+                open_operator(next);
+                return true;
+            }
+            if (next == level && is_nary_operator(level)) {
+                operator_operand(level);
+                return true;
+            }
+            // the operand was the operator's last
+            pending.pop_back();
+            build_operator(level);
+            // equality and relational operators do not chain
+            if (next == level)
+                throw parser_error("line %d: unexpected token in expression: '%s'", lex.curline(), lex.curtok().to_string().c_str());
+        }
+        else if (next != level_none) {
+            open_operator(next);
+            return true;
+        }
+        else
+            return false;
     }
-    else if (lex.curtok().type() == token_cparen || lex.curtok().type() == token_eol ||
-        lex.curtok().type() == token_comma || lex.curtok().type() == token_assign)
-        return;
-    else
-        throw parser_error("line %d: unexpected token in expression: '%s'", linenumber, lex.curtok().to_string().c_str());
 }
 
-void parser::logical_and_expression()
+void parser::open_operator(int level)
 {
-    // build logical-and expression if it exists
-    ast_logical_and_expression_builder andBuilder;
-    builders.push(&andBuilder);
-    equality_expression();
-    logical_and_expression_opt();
-    builders.pop();
-    if (andBuilder.size() > 1)
-        builders.top()->add_node( andBuilder.build() );
-    else
-        builders.top()->collapse(andBuilder);
+    // the operand just parsed becomes the first element of the new node
+    elements.adopt_frame();
+    open_pending(pending_operator,level);
+    operator_operand(level);
 }
 
-void parser::logical_and_expression_opt()
+void parser::operator_operand(int level)
 {
-    if (lex.curtok().type() == token_and)
-    {
-        builders.top()->add_line(linenumber);
-        ++lex;
-        equality_expression();
-        logical_and_expression_opt();
-    }
-    else if (lex.curtok().type() == token_cparen || lex.curtok().type() == token_eol ||
-        lex.curtok().type() == token_comma || lex.curtok().type() == token_assign ||
-        lex.curtok().type() == token_or)
-        return;
-    else
-        throw parser_error("line %d: unexpected token in expression: '%s'", linenumber, lex.curtok().to_string().c_str());
-}
-
-void parser::equality_expression()
-{
-    // build equality expression if it exists
-    ast_equality_expression_builder equalBuilder;
-    builders.push(&equalBuilder);
-    relational_expression();
-    equality_expression_opt();
-    builders.pop();
-    if (equalBuilder.size() > 1)
-        builders.top()->add_node( equalBuilder.build() );
-    else
-        builders.top()->collapse(equalBuilder);
+    elements.add_line(lex.curline());
+    if (level >= level_equality) // keep the operator in the AST
+        elements.add_token(lex.keeptok());
+    ++lex;
 }
 
-void parser::equality_expression_opt()
+void parser::build_operator(int level)
 {
-    if (lex.curtok().type()==token_equal || lex.curtok().type()==token_nequal)
-    {
-        builders.top()->add_line(linenumber);
-        // keep equality operator in AST
-        builders.top()->add_token(&lex.curtok());
-        ++lex;
-        relational_expression();
+    switch (level) {
+    case level_assignment:
+        build_construct<ast_assignment_expression_builder>();
+        break;
+    case level_logical_or:
+        build_construct<ast_logical_or_expression_builder>();
+        break;
+    case level_logical_and:
+        build_construct<ast_logical_and_expression_builder>();
+        break;
+    case level_equality:
+        build_construct<ast_equality_expression_builder>();
+        break;
+    case level_relational:
+        build_construct<ast_relational_expression_builder>();
+        break;
+    case level_additive:
+        build_construct<ast_additive_expression_builder>();
+        break;
+    case level_multiplicative:
+        build_construct<ast_multiplicative_expression_builder>();
+        break;
     }
-    else if (lex.curtok().type() == token_cparen || lex.curtok().type() == token_eol ||
-        lex.curtok().type() == token_comma || lex.curtok().type() == token_assign ||
-        lex.curtok().type() == token_or || lex.curtok().type() == token_and)
-        return;
-    else
-        throw parser_error("line %d: unexpected token in expression: '%s'", linenumber, lex.curtok().to_string().c_str());
 }
 
-void parser::relational_expression()
+bool parser::prefix_expression()
 {
-    // build relational expression if it exists
-    ast_relational_expression_builder relationBuilder;
-    builders.push(&relationBuilder);
-    additive_expression();
-    relational_expression_opt();
-    builders.pop();
-    if (relationBuilder.size() > 1)
-        builders.top()->add_node( relationBuilder.build() );
-    else
-        builders.top()->collapse(relationBuilder);
-}
-
-void parser::relational_expression_opt()
-{
-    if (lex.curtok().type() == token_less || lex.curtok().type()==token_greater
-        || lex.curtok().type()==token_le || lex.curtok().type()==token_ge)
+    // parse the prefix operators and the primary expression of an operand;
+    // returns false if a nested expression begins instead (parentheses or
+    // function call arguments)
+    while (lex.curtok().type()==token_subtract || lex.curtok().type()==token_not)
     {
-        builders.top()->add_line(linenumber);
-        // keep relational operator in the AST
-        builders.top()->add_token(&lex.curtok());
+        elements.open_frame();
+        elements.add_token(lex.keeptok());
+        elements.add_line(lex.curline());
         ++lex;
-        additive_expression();
+        open_pending(pending_prefix);
     }
-    else if (lex.curtok().type() == token_cparen || lex.curtok().type() == token_eol ||
-        lex.curtok().type() == token_comma || lex.curtok().type() == token_assign ||
-        lex.curtok().type() == token_or || lex.curtok().type() == token_and ||
-        lex.curtok().type() == token_equal || lex.curtok().type() == token_nequal)
-        return;
-    else
-        throw parser_error("line %d: unexpected token in expression: '%s'", linenumber, lex.curtok().to_string().c_str());
-}
-
-void parser::additive_expression()
-{
-    // build additive expression if it exists
-    ast_additive_expression_builder additiveBuilder;
-    builders.push(&additiveBuilder);
-    multiplicative_expression();
-    additive_expression_opt();
-    builders.pop();
-    if (additiveBuilder.size() > 1)
-        builders.top()->add_node( additiveBuilder.build() );
-    else
-        builders.top()->collapse(additiveBuilder);
-}
-
-void parser::additive_expression_opt()
-{
-    if (lex.curtok().type()==token_add || lex.curtok().type()==token_subtract)
-    {
-        builders.top()->add_line(linenumber);
-        // keep additive operator in the AST
-        builders.top()->add_token(&lex.curtok());
-        ++lex;
-        multiplicative_expression();
-        additive_expression_opt();
-    }
-    else if (lex.curtok().type() == token_cparen || lex.curtok().type() == token_eol ||
-        lex.curtok().type() == token_comma || lex.curtok().type() == token_assign ||
-        lex.curtok().type() == token_or || lex.curtok().type() == token_and ||
-        lex.curtok().type() == token_equal || lex.curtok().type() == token_nequal ||
-        lex.curtok().type() == token_less || lex.curtok().type() == token_greater ||
-        lex.curtok().type() == token_le || lex.curtok().type() == token_ge)
-        return;
-    else
-        throw parser_error("line %d: unexpected token in expression: '%s'", linenumber, lex.curtok().to_string().c_str());
-}
-
-void parser::multiplicative_expression()
-{
-    ast_multiplicative_expression_builder multipBuilder;
-    builders.push(&multipBuilder);
-    prefix_expression();
-    multiplicative_expression_opt();
-    builders.pop();
-    if (multipBuilder.size() > 1)
-        builders.top()->add_node( multipBuilder.build() );
-    else
-        builders.top()->collapse(multipBuilder);
-}
-
-void parser::multiplicative_expression_opt()
-{
-    if (lex.curtok().type()==token_multiply || lex.curtok().type()==token_divide || lex.curtok().type()==token_mod)
-    {
-        builders.top()->add_line(linenumber);
-        // keep multiplicative operator in the AST
-        builders.top()->add_token(&lex.curtok());
-        ++lex;
-        prefix_expression();
-        multiplicative_expression_opt();
-    }
-    else if (lex.curtok().type() == token_cparen || lex.curtok().type() == token_eol ||
-        lex.curtok().type() == token_comma || lex.curtok().type() == token_assign ||
-        lex.curtok().type() == token_or || lex.curtok().type() == token_and ||
-        lex.curtok().type() == token_equal || lex.curtok().type() == token_nequal ||
-        lex.curtok().type() == token_less || lex.curtok().type() == token_greater ||
-        lex.curtok().type() == token_le || lex.curtok().type() == token_ge ||
-        lex.curtok().type() == token_add || lex.curtok().type() == token_subtract)
-        return;
-    else
-        throw parser_error("line %d: unexpected token in expression: '%s'", linenumber, lex.curtok().to_string().c_str());
-}
-
-void parser::prefix_expression()
-{
-    if (lex.curtok().type() == token_id || lex.curtok().type() == token_number ||
-        lex.curtok().type() == token_number_hex || lex.curtok().type() == token_bool_true ||
-        lex.curtok().type() == token_bool_false || lex.curtok().type() == token_oparen)
-        postfix_expression();
-    else if (lex.curtok().type()==token_subtract || lex.curtok().type()==token_not)
+    if (lex.curtok().type() == token_number || lex.curtok().type() == token_number_hex ||
+        lex.curtok().type() == token_bool_true || lex.curtok().type() == token_bool_false ||
+        lex.curtok().type() == token_id)
     {
-        ast_prefix_expression_builder prefixBuilder;
-        prefixBuilder.add_token(&lex.curtok());
-        prefixBuilder.add_line(linenumber);
+        int line = lex.curline();
+        elements.add_token(lex.keeptok());
         ++lex;
-        builders.push(&prefixBuilder);
-        prefix_expression();
-        builders.pop();
-        builders.top()->add_node( prefixBuilder.build() );
+        return postfix_expression(line);
     }
-    else
-        throw parser_error("line %d: unexpected token in expression: '%s'", linenumber, lex.curtok().to_string().c_str());
-}
-
-void parser::postfix_expression()
-{
-    // build a postfix expression if it exists
-    ast_postfix_expression_builder postfixBuilder;
-    builders.push(&postfixBuilder);
-    postfixBuilder.add_line(linenumber);
-    primary_expression();
-    postfix_expression_opt();
-    builders.pop();
-    if (postfixBuilder.size() > 1)
-        builders.top()->add_node( postfixBuilder.build() );
-    else
-        builders.top()->collapse(postfixBuilder);
-}
-
-void parser::postfix_expression_opt()
-{
-    if (lex.curtok().type() == token_oparen)
+    else if (lex.curtok().type() == token_oparen)
     {
+        open_pending(pending_parentheses,0,lex.curline());
         ++lex;
-        function_call();
-        if (lex.curtok().type() == token_cparen)
-            ++lex;
-        else
-            throw parser_error("line %d: expected ')' in function call", linenumber);
-    }
-    else if (lex.curtok().type() == token_cparen || lex.curtok().type() == token_eol ||
-        lex.curtok().type() == token_comma || lex.curtok().type() == token_assign ||
-        lex.curtok().type() == token_or || lex.curtok().type() == token_and ||
-        lex.curtok().type() == token_equal || lex.curtok().type() == token_nequal ||
-        lex.curtok().type() == token_less || lex.curtok().type() == token_greater ||
-        lex.curtok().type() == token_le || lex.curtok().type() == token_ge ||
-        lex.curtok().type() == token_add || lex.curtok().type() == token_subtract ||
-        lex.curtok().type() == token_multiply || lex.curtok().type() == token_divide ||
-        lex.curtok().type() == token_mod)
-        return;
+        elements.open_frame();
+        elements.add_line(lex.curline());
+        return false;
+    }
     else
-        throw parser_error("line %d: unexpected token in expression: '%s'", linenumber, lex.curtok().to_string().c_str());
+        throw parser_error("line %d: unexpected token in expression: '%s'", lex.curline(), lex.curtok().to_string().c_str());
 }
 
-void parser::function_call()
+bool parser::postfix_expression(int line)
 {
+    // build a postfix expression only if the primary expression just parsed
+    // (which began on 'line') is called; returns false if arguments follow
+    if (lex.curtok().type() != token_oparen)
+        return true;
+    elements.adopt_frame();
+    elements.add_line(line);
+    ++lex;
     if (lex.curtok().type() == token_cparen) { // follow set
-        builders.top()->add_node(NULL);
-        return;
-    }
-    ast_expression_builder expBuild;
-    builders.push(&expBuild);
-    expBuild.add_line(linenumber);
-    expression_list();
-    builders.pop();
-    builders.top()->add_node( expBuild.build() );
-}
-
-void parser::primary_expression()
-{
-    if (lex.curtok().type() == token_number || lex.curtok().type() == token_number_hex ||
-        lex.curtok().type() == token_bool_true || lex.curtok().type() == token_bool_false ||
-        lex.curtok().type() == token_id)
-    {
-        builders.top()->add_token(&lex.curtok());
+        elements.add_node(NULL);
         ++lex;
+        build_construct<ast_postfix_expression_builder>();
+        return true;
     }
-    else if (lex.curtok().type() == token_oparen)
-    {
-        ++lex;
-        ast_expression_builder expBuilder;
-        builders.push(&expBuilder);
-        expBuilder.add_line(linenumber);
-        expression();
-        builders.pop();
-        builders.top()->add_node( expBuilder.build() );
-        if (lex.curtok().type() == token_cparen)
-            ++lex;
-        else
-            throw parser_error("line %d: expected ')' in primary expression", linenumber);
-    }
-    else
-        throw parser_error("line %d: expected primary expression", linenumber);
+    // open the argument list and its first argument
+    elements.open_frame();
+    elements.add_line(lex.curline());
+    elements.open_frame();
+    elements.add_line(lex.curline());
+    open_pending(pending_argument);
+    return false;
 }
 
 void parser::selection_statement()
@@ -703,66 +1028,18 @@ void parser::selection_statement()
     if (lex.curtok().type() == token_oparen)
         ++lex;
     else
-        throw parser_error("line %d: '(' must follow 'if'", linenumber);
-    ast_expression_builder expBuilder;
-    builders.push(&expBuilder);
-    expBuilder.add_line(linenumber);
+        throw parser_error("line %d: '(' must follow 'if'", lex.curline());
+    elements.open_frame();
+    elements.add_line(lex.curline());
     expression();
-    builders.pop();
-    builders.top()->add_node( expBuilder.build() );
+    build_construct<ast_expression_builder>();
     if (lex.curtok().type() == token_cparen)
         ++lex;
     else
-        throw parser_error("line %d: expected ')' after if-statement condition", linenumber);
+        throw parser_error("line %d: expected ')' after if-statement condition", lex.curline());
     if (!eol())
-        throw parser_error("line %d: expected newline after if-statement condition", linenumber);
-    if_body();
-    if_concluder();
-}
-
-void parser::if_body()
-{
-    ast_statement_builder statBuilder; // doesn't require line number information
-    builders.push(&statBuilder);
-    statement_list();
-    builders.pop();
-    builders.top()->add_node( statBuilder.build() );
-    // build another selection statement node to handle elf-clause if it exists
-    ast_elf_builder elfBuilder;
-    builders.push(&elfBuilder);
-    elfBuilder.add_line(linenumber);
-    elf_body();
-    builders.pop();
-    builders.top()->add_node(elfBuilder.is_empty() ? NULL : elfBuilder.build());
-}
-
-void parser::elf_body()
-{
-    if (lex.curtok().type() == token_elf)
-    {
-        ++lex;
-        if (lex.curtok().type() == token_oparen)
-            ++lex;
-        else
-            throw parser_error("line %d: expected '(' after 'elf'", linenumber);
-        ast_expression_builder expBuild;
-        builders.push(&expBuild);
-        expBuild.add_line(linenumber);
-        expression();
-        builders.pop();
-        builders.top()->add_node( expBuild.build() );
-        if (lex.curtok().type() == token_cparen)
-            ++lex;
-        else
-            throw parser_error("line %d: expected ')' after elf-statement condition", linenumber);
-        if (!eol())
-            throw parser_error("line %d: expected newline after elf-statement condition", linenumber);
-        if_body();
-    }
-    else if (lex.curtok().type() == token_else || lex.curtok().type() == token_endif)
-        return;
-    else
-        throw parser_error("line %d: expected 'elf', 'else' or 'endif' after if-statement body", linenumber);
+        throw parser_error("line %d: expected newline after if-statement condition", lex.curline());
+    // the if-body and the rest of the statement are parsed by 'statement_list'
 }
 
 void parser::if_concluder()
@@ -771,28 +1048,20 @@ void parser::if_concluder()
     {
         ++lex;
         if (!eol())
-            throw parser_error("line %d: expected newline after 'endif'", linenumber);
-        builders.top()->add_node(NULL); // mark empty else-block
+            throw parser_error("line %d: expected newline after 'endif'", lex.curline());
+        elements.add_node(NULL); // mark empty else-block
+        build_construct<ast_selection_statement_builder>();
     }
     else if (lex.curtok().type() == token_else)
     {
         ++lex;
         if (!eol())
-            throw parser_error("line %d: expected newline after 'else'", linenumber);
-        ast_statement_builder statBuilder;
-        builders.push(&statBuilder);
-        statement_list();
-        builders.pop();
-        builders.top()->add_node( statBuilder.build() );
-        if (lex.curtok().type() == token_endif)
-            ++lex;
-        else
-            throw parser_error("line %d: expected 'endif' after else block", linenumber);
-        if (!eol())
-            throw parser_error("line %d: expected newline after 'endif'", linenumber);
+            throw parser_error("line %d: expected newline after 'else'", lex.curline());
+        open_pending(pending_else_body);
+        elements.open_frame();
     }
     else
-        throw parser_error("line %d: expected 'else' or 'endif'", linenumber);
+        throw parser_error("line %d: expected 'else' or 'endif'", lex.curline());
 }
 
 void parser::iterative_statement()
@@ -801,56 +1070,42 @@ void parser::iterative_statement()
     if (lex.curtok().type() == token_oparen)
         ++lex;
     else
-        throw parser_error("line %d: expected '(' after iterative", linenumber);
-    ast_expression_builder expBuilder;
-    builders.push(&expBuilder);
-    expBuilder.add_line(linenumber);
+        throw parser_error("line %d: expected '(' after iterative", lex.curline());
+    elements.open_frame();
+    elements.add_line(lex.curline());
     expression();
-    builders.pop();
-    builders.top()->add_node( expBuilder.build() );
+    build_construct<ast_expression_builder>();
     if (lex.curtok().type() == token_cparen)
         ++lex;
     else
-        throw parser_error("line %d: expected ')' after iterative condition", linenumber);
-    if (!eol())
-        throw parser_error("line %d: expected newline after iterative condition", linenumber);
-    ast_statement_builder statBuilder;
-    builders.push(&statBuilder);
-    statement_list();
-    builders.pop();
-    builders.top()->add_node( statBuilder.build() );
-    if (lex.curtok().type() == token_endwhile)
-        ++lex;
-    else
-        throw parser_error("line %d: expected 'endwhile'", linenumber);
+        throw parser_error("line %d: expected ')' after iterative condition", lex.curline());
     if (!eol())
-        throw parser_error("line %d: expected newline after 'endwhile'", linenumber);
+        throw parser_error("line %d: expected newline after iterative condition", lex.curline());
+    // the loop body and 'endwhile' are parsed by 'statement_list'
 }
 
 void parser::jump_statement()
 {
     if (lex.curtok().type() == token_toss)
     {
-        builders.top()->add_token(&lex.curtok());
+        elements.add_token(lex.keeptok());
         ++lex;
-        ast_expression_builder expBuilder;
-        builders.push(&expBuilder);
-        expBuilder.add_line(linenumber);
+        elements.open_frame();
+        elements.add_line(lex.curline());
         expression_list();
-        builders.pop();
-        builders.top()->add_node( expBuilder.build() );
+        build_construct<ast_expression_builder>();
         if (!eol())
-            throw parser_error("line %d: expected newline after 'toss'", linenumber);
+            throw parser_error("line %d: expected newline after 'toss'", lex.curline());
     }
     else if (lex.curtok().type() == token_smash)
     {
-        builders.top()->add_token(&lex.curtok());
+        elements.add_token(lex.keeptok());
         ++lex;
         if (!eol())
-            throw parser_error("line %d: expected newline after 'smash'", linenumber);
+            throw parser_error("line %d: expected newline after 'smash'", lex.curline());
     }
     // this shouldn't run since where jump-statement is called
     // we check curtok==token_smash || curtok==token_toss
     else
-        throw parser_error("line %d: malformed jump statement", linenumber);
+        throw parser_error("line %d: malformed jump statement", lex.curline());
 }
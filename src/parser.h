@@ -1,7 +1,7 @@
 /* parser.h - CS355 Compiler Project */
 #ifndef PARSER_H
 #define PARSER_H
-#include <stack>
+#include <vector>
 #include "lexer.h" // gets "ramsey-error.h"
 #include "ast.h"
 
@@ -14,6 +14,12 @@ namespace ramsey
         parser_error(const char* format, ...);
         virtual ~parser_error() throw() {}
     };
+    class entry_error : public compiler_error_generic // an entry point that is not a function (a command-line error)
+    {
+    public:
+        entry_error(const char* format, ...);
+        virtual ~entry_error() throw() {}
+    };
     class parser_exception : public compiler_error_generic // errors used internally
     {
     public:
@@ -24,29 +30,86 @@ namespace ramsey
     class parser
     {
     public:
-        parser(const char* file);
-        ~parser();
+        // 'pool' is used to parallelize stages (if given); 'ondemand' lexes as tokens are consumed;
+        // if 'entries' is given then only the functions reachable from the functions it names are parsed;
+        // if 'stream' is set then only the declarations are parsed (see 'next_function')
+        parser(const char* file,thread_pool* pool = NULL,bool ondemand = false,const std::vector<const char*>* entries = NULL,
+            bool stream = false);
 
         int sloc() const
-        { return linenumber; }
+        { return lex.curline(); }
         const ast_node* get_ast() const
         { return ast; } // if NULL then source file was empty
+        // streaming: the tree holds the functions without their bodies; this parses the
+        // next function whole (last to first) and releases the one parsed before it, so
+        // only one function is held at a time; NULL after the first function
+        const ast_node* next_function();
+        // streaming: parse the functions left to stream (first to last) without keeping
+        // them, so that the first syntax error among them is thrown (see 'next_function')
+        void parse_remaining();
         const lexer& get_lexer() const
         { return lex; }
     private:
-        int linenumber;
+        parser(const parser& whole,const std::vector<int>& funcs,int first,int last); // see 'parallel_function_list'
+
         lexer lex;
 
-        // abstract syntax tree (root node)
+        // abstract syntax tree (root node); all of its nodes are allocated
+        // in (and released with) 'nodes'; in streaming mode they are in
+        // 'declarations' and 'nodes' holds the function being streamed
+        arena nodes;
+        arena declarations;
         ast_node* ast;
 
+        // elements of the builders that are under construction; every
+        // builder keeps its frame on this one stack
+        ast_element_stack elements;
+
+        // constructs that are open while parsing nested statement blocks
+        // and expressions (see 'pending_kind' in parser.cpp); these are kept
+        // here instead of on the call stack so that deep nesting is bounded
+        // only by memory
+        struct pending_construct
+        {
+            unsigned char kind;
+            unsigned char level; // operator level of a binary operator
+            int line;
+        };
+        std::vector<pending_construct> pending;
+
+        // functions delimited by the pre-parser (see 'preparse_function'),
+        // which notes the names that each one calls
+        struct function_extent
+        {
+            lexer::position start; // the 'fun' token
+            int length; // number of tokens (when the stream is scanned whole)
+            int ident; // interned name of the function
+            int calls, ncalls; // names it calls (a range in 'callees')
+            int same; // next function with the same name (or -1)
+            bool reached;
+        };
+        std::vector<function_extent> extents;
+        std::vector<int> callees;
+        std::vector<int> streamed; // functions left to stream (see 'next_function')
+        int kept; // tokens kept by the lexer for the declarations (in streaming mode)
+
         // helper functions for parser
         bool eol();
+        template<typename Builder>
+        void build_construct();
+        void open_pending(int kind,int level = 0,int line = 0);
 
-        // declare recursive-descent functions
-        std::stack<ast_builder*> builders;
-        void program();
-        void function_list();
+        // declare grammar rule functions
+        void program(const std::vector<const char*>* entries,thread_pool* pool,bool stream);
+        void function_list(bool stream = false);
+        void extent_list(const std::vector<function_extent>& from,const std::vector<int>& funcs,int first,int last);
+        ast_function_node* parallel_function_list(const std::vector<int>& funcs,thread_pool& pool);
+        ast_function_node* declaration_list(const std::vector<int>& funcs);
+        ast_function_node* streamed_function();
+        bool preparse_function_list(bool calls);
+        bool preparse_function(bool calls);
+        const char* reachable_functions(const std::vector<const char*>& entries,std::vector<int>& funcs);
+        void reach_function(int first,std::vector<int>& work);
         void function();
         void function_declaration();
         void function_type_specifier();
@@ -55,6 +118,7 @@ namespace ramsey
         void parameter_list();
         void statement();
         void statement_list();
+        void block_concluder();
         void declaration_statement();
         void type_name();
         void initializer();
@@ -62,29 +126,13 @@ namespace ramsey
         void expression_statement();
         void expression();
         void expression_list();
-        void expression_list_item();
-        void assignment_expression();
-        void assignment_expression_opt();
-        void logical_or_expression();
-        void logical_or_expression_opt();
-        void logical_and_expression();
-        void logical_and_expression_opt();
-        void equality_expression();
-        void equality_expression_opt();
-        void relational_expression();
-        void relational_expression_opt();
-        void additive_expression();
-        void additive_expression_opt();
-        void multiplicative_expression();
-        void multiplicative_expression_opt();
-        void prefix_expression();
-        void postfix_expression();
-        void postfix_expression_opt();
-        void function_call();
-        void primary_expression();
+        bool operator_expression(size_t base);
+        void open_operator(int level);
+        void operator_operand(int level);
+        void build_operator(int level);
+        bool prefix_expression();
+        bool postfix_expression(int line);
         void selection_statement();
-        void if_body();
-        void elf_body();
         void if_concluder();
         void iterative_statement();
         void jump_statement();
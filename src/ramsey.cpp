@@ -1,48 +1,320 @@
 /* ramsey.cpp - entry point implementation file for ramsey compiler */
 #include "parser.h" // get ramsey compiler utilities
+#include "flatast.h"
+#include "elfobj.h"
+#include "jit.h"
+#include "bytecode.h"
 #include "gccbuild.h" // get GCC invoking utilities
+#include "threadpool.h"
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
 using namespace std;
 using namespace ramsey;
 
+// the arguments of a function called from the command line: 'files' holds the
+// source file, the function's name and its arguments (integers or 'true' and
+// 'false'); 'error' is the exception thrown for a bad one
+template<typename error>
+static vector<int> call_arguments(const vector<const char*>& files)
+{
+    if (files.size() < 2)
+        throw error("missing function name after the input file");
+    vector<int> args;
+    for (size_t i = 2;i < files.size();++i) {
+        const char* a = files[i];
+        char* end;
+        long value = strtol(a,&end,10);
+        if (strcmp(a,"true")==0 || strcmp(a,"false")==0)
+            value = a[0] == 't';
+        else if (*a=='\0' || *end!='\0')
+            throw error("bad argument '%s' (an integer is required)",a);
+        args.push_back(int(value));
+    }
+    return args;
+}
+
+// print the result of a function called from the command line as its type
+static void print_result(int result,token_t type)
+{
+    if (type == token_boo)
+        cout << ((result & 0xff) != 0 ? "true" : "false") << endl;
+    else if (type == token_small)
+        cout << short(result) << endl;
+    else
+        cout << result << endl;
+}
+
+// compile the program in memory and call a function in it (see call_arguments);
+// only the functions it can reach are compiled, and nothing is built
+static void run_jit(const vector<const char*>& files,int jobs)
+{
+    vector<int> args = call_arguments<jit_error>(files);
+    const char* name = files[1];
+
+    thread_pool pool(jobs);
+    vector<const char*> entries(1,name);
+    parser theParser(files[0],&pool,jobs == 1,&entries);
+    const ast_node* theAst = theParser.get_ast();
+    stable theSymbolTable;
+    theSymbolTable.addScope();
+    if (jobs > 1)
+        theAst->check_semantics(theSymbolTable,pool);
+    else
+        theAst->check_semantics(theSymbolTable);
+
+    // the arguments are converted to the parameter types (as a C caller's would be),
+    // so only their number is checked
+    const identifier_table& names = theParser.get_lexer().identifiers();
+    const symbol* function = theSymbolTable.getSymbol(names.find(name,int(strlen(name))));
+    vector<token_t> kinds(args.size(),token_in);
+    symbol::match_parameters_result match = function->match_parameters(kinds.empty() ? NULL : &kinds[0],int(kinds.size()));
+    if (match == symbol::match_too_few)
+        throw jit_error("too few arguments to function '%s'",name);
+    if (match == symbol::match_too_many)
+        throw jit_error("too many arguments to function '%s'",name);
+    token_t type = function->get_type();
+    theSymbolTable.remScope();
+
+    elf_object theObject;
+    code_generator theCodeGenerator(cout,false,&theObject); // (the code is only encoded)
+    if (jobs > 1)
+        theAst->generate_code(theCodeGenerator,pool);
+    else
+        theAst->generate_code(theCodeGenerator);
+    jit_program theProgram(theObject);
+    print_result(theProgram.call(name,args),type);
+}
+
+// compile a program to bytecode; given entry points, only the functions that
+// they can reach are compiled
+static void compile_bytecode(const char* file,const vector<const char*>& entries,int jobs,bytecode_module& module)
+{
+    thread_pool pool(jobs);
+    parser theParser(file,&pool,jobs == 1,entries.empty() ? NULL : &entries);
+    const ast_node* theAst = theParser.get_ast();
+    if (theAst == NULL)
+        return;
+    flat_ast theFlatAst(theAst);
+    stable theSymbolTable;
+    theSymbolTable.addScope();
+    theFlatAst.check_semantics(theSymbolTable);
+    theSymbolTable.remScope();
+    theFlatAst.generate_bytecode(module);
+}
+
+// compile the program in 'files[0]' to a bytecode file named 'files[1]'
+static void write_bytecode(const vector<const char*>& files,const vector<const char*>& entries,int jobs)
+{
+    if (files.size() < 2)
+        throw bytecode_error("missing output file after the input file");
+    if (files.size() > 2)
+        throw bytecode_error("unexpected argument '%s' (a bytecode file is written from one input file)",files[2]);
+    bytecode_module theModule;
+    compile_bytecode(files[0],entries,jobs,theModule);
+    ofstream output(files[1],ios::out|ios::binary);
+    if (output)
+        theModule.write(output);
+    if (!output.flush())
+        throw bytecode_error("cannot write file '%s'",files[1]);
+}
+
+// interpret a function (see call_arguments); the input is a bytecode file or a
+// source file, of which only the functions the function can reach are compiled
+static void run_bytecode(const vector<const char*>& files,int jobs)
+{
+    vector<int> args = call_arguments<bytecode_error>(files);
+    const char* name = files[1];
+    bytecode_module theModule;
+    ifstream input(files[0],ios::in|ios::binary);
+    if (!input)
+        throw bytecode_error("cannot open file '%s'",files[0]);
+    if (bytecode_module::is_bytecode(input))
+        theModule.read(input);
+    else {
+        input.close();
+        compile_bytecode(files[0],vector<const char*>(1,name),jobs,theModule);
+    }
+
+    bytecode_interpreter theInterpreter(theModule);
+    int result = theInterpreter.call(name,args);
+    print_result(result,theModule.get_function(theModule.find_function(name)).type);
+}
+
 int main(int argc,const char* argv[])
 {
-    if (argc <= 1) {
+    // separate compiler options from the files passed to the gcc builder
+    vector<const char*> files, entries;
+    int jobs = 1;
+    bool flat = false, single = false, stream = false, integrated = false, jit = false, bytecode = false, interpret = false;
+    for (int i = 1;i < argc;++i) {
+        if (strncmp(argv[i],"-j",2) == 0) { // -jN or -j N: number of threads used to compile
+            const char* n = argv[i][2] ? argv[i]+2 : (i+1 < argc ? argv[++i] : "");
+            jobs = atoi(n);
+            if (jobs <= 0) {
+                cerr << argv[0] << ": bad thread count '" << n << "'\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i],"--entry") == 0) { // --entry NAME: only compile the functions reachable from NAME
+            // (the others are only pre-parsed, which checks part of their syntax; see parser::preparse_function)
+            if (++i >= argc) {
+                cerr << argv[0] << ": missing function name after '--entry'\n";
+                return 1;
+            }
+            entries.push_back(argv[i]);
+        }
+        else if (strcmp(argv[i],"--flat-ast") == 0) // run the passes on the flat (data-oriented) AST
+            flat = true;
+        else if (strcmp(argv[i],"--single-pass") == 0) // check and generate each function in one visit
+            single = true;
+        else if (strcmp(argv[i],"--stream") == 0) // hold one function at a time (for inputs too large to hold whole)
+            stream = true;
+        else if (strcmp(argv[i],"--integrated-as") == 0) // encode an object for gcc to link instead of piping it assembly
+            integrated = true;
+        else if (strcmp(argv[i],"--jit") == 0) // --jit FILE NAME [ARG...]: run function NAME in this process
+            jit = true;
+        else if (strcmp(argv[i],"--bytecode") == 0) // --bytecode FILE OUTPUT: compile to a bytecode file
+            bytecode = true;
+        else if (strcmp(argv[i],"--interpret") == 0) // --interpret FILE NAME [ARG...]: interpret function NAME (FILE may be bytecode)
+            interpret = true;
+        else
+            files.push_back(argv[i]);
+    }
+    if (files.empty()) {
         cerr << argv[0] << ": no input files\n";
         return 1;
     }
 
     try {
-        gccbuilder gccBuilder(argc-1,argv+1);
+        if (jit) {
+            run_jit(files,jobs);
+            return 0;
+        }
+        if (bytecode) {
+            write_bytecode(files,entries,jobs);
+            return 0;
+        }
+        if (interpret) {
+            run_bytecode(files,jobs);
+            return 0;
+        }
+
+        gccbuilder gccBuilder(int(files.size()),&files[0],integrated);
+        thread_pool pool(jobs);
+        // given the integrated assembler, the code is encoded into an object
+        // that gcc is started on once it is complete
+        elf_object theObject;
+        elf_object* object = integrated ? &theObject : NULL;
 
-        parser theParser(gccBuilder.ramfile());
+        // lex on demand unless lexing in parallel; given entry points, the
+        // functions that they cannot reach are only pre-parsed
+        parser theParser(gccBuilder.ramfile(),&pool,jobs == 1,entries.empty() ? NULL : &entries,stream);
         const ast_node* theAst = theParser.get_ast();
-        if (theAst != NULL) {
+        if (theAst != NULL && stream) {
+            // the tree only declares the functions: each one is parsed, checked
+            // and generated in turn, so the build must be stopped on an error
+            stable theSymbolTable;
+            theSymbolTable.addScope();
+            try {
+                theAst->declare_functions(theSymbolTable);
+                if (object == NULL)
+                    gccBuilder.execute();
+                code_generator theCodeGenerator(gccBuilder.get_code_stream(),false,object);
+                const ast_node* theFunction;
+                while ((theFunction = theParser.next_function()) != NULL)
+                    theFunction->check_and_generate_function(theSymbolTable,theCodeGenerator);
+            } catch (compiler_error_generic&) {
+                // the other modes report the first syntax error before any other
+                // error, so the bodies not yet streamed (the earlier ones) are
+                // parsed: a syntax error in one replaces this error
+                gccBuilder.abort();
+                theParser.parse_remaining();
+                throw;
+            }
+            theSymbolTable.remScope();
+        }
+        else if (theAst != NULL && flat) {
+            // lower the tree and run both passes on the flat form
+            flat_ast theFlatAst(theAst);
+            stable theSymbolTable;
+            theSymbolTable.addScope();
+            theFlatAst.check_semantics(theSymbolTable);
+            theSymbolTable.remScope();
+
+            if (object == NULL)
+                gccBuilder.execute();
+            code_generator theCodeGenerator(gccBuilder.get_code_stream(),false,object);
+            theFlatAst.generate_code(theCodeGenerator);
+        }
+        else if (theAst != NULL && single) {
+            // code is written to gcc as each function is checked, so the build
+            // must be stopped if a later function has an error
+            stable theSymbolTable;
+            theSymbolTable.addScope();
+            if (object == NULL)
+                gccBuilder.execute();
+            code_generator theCodeGenerator(gccBuilder.get_code_stream(),false,object);
+            try {
+                theAst->check_and_generate(theSymbolTable,theCodeGenerator);
+            } catch (compiler_error_generic&) {
+                gccBuilder.abort();
+                throw;
+            }
+            theSymbolTable.remScope();
+        }
+        else if (theAst != NULL) {
             // check semantics on the abstract syntax tree
+            // (given more than one thread, each function is checked apart)
             stable theSymbolTable;
             theSymbolTable.addScope();
-            theAst->check_semantics(theSymbolTable);
+            if (jobs > 1)
+                theAst->check_semantics(theSymbolTable,pool);
+            else
+                theAst->check_semantics(theSymbolTable);
             theSymbolTable.remScope();
 
             // execute the gcc process
-            gccBuilder.execute();
+            if (object == NULL)
+                gccBuilder.execute();
 
             // generate code from the abstract syntax tree
-            code_generator theCodeGenerator(gccBuilder.get_code_stream());
-            theSymbolTable.addScope();
-            theAst->generate_code(theSymbolTable,theCodeGenerator);
-            theSymbolTable.remScope();
+            code_generator theCodeGenerator(gccBuilder.get_code_stream(),false,object);
+            if (jobs > 1)
+                theAst->generate_code(theCodeGenerator,pool);
+            else
+                theAst->generate_code(theCodeGenerator);
+        }
+        if (theAst!=NULL && object!=NULL) {
+            // write out the object and link it
+            theObject.write(gccBuilder.get_code_stream());
+            gccBuilder.execute();
         }
     } catch (gccbuilder_error& err) {
         cerr << argv[0] << ": error: " << err.what() << endl;
         return 1;
+    } catch (entry_error& err) {
+        cerr << argv[0] << ": error: " << err.what() << endl;
+        return 1;
     } catch (lexer_error& err) {
         cerr << argv[0] << ": syntax error: " << err.what() << endl;
         return 1;
     } catch (parser_error& err) {
         cerr << argv[0] << ": syntax error: " << err.what() << endl;
         return 1;
+    } catch (assembler_error& err) {
+        cerr << argv[0] << ": assembler error: " << err.what() << endl;
+        return 1;
+    } catch (jit_error& err) {
+        cerr << argv[0] << ": error: " << err.what() << endl;
+        return 1;
+    } catch (bytecode_error& err) {
+        cerr << argv[0] << ": error: " << err.what() << endl;
+        return 1;
     } catch (semantic_error& err) {
         cerr << argv[0] << ": semantic error: " << err.what() << endl;
+        return 1;
     }
 }
@@ -1,6 +1,9 @@
 /* semantics.cpp */
 #include "ast.h" // gets stable.h
+#include "flatast.h"
+#include "threadpool.h"
 #include <vector>
+#include <algorithm>
 using namespace std;
 using namespace ramsey;
 
@@ -44,9 +47,7 @@ static const char* semantic_type_name(token_t type)
 // symbol
 symbol::match_parameters_result symbol::match_parameters(const token_t* kinds,int cnt) const
 {
-    if (_argtypes == NULL)
-        _argtypes = get_argtypes_impl();
-    token_t* p = _argtypes; bool b = true;
+    const token_t* p = get_argtypes_impl(); bool b = true;
     for (int i = 0;i < cnt;++i,++p) {
         if (*p == token_invalid)
             return match_too_many;
@@ -59,122 +60,220 @@ symbol::match_parameters_result symbol::match_parameters(const token_t* kinds,in
     return match_too_few;
 }
 
-// ast_node derivations: perform a post-order traversal of sorts; add the symbol
-// immediately so that the object is in scope; perform needed analysis AFTER calling
-// analysis routine for any children
-void ast_function_node::semantics_impl(stable& symtable) const
-{
-    if ( !symtable.add(this) ) // if symbol exists then it must be a function
-        throw semantic_error("redeclaration of function '%s'",_id->source_string());
-    // we want all function to be in scope before analyzing any of their statement bodies
-    if ( !end() )
-        get_next()->semantics_impl(symtable);
-    symtable.addScope(); // scope for function
-    symtable.enterFunction(this); // let the symbol table track the function throughout its lifetime
-    { ast_parameter_node* n = _param;
-        while (n != NULL) {
-            n->check_semantics(symtable);
-            n = n->get_next();
-        }
+// ast_node
+void ast_node::check_semantics(stable& symtable) const
+{
+    semantics_walk(symtable,ast_pass_frame(this));
+}
+void ast_node::check_semantics(stable& symtable,thread_pool& pool) const
+{
+    // a body only looks up the functions, so each thread analyzes bodies with
+    // its own copy of the symbol table once they are declared; the pool rethrows
+    // the error of the earliest task, and the tasks are in the order the serial
+    // pass analyzes the bodies, so the same error is reported
+    vector<const ast_function_node*> funcs;
+    declare_functions(this,symtable,funcs);
+    vector<stable> tables(pool.size(),symtable);
+    pool.run_on_threads(int(funcs.size()),[&](int i,int t) {
+        semantics_walk(tables[t],function_frame(funcs[i]));
+    });
+}
+void ast_node::declare_functions(const ast_node* root,stable& symtable,vector<const ast_function_node*>& funcs)
+{
+    for (const ast_function_node* f = static_cast<const ast_function_node*>(root);f != NULL;f = f->get_next()) {
+        if ( !symtable.add(f) ) // if symbol exists then it must be a function
+            throw semantic_error("redeclaration of function '%s'",f->_id.source_string().c_str());
+        funcs.push_back(f);
     }
-    { ast_statement_node* n = _statements;
-        while (n != NULL) {
-            n->check_semantics(symtable);
-            n = n->get_next();
+    reverse(funcs.begin(),funcs.end());
+}
+ast_pass_frame ast_node::function_frame(const ast_function_node* function)
+{
+    // begin with the function's own step (see ast_function_node::semantics_impl
+    // and codegen_impl), which ends after the function when it is the frame's node
+    ast_pass_frame frame(function);
+    frame.step = 1;
+    frame.current = function;
+    return frame;
+}
+void ast_node::semantics_walk(stable& symtable,const ast_pass_frame& root)
+{
+    // visit the tree with an explicit stack of frames (see ast_pass_frame) so
+    // that the depth of the tree does not bound the native stack
+    vector<ast_pass_frame> frames;
+    frames.push_back(root);
+    do {
+        const ast_node* child = frames.back().node->semantics_impl(symtable,frames.back());
+        if (child != NULL)
+            frames.push_back( ast_pass_frame(child) );
+        else
+            frames.pop_back();
+    } while ( !frames.empty() );
+}
+
+// ast_node derivations: perform a post-order traversal of sorts; add the symbol
+// immediately so that the object is in scope; perform needed analysis AFTER visiting
+// any children
+const ast_node* ast_function_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
+{
+    const ast_function_node* f = static_cast<const ast_function_node*>(frame.current);
+    const ast_node* n;
+    while (true) {
+        switch (frame.step) {
+        case 0:
+            // we want all functions to be in scope before analyzing any of their statement
+            // bodies; the bodies are then analyzed last to first
+            for (f = this;;f = f->get_next()) {
+                if ( !symtable.add(f) ) // if symbol exists then it must be a function
+                    throw semantic_error("redeclaration of function '%s'",f->_id.source_string().c_str());
+                if ( f->end() )
+                    break;
+            }
+            frame.current = f;
+            // fall through
+        case 1:
+            symtable.addScope(); // scope for function
+            symtable.enterFunction(f); // let the symbol table track the function throughout its lifetime
+            frame.cursor = f->_param;
+            frame.step = 2;
+            // fall through
+        case 2:
+            if ((n = frame.next_item<ast_parameter_node>()) != NULL)
+                return n;
+            frame.cursor = f->_statements;
+            frame.step = 3;
+            // fall through
+        case 3:
+            if ((n = frame.next_item<ast_statement_node>()) != NULL)
+                return n;
+            symtable.exitFunction();
+            symtable.remScope();
+            if (f == this)
+                return NULL;
+            // begin the previous function
+            frame.current = f = f->get_prev();
+            frame.step = 1;
+            break;
         }
     }
-    symtable.exitFunction();
-    symtable.remScope();
 }
 
-void ast_parameter_node::semantics_impl(stable& symtable) const
+const ast_node* ast_parameter_node::semantics_impl(stable& symtable,ast_pass_frame&) const
 {
     // add parameter decls to the symbol table
     if ( !symtable.add(this) )
-        throw semantic_error("line %d: parameter name '%s' is already in use",get_lineno(),_id->source_string());
+        throw semantic_error("line %d: parameter name '%s' is already in use",get_lineno(),_id.source_string().c_str());
+    return NULL;
 }
 
-void ast_declaration_statement_node::semantics_impl(stable& symtable) const
+const ast_node* ast_declaration_statement_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
     // do visitor pattern
     if (_initializer != NULL) {
-        _initializer->check_semantics(symtable);
+        if (frame.step++ == 0)
+            return _initializer;
         // check types
-        token_t left = _typespec->type(), right = _initializer->get_type(symtable);
+        token_t left = _typespec.type(), right = _initializer->get_type(symtable);
         if (!semantic_type_equality(left,right) && (right!=token_small || left!=token_big))
             throw semantic_error("line %d: declaration requires initializer of type '%s', not '%s'",get_lineno(),
-                semantic_type_name(_typespec->type()),semantic_type_name(_initializer->get_type(symtable)));
+                semantic_type_name(_typespec.type()),semantic_type_name(_initializer->get_type(symtable)));
     }
     if ( !symtable.add(this) )
-        throw semantic_error("line %d: can't redeclare variable; name '%s' already in use",get_lineno(),_id->source_string());
+        throw semantic_error("line %d: can't redeclare variable; name '%s' already in use",get_lineno(),_id.source_string().c_str());
+    return NULL;
 }
 
-void ast_selection_statement_node::semantics_impl(stable& symtable) const
+const ast_node* ast_selection_statement_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
-    // do visitor pattern
-    _condition->check_semantics(symtable);
-    if (_condition->get_type(symtable) != token_boo) // check type semantics on condition
-        throw semantic_error("line %d: if-statement condition expression must be of type 'boo'",get_lineno());
-    symtable.addScope(); // begin new scope for if-body
-    { ast_statement_node* n = _body;
-        while (n != NULL) {
-            n->check_semantics(symtable);
-            n = n->get_next();
-        }
-    }
-    symtable.remScope(); // end if-body scope
-    if (_elf != NULL)
-        _elf->check_semantics(symtable);
-    symtable.addScope(); // add scope for else-body
-    { ast_statement_node* n = _else;
-        while (n != NULL) {
-            n->check_semantics(symtable);
-            n = n->get_next();
-        }
+    const ast_node* n;
+    switch (frame.step) {
+    case 0:
+        // do visitor pattern
+        frame.step = 1;
+        return _condition;
+    case 1:
+        if (_condition->get_type(symtable) != token_boo) // check type semantics on condition
+            throw semantic_error("line %d: if-statement condition expression must be of type 'boo'",get_lineno());
+        symtable.addScope(); // begin new scope for if-body
+        frame.cursor = _body;
+        frame.step = 2;
+        // fall through
+    case 2:
+        if ((n = frame.next_item<ast_statement_node>()) != NULL)
+            return n;
+        symtable.remScope(); // end if-body scope
+        frame.step = 3;
+        if (_elf != NULL)
+            return _elf;
+        // fall through
+    case 3:
+        symtable.addScope(); // add scope for else-body
+        frame.cursor = _else;
+        frame.step = 4;
+        // fall through
+    case 4:
+        if ((n = frame.next_item<ast_statement_node>()) != NULL)
+            return n;
+        symtable.remScope(); // end else-body scope
     }
-    symtable.remScope(); // end else-body scope
+    return NULL;
 }
 
-void ast_elf_node::semantics_impl(stable& symtable) const
+const ast_node* ast_elf_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
-    // do visitor pattern
-    _condition->check_semantics(symtable);
-    if (_condition->get_type(symtable) != token_boo) // check type semantics on condition
-        throw semantic_error("line %d: elf-statement condition expression must be of type 'boo'",get_lineno());
-    symtable.addScope(); // begin new scope for elf-body
-    { ast_statement_node* n = _body;
-        while (n != NULL) {
-            n->check_semantics(symtable);
-            n = n->get_next();
-        }
+    const ast_node* n;
+    switch (frame.step) {
+    case 0:
+        // do visitor pattern
+        frame.step = 1;
+        return _condition;
+    case 1:
+        if (_condition->get_type(symtable) != token_boo) // check type semantics on condition
+            throw semantic_error("line %d: elf-statement condition expression must be of type 'boo'",get_lineno());
+        symtable.addScope(); // begin new scope for elf-body
+        frame.cursor = _body;
+        frame.step = 2;
+        // fall through
+    case 2:
+        if ((n = frame.next_item<ast_statement_node>()) != NULL)
+            return n;
+        symtable.remScope(); // end scope AFTER elf-body
+        frame.step = 3;
+        return _elf; // (if any)
     }
-    symtable.remScope(); // end scope AFTER elf-body
-    if (_elf != NULL)
-        _elf->check_semantics(symtable);
+    return NULL;
 }
 
-void ast_iterative_statement_node::semantics_impl(stable& symtable) const
+const ast_node* ast_iterative_statement_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
-    // do visitor pattern
-    _condition->check_semantics(symtable);
-    if (_condition->get_type(symtable) != token_boo)
-        throw semantic_error("line %d: iterative-statement condition expression must be of type 'boo'",get_lineno());
-    symtable.addScope(); // add scope for loop-body
-    symtable.enterLoop();
-    { ast_statement_node* n = _body;
-        while (n != NULL) {
-            n->check_semantics(symtable);
-            n = n->get_next();
-        }
+    const ast_node* n;
+    switch (frame.step) {
+    case 0:
+        // do visitor pattern
+        frame.step = 1;
+        return _condition;
+    case 1:
+        if (_condition->get_type(symtable) != token_boo)
+            throw semantic_error("line %d: iterative-statement condition expression must be of type 'boo'",get_lineno());
+        symtable.addScope(); // add scope for loop-body
+        symtable.enterLoop();
+        frame.cursor = _body;
+        frame.step = 2;
+        // fall through
+    case 2:
+        if ((n = frame.next_item<ast_statement_node>()) != NULL)
+            return n;
+        symtable.exitLoop();
+        symtable.remScope(); // end scope after statement body
     }
-    symtable.exitLoop();
-    symtable.remScope(); // end scope after statement body
+    return NULL;
 }
 
-void ast_jump_statement_node::semantics_impl(stable& symtable) const
+const ast_node* ast_jump_statement_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
     if (_expr != NULL) {
-        _expr->check_semantics(symtable);
+        if (frame.step++ == 0)
+            return _expr;
         // check that return statement matches function return type
         token_t funcType, tossType;
         funcType = symtable.getFunction()->get_type();
@@ -184,21 +283,23 @@ void ast_jump_statement_node::semantics_impl(stable& symtable) const
     }
     else if ( !symtable.inLoop() )
         throw semantic_error("line %d: 'smash' statement only allowed in loop body",get_lineno());
+    return NULL;
 }
 
 // expression node derivations
-void ast_assignment_expression_node::semantics_impl(stable& symtable) const
+const ast_node* ast_assignment_expression_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
     token_t left, right;
     // do visitor pattern
-    for (short i = 0;i < 2;++i)
-        _ops[i].node->check_semantics(symtable);
+    if (frame.index < 2)
+        return _ops[frame.index++].node;
     // get types of operands
     left = get_type(symtable); // does some semantic analysis as well
     right = _ops[1].node->get_type(symtable);
     // make sure right hand type is assignable to left hand type
     if (!semantic_type_equality(left,right) && (right!=token_small || left!=token_big))
         throw semantic_error("line %d: cannot assign type '%s' to object of type '%s'",get_lineno(),semantic_type_name(right),semantic_type_name(left));
+    return NULL;
 }
 token_t ast_assignment_expression_node::get_ex_type_impl(const stable& symtable) const
 {
@@ -211,13 +312,14 @@ token_t ast_assignment_expression_node::get_ex_type_impl(const stable& symtable)
     return type;
 }
 
-void ast_logical_or_expression_node::semantics_impl(stable& symtable) const
+const ast_node* ast_logical_or_expression_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
     // do visitor pattern
-    for (auto iter = _ops.begin();iter != _ops.end();++iter)
-        iter->node->check_semantics(symtable);
+    if (frame.index < int(_ops.size()))
+        return _ops[frame.index++].node;
     // semantic analysis
     get_type(symtable);
+    return NULL;
 }
 token_t ast_logical_or_expression_node::get_ex_type_impl(const stable& symtable) const
 {
@@ -229,13 +331,14 @@ token_t ast_logical_or_expression_node::get_ex_type_impl(const stable& symtable)
     return token_boo;
 }
 
-void ast_logical_and_expression_node::semantics_impl(stable& symtable) const
+const ast_node* ast_logical_and_expression_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
     // do visitor pattern
-    for (auto iter = _ops.begin();iter != _ops.end();++iter)
-        iter->node->check_semantics(symtable);
+    if (frame.index < int(_ops.size()))
+        return _ops[frame.index++].node;
     // semantic analysis
     get_type(symtable);
+    return NULL;
 }
 token_t ast_logical_and_expression_node::get_ex_type_impl(const stable& symtable) const
 {
@@ -247,13 +350,14 @@ token_t ast_logical_and_expression_node::get_ex_type_impl(const stable& symtable
     return token_boo;
 }
 
-void ast_equality_expression_node::semantics_impl(stable& symtable) const
+const ast_node* ast_equality_expression_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
     // do visitor pattern
-    for (short i = 0;i < 2;++i)
-        _operands[i].node->check_semantics(symtable);
+    if (frame.index < 2)
+        return _operands[frame.index++].node;
     // semantic analysis
     get_type(symtable);
+    return NULL;
 }
 token_t ast_equality_expression_node::get_ex_type_impl(const stable& symtable) const
 {
@@ -273,13 +377,14 @@ token_t ast_equality_expression_node::get_ex_type_impl(const stable& symtable) c
     return token_boo;
 }
 
-void ast_relational_expression_node::semantics_impl(stable& symtable) const
+const ast_node* ast_relational_expression_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
     // do visitor pattern
-    for (short i = 0;i < 2;++i)
-        _operands[i].node->check_semantics(symtable);
+    if (frame.index < 2)
+        return _operands[frame.index++].node;
     // semantic analysis
     get_type(symtable);
+    return NULL;
 }
 token_t ast_relational_expression_node::get_ex_type_impl(const stable& symtable) const
 {
@@ -299,13 +404,14 @@ token_t ast_relational_expression_node::get_ex_type_impl(const stable& symtable)
     return token_boo;
 }
 
-void ast_additive_expression_node::semantics_impl(stable& symtable) const
+const ast_node* ast_additive_expression_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
     // do visitor pattern
-    for (auto iter = _operands.begin();iter!=_operands.end();++iter)
-        iter->node->check_semantics(symtable);
+    if (frame.index < int(_operands.size()))
+        return _operands[frame.index++].node;
     // 'get_type' does symantic analysis
     get_type(symtable);
+    return NULL;
 }
 token_t ast_additive_expression_node::get_ex_type_impl(const stable& symtable) const
 {
@@ -322,13 +428,14 @@ token_t ast_additive_expression_node::get_ex_type_impl(const stable& symtable) c
     return t;
 }
 
-void ast_multiplicative_expression_node::semantics_impl(stable& symtable) const
+const ast_node* ast_multiplicative_expression_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
     // do visitor pattern
-    for (auto iter = _operands.begin();iter!=_operands.end();++iter)
-        iter->node->check_semantics(symtable);
+    if (frame.index < int(_operands.size()))
+        return _operands[frame.index++].node;
     // 'get_type' does symantic analysis
     get_type(symtable);
+    return NULL;
 }
 token_t ast_multiplicative_expression_node::get_ex_type_impl(const stable& symtable) const
 {
@@ -345,17 +452,19 @@ token_t ast_multiplicative_expression_node::get_ex_type_impl(const stable& symta
     return t;
 }
 
-void ast_prefix_expression_node::semantics_impl(stable& symtable) const
+const ast_node* ast_prefix_expression_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
     token_t t;
     // do visitor pattern
-    _operand.node->check_semantics(symtable);
+    if (frame.step++ == 0)
+        return _operand.node;
     t = _operand.node->get_type(symtable);
-    if (_operator->type()==token_not && t!=token_boo) // operand must be 'boo' type
+    if (_operator.type()==token_not && t!=token_boo) // operand must be 'boo' type
         throw semantic_error("line %d: not-operator requires 'boo' type operand",get_lineno());
-    else if (_operator->type()==token_subtract && t!=token_in && t!=token_small 
+    else if (_operator.type()==token_subtract && t!=token_in && t!=token_small 
         && t!=token_big) // operand must be numeric type
         throw semantic_error("line %d: negate-operator requires numeric type operand",get_lineno());
+    return NULL;
 }
 token_t ast_prefix_expression_node::get_ex_type_impl(const stable& symtable) const
 {
@@ -364,61 +473,351 @@ token_t ast_prefix_expression_node::get_ex_type_impl(const stable& symtable) con
     return _operand.node->get_type(symtable);
 }
 
-void ast_postfix_expression_node::semantics_impl(stable& symtable) const
+const ast_node* ast_postfix_expression_node::semantics_impl(stable& symtable,ast_pass_frame& frame) const
 {
-    // make sure that '_op' is an identifier
-    if (_op.node->get_kind()!=ast_primary_expression || !static_cast<ast_primary_expression_node*>(_op.node)->is_identifier())
-        throw semantic_error("line %d: function name cannot be non-identifier",get_lineno());
+    const ast_primary_expression_node* op = static_cast<ast_primary_expression_node*>(_op.node);
     const symbol* sym;
+    const ast_node* n;
+    if (frame.step == 0) {
+        // make sure that '_op' is an identifier
+        if (_op.node->get_kind()!=ast_primary_expression || !op->is_identifier())
+            throw semantic_error("line %d: function name cannot be non-identifier",get_lineno());
+        // lookup symbol based on '_op' identifier
+        sym = symtable.getSymbol(op->ident());
+        if (sym == NULL)
+            throw semantic_error("line %d: function '%s' is not declared",get_lineno(),op->name().c_str());
+        // make sure that symbol is a function
+        if (sym->get_kind() != symbol::skind_function)
+            throw semantic_error("line %d: '%s' is not a function",get_lineno(),sym->get_name().c_str());
+        op->bind(sym);
+        frame.cursor = _expList;
+        frame.step = 1;
+    }
+    // check each expression in the list
+    if ((n = frame.next_item<ast_expression_node>()) != NULL)
+        return n;
+    // compile an argument type list
     vector<token_t> args;
-    ast_expression_node* p;
-    symbol::match_parameters_result result;
-    // lookup symbol based on '_op' identifier
-    sym = symtable.getSymbol(static_cast<ast_primary_expression_node*>(_op.node)->name());
-    if (sym == NULL)
-        throw semantic_error("line %d: function '%s' is not declared",get_lineno(),static_cast<ast_primary_expression_node*>(_op.node)->name());
-    // make sure that symbol is a function
-    if (sym->get_kind() != symbol::skind_function)
-        throw semantic_error("line %d: '%s' is not a function",get_lineno(),sym->get_name());
-    // go through each expression and compile an argument type list
-    p = _expList;
-    while (p != NULL) {
+    for (const ast_expression_node* p = _expList;p != NULL;p = p->get_next())
         args.push_back(p->get_type(symtable));
-        p = p->get_next();
-    }
     // make sure function argument list is correct
-    result = sym->match_parameters(&args[0],int(args.size()));
+    sym = op->get_symbol();
+    symbol::match_parameters_result result = sym->match_parameters(&args[0],int(args.size()));
     if (result == symbol::match_too_few)
-        throw semantic_error("line %d: too few arguments to function '%s'",get_lineno(),sym->get_name());
+        throw semantic_error("line %d: too few arguments to function '%s'",get_lineno(),sym->get_name().c_str());
     if (result == symbol::match_too_many)
-        throw semantic_error("line %d: too many arguments to function '%s'",get_lineno(),sym->get_name());
+        throw semantic_error("line %d: too many arguments to function '%s'",get_lineno(),sym->get_name().c_str());
     if (result == symbol::match_bad_types)
-        throw semantic_error("line %d: argument type mismatch to function '%s'",get_lineno(),sym->get_name());
+        throw semantic_error("line %d: argument type mismatch to function '%s'",get_lineno(),sym->get_name().c_str());
+    return NULL;
 }
 token_t ast_postfix_expression_node::get_ex_type_impl(const stable& symtable) const
 {
     // the function return type is the overall type for the expression
-    return symtable.getSymbol(static_cast<ast_primary_expression_node*>(_op.node)->name())->get_type();
+    return symtable.getSymbol(static_cast<ast_primary_expression_node*>(_op.node)->ident())->get_type();
 }
 
-void ast_primary_expression_node::semantics_impl(stable& symtable) const
+const ast_node* ast_primary_expression_node::semantics_impl(stable& symtable,ast_pass_frame&) const
 {
     get_type(symtable);
+    return NULL;
 }
 token_t ast_primary_expression_node::get_ex_type_impl(const stable& symtable) const
 {
-    if (_tok->type() == token_id) {
-        const symbol* sym = symtable.getSymbol(_tok->source_string());
+    if (_tok.type() == token_id) {
+        const symbol* sym = symtable.getSymbol(_tok.ident());
         if (sym == NULL)
-            throw semantic_error("line %d: identifier '%s' is undeclared",get_lineno(),_tok->source_string());
+            throw semantic_error("line %d: identifier '%s' is undeclared",get_lineno(),_tok.source_string().c_str());
+        _symbol = sym; // bind the identifier for code generation
         return sym->get_type();
     }
-    if (_tok->type()==token_bool_true || _tok->type()==token_bool_false)
+    if (_tok.type()==token_bool_true || _tok.type()==token_bool_false)
         return token_boo;
-    if (_tok->type() == token_number)
+    if (_tok.type() == token_number)
         return token_in;
 #ifdef RAMSEY_DEBUG
     throw ramsey_exception("ast_primary_expression_node::get_ex_type_impl()");
 #endif
     return token_invalid;
 }
+
+// flat_ast: the same analysis as above, performed on the flat arrays; the
+// expression checks are fused with type evaluation, which the node passes
+// cache on each node
+const flat_ast::flat_symbol* flat_ast::lookup(const stable& symtable,int ident) const
+{
+    // every symbol in the table was added from '_symbols'
+    return static_cast<const flat_symbol*>(symtable.getSymbol(ident));
+}
+void flat_ast::check_semantics(stable& symtable)
+{
+    // we want all functions to be in scope before analyzing any of their statement bodies
+    for (size_t i = 0;i < _functions.size();++i) {
+        const flat_symbol& f = _symbols[_functions[i].symb];
+        if ( !symtable.add(&f) ) // if symbol exists then it must be a function
+            throw semantic_error("redeclaration of function '%s'",f.id.source_string().c_str());
+    }
+    // the bodies are analyzed last to first (in the order the node pass visits them)
+    for (int i = int(_functions.size())-1;i >= 0;--i) {
+        const function_node& fn = _functions[i];
+        symtable.addScope(); // scope for function
+        symtable.enterFunction(&_symbols[fn.symb]);
+        for (int p = fn.params.first;p < fn.params.first+fn.params.count;++p) {
+            if ( !symtable.add(&_symbols[p]) )
+                throw semantic_error("line %d: parameter name '%s' is already in use",_symbols[p].lineno,_symbols[p].id.source_string().c_str());
+        }
+        semantics_statements(symtable,fn.body);
+        symtable.exitFunction();
+        symtable.remScope();
+    }
+}
+flat_ast::walk_frame& flat_ast::open_block(range body,int kind,int stmt)
+{
+    // begin visiting the statements of a block that belongs to statement 'stmt'
+    walk_frame w(stmt);
+    w.step = kind;
+    w.next = body.first;
+    w.last = body.first + body.count;
+    _walk.push_back(w);
+    return _walk.back();
+}
+void flat_ast::semantics_statements(stable& symtable,range body)
+{
+    // the blocks being visited are kept on '_walk' (innermost last); a nested block
+    // is opened in place of recursion and its statement is finished once it ends
+    size_t base = _walk.size();
+    open_block(body,block_function,-1);
+    while (_walk.size() > base) {
+        if (_walk.back().next < _walk.back().last) {
+            int i = _walk.back().next++;
+            const statement_node& s = _statements[i];
+            switch (s.kind) {
+            case ast_statement_node::ast_declaration_statement:
+                {
+                    const flat_symbol& decl = _symbols[s.a];
+                    if (s.b >= 0) {
+                        token_t left = decl.type, right = semantics_expression(symtable,s.b);
+                        if (!semantic_type_equality(left,right) && (right!=token_small || left!=token_big))
+                            throw semantic_error("line %d: declaration requires initializer of type '%s', not '%s'",s.lineno,
+                                semantic_type_name(left),semantic_type_name(right));
+                    }
+                    if ( !symtable.add(&decl) )
+                        throw semantic_error("line %d: can't redeclare variable; name '%s' already in use",s.lineno,decl.id.source_string().c_str());
+                }
+                break;
+            case ast_statement_node::ast_expression_statement:
+                semantics_expression(symtable,s.a);
+                break;
+            case ast_statement_node::ast_selection_statement:
+                if (semantics_expression(symtable,s.a) != token_boo)
+                    throw semantic_error("line %d: if-statement condition expression must be of type 'boo'",s.lineno);
+                symtable.addScope(); // begin new scope for if-body
+                open_block(s.body,block_if,i);
+                break;
+            case ast_statement_node::ast_iterative_statement:
+                if (semantics_expression(symtable,s.a) != token_boo)
+                    throw semantic_error("line %d: iterative-statement condition expression must be of type 'boo'",s.lineno);
+                symtable.addScope(); // add scope for loop-body
+                symtable.enterLoop();
+                open_block(s.body,block_loop,i);
+                break;
+            case ast_statement_node::ast_jump_statement:
+                if (s.a >= 0) {
+                    // check that return statement matches function return type
+                    token_t funcType = symtable.getFunction()->get_type(), tossType = semantics_expression(symtable,s.a);
+                    if (!semantic_type_equality(funcType,tossType) && (tossType!=token_small || funcType!=token_big))
+                        throw semantic_error("line %d: cannot convert '%s' to '%s' in return",s.lineno,semantic_type_name(tossType),semantic_type_name(funcType));
+                }
+                else if ( !symtable.inLoop() )
+                    throw semantic_error("line %d: 'smash' statement only allowed in loop body",s.lineno);
+                break;
+            }
+            continue;
+        }
+        // the block has ended: finish its statement
+        walk_frame w = _walk.back();
+        _walk.pop_back();
+        int elf = -1;
+        switch (w.step) {
+        case block_if:
+            symtable.remScope();
+            elf = _statements[w.node].b;
+            break;
+        case block_elf:
+            symtable.remScope();
+            elf = _statements[w.elf].b;
+            break;
+        case block_else:
+            symtable.remScope();
+            continue;
+        case block_loop:
+            symtable.exitLoop();
+            symtable.remScope();
+            continue;
+        default:
+            continue;
+        }
+        // visit the next elf-clause of the selection statement, or its else-body
+        if (elf >= 0) {
+            const statement_node& e = _statements[elf];
+            if (semantics_expression(symtable,e.a) != token_boo)
+                throw semantic_error("line %d: elf-statement condition expression must be of type 'boo'",e.lineno);
+            symtable.addScope(); // begin new scope for elf-body
+            open_block(e.body,block_elf,w.node).elf = elf;
+        }
+        else {
+            symtable.addScope(); // add scope for else-body
+            open_block(_statements[w.node].other,block_else,w.node);
+        }
+    }
+}
+token_t flat_ast::semantics_expression(stable& symtable,int e)
+{
+    // analyze the expression (operands first) and return its type; the expressions
+    // being visited are kept on '_walk' (see semantics_step)
+    size_t base = _walk.size();
+    walk_frame w(e);
+    while (true) {
+        int operand = semantics_step(symtable,w);
+        if (operand >= 0) {
+            _walk.push_back(w);
+            w = walk_frame(operand);
+        }
+        else if (_walk.size() > base) {
+            w = _walk.back();
+            _walk.pop_back();
+        }
+        else
+            break;
+    }
+    return token_t(_expressions[e].type);
+}
+int flat_ast::semantics_step(stable& symtable,walk_frame& w)
+{
+    // return the next operand of the expression to analyze, or analyze the expression
+    // itself (once its operands are done) and return -1
+    expression_node& x = _expressions[w.node];
+    token_t t = token_invalid;
+    const int first = x.a, last = first + x.b;
+    if (w.step == 0) {
+        w.step = 1;
+        w.next = first;
+        if (x.kind == ast_expression_node::ast_postfix_expression) {
+            // make sure that the callee is an identifier
+            expression_node& callee = _expressions[first];
+            if (callee.kind!=ast_expression_node::ast_primary_expression || callee.op!=token_id)
+                throw semantic_error("line %d: function name cannot be non-identifier",x.lineno);
+            const token& name = _tokens[callee.a];
+            const flat_symbol* sym = lookup(symtable,name.ident());
+            if (sym == NULL)
+                throw semantic_error("line %d: function '%s' is not declared",x.lineno,name.source_string().c_str());
+            if (sym->kind != symbol::skind_function)
+                throw semantic_error("line %d: '%s' is not a function",x.lineno,sym->id.source_string().c_str());
+            callee.b = int(sym - &_symbols[0]);
+            w.next = first+1; // only the arguments are analyzed
+        }
+    }
+    // analyze the operands first (a primary expression has none)
+    if (x.kind!=ast_expression_node::ast_primary_expression && w.next < last)
+        return w.next++;
+    switch (x.kind) {
+    case ast_expression_node::ast_assignment_expression:
+        {
+            token_t right = token_t(_expressions[first+1].type);
+            t = token_t(_expressions[first].type); // type is determined by left operand (assigned-to operand)
+            if (_expressions[first].kind != ast_expression_node::ast_primary_expression)
+                throw semantic_error("line: %d: cannot assign to expression",x.lineno);
+            else if (_expressions[first].op != token_id)
+                throw semantic_error("line %d: cannot assign to non-identifier",x.lineno);
+            if (!semantic_type_equality(t,right) && (right!=token_small || t!=token_big))
+                throw semantic_error("line %d: cannot assign type '%s' to object of type '%s'",x.lineno,semantic_type_name(right),semantic_type_name(t));
+        }
+        break;
+    case ast_expression_node::ast_logical_or_expression:
+    case ast_expression_node::ast_logical_and_expression:
+        for (int i = first;i < last;++i) {
+            if (_expressions[i].type != token_boo)
+                throw semantic_error(x.kind == ast_expression_node::ast_logical_or_expression
+                    ? "line %d: or-operator must have operands of type 'boo'" : "line %d: and-operator must have operands of type 'boo'",x.lineno);
+        }
+        t = token_boo;
+        break;
+    case ast_expression_node::ast_equality_expression:
+    case ast_expression_node::ast_relational_expression:
+        {
+            // note: these operators are defined for numeric types only
+            token_t types[2];
+            for (int i = 0;i < 2;++i) {
+                token_t u = token_t(_expressions[first+i].type);
+                if (u!=token_in && u!=token_small && u!=token_big)
+                    throw semantic_error(x.kind == ast_expression_node::ast_equality_expression
+                        ? "line %d: equality-operator requires numeric type operands" : "line %d: relational-operator requires numeric type operands",x.lineno);
+                types[i] = u;
+            }
+            // since this operator will compare, demand type equality on the two operands
+            if ( !semantic_type_equality(types[0],types[1]) )
+                throw semantic_error(x.kind == ast_expression_node::ast_equality_expression
+                    ? "line %d: equality-operator types of '%s' and '%s' do not match" : "line %d: equality-operator operand types '%s' and '%s' do not match",
+                    x.lineno,semantic_type_name(types[0]),semantic_type_name(types[1]));
+            t = token_boo;
+        }
+        break;
+    case ast_expression_node::ast_additive_expression:
+    case ast_expression_node::ast_multiplicative_expression:
+        for (int i = first;i < last;++i) {
+            token_t curtype = token_t(_expressions[i].type);
+            if (curtype!=token_in && curtype!=token_small && curtype!=token_big)
+                throw semantic_error(x.kind == ast_expression_node::ast_additive_expression
+                    ? "line %d: additive-operator requires numeric type operands" : "line %d: multiplicative-operator requires numeric type operands",x.lineno);
+            // promote small to big as needed; "in" may go both ways (small or big)
+            if (t==token_invalid || curtype==token_big || (t==token_in && curtype==token_small))
+                t = curtype;
+        }
+        break;
+    case ast_expression_node::ast_prefix_expression:
+        t = token_t(_expressions[first].type);
+        if (x.op==token_not && t!=token_boo) // operand must be 'boo' type
+            throw semantic_error("line %d: not-operator requires 'boo' type operand",x.lineno);
+        else if (x.op==token_subtract && t!=token_in && t!=token_small && t!=token_big) // operand must be numeric type
+            throw semantic_error("line %d: negate-operator requires numeric type operand",x.lineno);
+        break;
+    case ast_expression_node::ast_postfix_expression:
+        {
+            const flat_symbol& sym = _symbols[_expressions[first].b];
+            // compile the argument type list
+            _argstack.clear();
+            for (int i = first+1;i < last;++i)
+                _argstack.push_back( token_t(_expressions[i].type) );
+            symbol::match_parameters_result result = sym.match_parameters(_argstack.data(),last-first-1);
+            if (result == symbol::match_too_few)
+                throw semantic_error("line %d: too few arguments to function '%s'",x.lineno,sym.id.source_string().c_str());
+            if (result == symbol::match_too_many)
+                throw semantic_error("line %d: too many arguments to function '%s'",x.lineno,sym.id.source_string().c_str());
+            if (result == symbol::match_bad_types)
+                throw semantic_error("line %d: argument type mismatch to function '%s'",x.lineno,sym.id.source_string().c_str());
+            // the function return type is the overall type for the expression
+            t = sym.type;
+        }
+        break;
+    case ast_expression_node::ast_primary_expression:
+        if (x.op == token_id) {
+            const token& tok = _tokens[x.a];
+            const flat_symbol* sym = lookup(symtable,tok.ident());
+            if (sym == NULL)
+                throw semantic_error("line %d: identifier '%s' is undeclared",x.lineno,tok.source_string().c_str());
+            x.b = int(sym - &_symbols[0]); // bind the identifier for code generation
+            t = sym->type;
+        }
+        else if (x.op==token_bool_true || x.op==token_bool_false)
+            t = token_boo;
+        else if (x.op == token_number)
+            t = token_in;
+#ifdef RAMSEY_DEBUG
+        else
+            throw ramsey_exception("flat_ast::semantics_expression: bad primary expression");
+#endif
+        break;
+    }
+    x.type = (signed char)t;
+    return -1;
+}
@@ -0,0 +1,36 @@
+/* srcmap.h - CS355 Compiler Project */
+#ifndef SRCMAP_H
+#define SRCMAP_H
+#include <cstddef>
+
+namespace ramsey
+{
+    // maps a source file into memory (read-only) for the lifetime of the
+    // object; the lexer scans the mapping directly and tokens refer to
+    // ranges within it, so the mapping must outlive any tokens
+    class source_map
+    {
+    public:
+        source_map() // no mapping
+            : _base(NULL), _size(0), _handle(NULL) {}
+        source_map(const char* file); // throws lexer_error if the file cannot be read
+        ~source_map();
+
+        const char* begin() const
+        { return _base; }
+        const char* end() const
+        { return _base + _size; }
+        std::size_t size() const
+        { return _size; }
+    private:
+        // disallow copying
+        source_map(const source_map&);
+        source_map& operator =(const source_map&);
+
+        const char* _base;
+        std::size_t _size;
+        void* _handle; // platform-specific mapping information
+    };
+}
+
+#endif
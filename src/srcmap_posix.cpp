@@ -0,0 +1,44 @@
+/* srcmap_posix.cpp */
+#include "srcmap.h"
+#include "lexer.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace ramsey;
+
+source_map::source_map(const char* file)
+    : _base(NULL), _size(0), _handle(NULL)
+{
+    int fd;
+    struct stat st;
+    fd = open(file,O_RDONLY);
+    if (fd == -1)
+        throw lexer_error("can't read input file: %s",strerror(errno));
+    if (fstat(fd,&st) == -1) {
+        int err = errno;
+        close(fd);
+        throw lexer_error("can't read input file: %s",strerror(err));
+    }
+    _size = st.st_size;
+    if (_size > 0) { // mmap() rejects zero-length mappings; an empty file simply has no text
+        void* p = mmap(NULL,_size,PROT_READ,MAP_PRIVATE,fd,0);
+        if (p == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            throw lexer_error("can't read input file: %s",strerror(err));
+        }
+        // the lexer scans the file front to back exactly once
+        madvise(p,_size,MADV_SEQUENTIAL);
+        _base = static_cast<const char*>(p);
+    }
+    // the mapping remains valid after the descriptor is closed
+    close(fd);
+}
+source_map::~source_map()
+{
+    if (_base != NULL)
+        munmap(const_cast<char*>(_base),_size);
+}
@@ -0,0 +1,43 @@
+/* srcmap_win32.cpp */
+#include "srcmap.h"
+#include "lexer.h"
+#include <windows.h>
+using namespace ramsey;
+
+source_map::source_map(const char* file)
+    : _base(NULL), _size(0), _handle(NULL)
+{
+    HANDLE hFile, hMapping;
+    LARGE_INTEGER sz;
+    hFile = CreateFileA(file,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        throw lexer_error("can't read input file: error code %d",(int)GetLastError());
+    if ( !GetFileSizeEx(hFile,&sz) ) {
+        CloseHandle(hFile);
+        throw lexer_error("can't read input file: error code %d",(int)GetLastError());
+    }
+    _size = (std::size_t)sz.QuadPart;
+    if (_size > 0) { // CreateFileMapping() rejects zero-length files
+        hMapping = CreateFileMappingA(hFile,NULL,PAGE_READONLY,0,0,NULL);
+        if (hMapping == NULL) {
+            CloseHandle(hFile);
+            throw lexer_error("can't read input file: error code %d",(int)GetLastError());
+        }
+        _base = static_cast<const char*>(MapViewOfFile(hMapping,FILE_MAP_READ,0,0,0));
+        if (_base == NULL) {
+            CloseHandle(hMapping);
+            CloseHandle(hFile);
+            throw lexer_error("can't read input file: error code %d",(int)GetLastError());
+        }
+        _handle = hMapping;
+    }
+    // the view keeps the file open
+    CloseHandle(hFile);
+}
+source_map::~source_map()
+{
+    if (_base != NULL) {
+        UnmapViewOfFile(_base);
+        CloseHandle(static_cast<HANDLE>(_handle));
+    }
+}
@@ -1,19 +1,13 @@
 #include "stable.h"
-#include <cstring>
 using namespace std;
 using namespace ramsey;
 
 // symbol
 
 symbol::symbol()
-    : _argtypes(NULL), _offset(0)
+    : _offset(0)
 {
 }
-symbol::~symbol()
-{
-    if (_argtypes != NULL)
-        delete[] _argtypes;
-}
 // symbol::match_parameters is defined in 'semantics.cpp'
 int symbol::get_offset() const
 {
@@ -34,7 +28,7 @@ void symbol::set_offset(int offset)
 
 bool ramsey::operator ==(const symbol& a,const symbol& b)
 {
-    return strcmp(a.get_name(),b.get_name()) == 0;
+    return a.get_ident() == b.get_ident();
 }
 
 // stable
@@ -46,28 +40,43 @@ stable::stable()
 
 void stable::addScope()
 {
-    table.emplace_back();
+    scopes.push_back(int(undo.size()));
 }
 
 void stable::remScope()
 {
-    table.pop_back();
+    // restore the bindings shadowed by the scope's declarations (in reverse order)
+    int mark = scopes.back();
+    for (int i = int(undo.size());i > mark;--i)
+        table[undo[i-1].ident] = undo[i-1].shadowed;
+    undo.resize(mark);
+    scopes.pop_back();
 }
 
 bool stable::add(const symbol* symb)
 {
-    auto r = table.back().insert( make_pair<string,const symbol*>(symb->get_name(),(const symbol*)symb) );
-    return r.second;
+    int ident = symb->get_ident(), depth = int(scopes.size());
+    if (ident >= int(table.size())) {
+        binding none = { NULL, 0 };
+        table.resize(ident+1,none);
+    }
+    binding& b = table[ident];
+    if (b.symb!=NULL && b.depth==depth) // already declared in this scope
+        return false;
+    undo_record record = { ident, b };
+    undo.push_back(record);
+    b.symb = symb;
+    b.depth = depth;
+    return true;
 }
 
-const symbol* stable::getSymbol(const char* id) const
+const symbol* stable::getSymbol(int ident) const
 {
-    // go through the scopes backwards, since the inner-scope shadows
-    // any other scopes previously declared
-    for (auto it = table.rbegin(); it != table.rend(); it++)
-        if (it->count(id) > 0)
-            return it->at(id);
-    return NULL;
+    // the table holds the innermost binding, since it shadows any other
+    // bindings in the scopes previously declared
+    if (ident<0 || ident>=int(table.size()))
+        return NULL;
+    return table[ident].symb;
 }
 
 void stable::enterFunction(const symbol* symb)
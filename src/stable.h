@@ -1,7 +1,6 @@
 #ifndef STABLE_H
 #define STABLE_H
-#include <unordered_map>
-#include <deque>
+#include <vector>
 #include <string>
 #include "lexer.h" // gets exception and ramsey-error.h
 
@@ -13,7 +12,6 @@ namespace ramsey
     {
     public:
         symbol();
-        ~symbol();
 
         enum skind {
             skind_function,
@@ -29,8 +27,10 @@ namespace ramsey
         };
 
         // basic symbol interface
-        const char* get_name() const
+        std::string get_name() const
         { return get_name_impl(); }
+        int get_ident() const // interned identifier ID of the name
+        { return get_ident_impl(); }
         token_t get_type() const
         { return get_type_impl(); }
         skind get_kind() const
@@ -44,14 +44,14 @@ namespace ramsey
         void set_offset(int);
     private:
         // provide symbol decoration attributes
-        mutable token_t* _argtypes; // function: cache parameter list (allocated on heap); variable: NULL
         int _offset; // variable: offset from base pointer; function: unused
 
         // virtual interface
-        virtual const char* get_name_impl() const = 0;
+        virtual std::string get_name_impl() const = 0;
+        virtual int get_ident_impl() const = 0;
         virtual token_t get_type_impl() const = 0;
         virtual skind get_kind_impl() const = 0;
-        virtual token_t* get_argtypes_impl() const { throw ramsey_exception("unimplemented"); }
+        virtual const token_t* get_argtypes_impl() const { throw ramsey_exception("unimplemented"); } // function: parameter types terminated by token_invalid
     };
 
     bool operator==(const symbol&, const symbol&);
@@ -64,7 +64,7 @@ namespace ramsey
         void addScope();
         void remScope();
         bool add(const symbol* symb);
-        const symbol* getSymbol(const char* id) const; // returns NULL if symbol not found
+        const symbol* getSymbol(int ident) const; // returns NULL if symbol not found
 
         // handle functions
         void enterFunction(const symbol* symb);
@@ -80,7 +80,24 @@ namespace ramsey
         void exitLoop()
         { --loop; }
     private:
-        std::deque<std::unordered_map<std::string,const symbol*> > table;
+        /* the table is flat: 'table' maps each identifier ID to its innermost
+           binding, and every binding records what it shadowed in the undo log;
+           removing a scope pops the scope's undo records, restoring the outer
+           bindings; so lookup is O(1) and scopes cost O(symbols declared) */
+        struct binding
+        {
+            const symbol* symb;
+            int depth; // scope depth of the declaration
+        };
+        struct undo_record
+        {
+            int ident;
+            binding shadowed;
+        };
+
+        std::vector<binding> table; // indexed by interned identifier ID
+        std::vector<undo_record> undo;
+        std::vector<int> scopes; // for each open scope, the size of 'undo' when it was added
 
         const symbol* func;
         int loop;
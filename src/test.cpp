@@ -32,19 +32,17 @@ int main(int argc,const char* argv[])
         ast->check_semantics(symtable);
         symtable.remScope();
         cout << "Passed semantic checks\n\n[Code Generation: Intel x86]\n";
-        symtable.addScope();
-        ast->generate_code(symtable,codegen);
-        symtable.remScope();
+        ast->generate_code(codegen);
     }
-    catch (lexer_error ex) {
+    catch (lexer_error& ex) {
         cerr << argv[0] << ": scan error: " << ex.what() << endl;
         return 1;
     }
-    catch (parser_error ex) {
+    catch (parser_error& ex) {
         cerr << argv[0] << ": syntax error: " << ex.what() << endl;
         return 1;
     }
-    catch (semantic_error ex) {
+    catch (semantic_error& ex) {
         cerr << argv[0] << ": semantic error: " << ex.what() << endl;
         return 1;
     }
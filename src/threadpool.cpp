@@ -0,0 +1,96 @@
+/* threadpool.cpp */
+#include "threadpool.h"
+using namespace std;
+using namespace ramsey;
+
+thread_pool::thread_pool(int nthreads)
+    : _next(0), _task(NULL), _count(0), _pending(0), _active(0), _generation(0), _quit(false)
+{
+    for (int i = 1;i < nthreads;++i)
+        _workers.emplace_back(&thread_pool::_worker,this,i);
+}
+thread_pool::~thread_pool()
+{
+    {
+        lock_guard<mutex> guard(_lock);
+        _quit = true;
+    }
+    _wake.notify_all();
+    for (size_t i = 0;i < _workers.size();++i)
+        _workers[i].join();
+}
+void thread_pool::run(int count,const function<void(int)>& task)
+{
+    run_on_threads(count,[&task](int i,int) { task(i); });
+}
+void thread_pool::run_on_threads(int count,const function<void(int,int)>& task)
+{
+    if (count <= 0)
+        return;
+    {
+        lock_guard<mutex> guard(_lock);
+        _task = &task;
+        _count = count;
+        _pending = count;
+        _next = 0;
+        _errors.assign(count,exception_ptr());
+        ++_generation;
+    }
+    _wake.notify_all();
+    // the calling thread works on the batch too (it is thread 0)
+    _work(0);
+    {
+        // wait for outstanding tasks and for every worker to leave the batch,
+        // then close it; a worker joins a batch only while it is open (under
+        // the lock), so no worker can take an index of the next batch for
+        // this one, or read the next batch's task and count unlocked
+        unique_lock<mutex> guard(_lock);
+        _done.wait(guard,[this]{ return _pending==0 && _active==0; });
+        _task = NULL;
+    }
+    for (int i = 0;i < count;++i)
+        if (_errors[i] != NULL)
+            rethrow_exception(_errors[i]);
+}
+void thread_pool::_worker(int thread)
+{
+    unsigned seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> guard(_lock);
+            _wake.wait(guard,[this,seen]{ return _quit || _generation!=seen; });
+            if (_quit)
+                return;
+            seen = _generation;
+            // a worker that wakes after the batch was completed and closed must
+            // not join it: the next batch may reset the counter while it works
+            if (_task == NULL)
+                continue;
+            ++_active;
+        }
+        _work(thread);
+        {
+            lock_guard<mutex> guard(_lock);
+            --_active;
+        }
+        _done.notify_all();
+    }
+}
+void thread_pool::_work(int thread)
+{
+    int i;
+    while ((i = _next++) < _count) {
+        try {
+            (*_task)(i,thread);
+        } catch (...) {
+            _errors[i] = current_exception();
+        }
+        bool last;
+        {
+            lock_guard<mutex> guard(_lock);
+            last = --_pending == 0;
+        }
+        if (last)
+            _done.notify_all();
+    }
+}
@@ -0,0 +1,55 @@
+/* threadpool.h - CS355 Compiler Project */
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <vector>
+#include <functional>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace ramsey
+{
+    // a fixed set of worker threads that execute batches of indexed tasks;
+    // compilation stages use this to process independent units (source chunks,
+    // functions) in parallel while still combining the results in order
+    class thread_pool
+    {
+    public:
+        thread_pool(int nthreads); // 'nthreads' counts the calling thread (which also runs tasks)
+        ~thread_pool();
+
+        int size() const
+        { return int(_workers.size()) + 1; }
+
+        // run 'task(i)' for each i in [0,count) and wait for all of them to
+        // complete; if any tasks throw, the exception from the task with the
+        // lowest index is rethrown (so errors are reported deterministically)
+        void run(int count,const std::function<void(int)>& task);
+        // the same, but 'task(i,t)' is also given the index 't' (in [0,size())) of the
+        // thread that runs it, so that tasks can work with per-thread state
+        void run_on_threads(int count,const std::function<void(int,int)>& task);
+    private:
+        // disallow copying
+        thread_pool(const thread_pool&);
+        thread_pool& operator =(const thread_pool&);
+
+        void _worker(int thread);
+        void _work(int thread);
+
+        std::vector<std::thread> _workers;
+        std::mutex _lock;
+        std::condition_variable _wake, _done;
+        std::atomic<int> _next; // next task index to hand out
+        const std::function<void(int,int)>* _task; // current batch (guarded by '_lock')
+        int _count;
+        int _pending; // tasks in the batch not yet completed
+        int _active; // workers participating in the batch
+        unsigned _generation; // incremented for each batch
+        bool _quit;
+        std::vector<std::exception_ptr> _errors;
+    };
+}
+
+#endif
@@ -0,0 +1,210 @@
+#!/bin/sh
+# check.sh - regression checks of the ramsey compiler
+#
+#   usage: check.sh RAMSEY
+#
+# RAMSEY is the compiler to check ('make check' runs this on the debug build).
+# Programs are compiled with a stand-in for gcc that only keeps the code it is
+# given, so no 32-bit toolchain is needed: a check passes on the compiler's own
+# exit status and messages, on the code, or on the result of a function run
+# with --jit or --interpret.
+# Each failure is reported, and the script exits 1 if there were any.
+
+if [ $# -ne 1 ]; then
+    echo "usage: $0 RAMSEY" >&2
+    exit 1
+fi
+RAMSEY=$1
+TEST=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+FAILED=0
+PASSED=0
+
+# the stand-in for gcc: it keeps the assembly piped to it ('-') or the object it
+# is to link ('-xnone FILE') as $WORK/code, and succeeds
+mkdir "$WORK/bin"
+cat > "$WORK/bin/gcc" <<EOF
+#!/bin/sh
+while [ \$# -gt 0 ]; do
+    case "\$1" in
+    -) cat > "$WORK/code" ;;
+    -xnone) cp "\$2" "$WORK/code"; shift ;;
+    esac
+    shift
+done
+EOF
+chmod +x "$WORK/bin/gcc"
+: > "$WORK/driver.c"
+
+fail()
+{
+    echo "FAIL: $*"
+    FAILED=$((FAILED+1))
+}
+
+# compile FILE.ram [OPTION...]: the compile succeeds without a message
+compile()
+{
+    file=$1
+    shift
+    if ! PATH="$WORK/bin:$PATH" "$RAMSEY" "$@" "$file" "$WORK/driver.c" < /dev/null > "$WORK/out" 2>&1; then
+        fail "ramsey $* $file: $(head -n 1 "$WORK/out")"
+    elif [ -s "$WORK/out" ]; then
+        fail "ramsey $* $file: unexpected output: $(head -n 1 "$WORK/out")"
+    else
+        PASSED=$((PASSED+1))
+    fi
+}
+
+# fails FILE MESSAGE [OPTION...]: the compile fails with MESSAGE
+fails()
+{
+    file=$1
+    message=$2
+    shift 2
+    if PATH="$WORK/bin:$PATH" "$RAMSEY" "$@" "$file" "$WORK/driver.c" < /dev/null > "$WORK/out" 2>&1; then
+        fail "ramsey $* $file: expected '$message'"
+    elif [ "$(head -n 1 "$WORK/out")" != "$RAMSEY: $message" ]; then
+        fail "ramsey $* $file: expected '$message', got '$(head -n 1 "$WORK/out")'"
+    else
+        PASSED=$((PASSED+1))
+    fi
+}
+
+# same FILE [OPTION...]: the messages and code are the same with any number of threads
+same()
+{
+    file=$1
+    shift
+    for jobs in 1 2 4 8; do
+        rm -f "$WORK/code"
+        PATH="$WORK/bin:$PATH" "$RAMSEY" -j$jobs "$@" "$file" "$WORK/driver.c" < /dev/null > "$WORK/out" 2>&1
+        echo "status $?" >> "$WORK/out"
+        [ -f "$WORK/code" ] && cat "$WORK/code" >> "$WORK/out"
+        if [ $jobs = 1 ]; then
+            mv "$WORK/out" "$WORK/out.1"
+        elif ! cmp -s "$WORK/out" "$WORK/out.1"; then
+            fail "ramsey -j$jobs $* $file: the result differs from -j1's"
+            return
+        fi
+    done
+    PASSED=$((PASSED+1))
+}
+
+# run EXPECTED MODE FILE NAME [ARG...]: MODE (--jit or --interpret) prints EXPECTED
+run()
+{
+    expected=$1
+    shift
+    actual=$("$RAMSEY" "$@" 2>&1)
+    if [ "$actual" != "$expected" ]; then
+        fail "ramsey $*: expected '$expected', got '$actual'"
+    else
+        PASSED=$((PASSED+1))
+    fi
+}
+
+# deep nesting and many functions: the parser and the passes must not recurse on
+# the depth of the input, in any mode
+for kind in if while paren functions; do
+    n=10000
+    [ $kind = functions ] && n=100000
+    file="$WORK/deep-$kind.ram"
+    awk -v kind=$kind -v n=$n -f "$TEST/misc/deep.awk" > "$file"
+    for mode in "" --flat-ast --single-pass --stream -j4 --integrated-as "--entry main"; do
+        compile "$file" $mode
+    done
+    [ $kind = functions ] && n=$((n-1))
+    run $n --jit "$file" main
+    run $n --interpret "$file" main
+done
+
+# threads: every program (or error) comes out the same with any number of
+# threads, several times over for the largest
+for file in "$TEST"/*.ram "$TEST"/*/*.ram "$TEST"/../progs/*.ram; do
+    same "$file"
+    same "$file" --integrated-as
+done
+for i in 1 2 3; do
+    same "$WORK/deep-functions.ram"
+    same "$WORK/deep-functions.ram" --integrated-as
+done
+
+# functions run in process, compiled natively and to bytecode
+for mode in --jit --interpret; do
+    run 1 $mode "$TEST/jit/fib-gcd.ram" fib 1
+    run 6765 $mode "$TEST/jit/fib-gcd.ram" fib 20
+    run 75025 $mode "$TEST/jit/fib-gcd.ram" fib 25
+    run 21 $mode "$TEST/jit/fib-gcd.ram" gcd 1071 462
+    run 36 $mode "$TEST/jit/fib-gcd.ram" lcm 12 18
+    run true $mode "$TEST/jit/fib-gcd.ram" coprime 35 64
+    run false $mode "$TEST/jit/fib-gcd.ram" coprime 12 18
+    run "$RAMSEY: error: too many arguments to function 'fib'" $mode "$TEST/jit/fib-gcd.ram" fib 1 2
+done
+
+# bytecode: a program compiled to a file runs from it
+rbc="$WORK/round-trip.rbc"
+run "" --bytecode "$TEST/bytecode/round-trip.ram" "$rbc"
+run 111 --interpret "$rbc" collatz 27
+run 4 --interpret "$rbc" digits -4096
+run -25535 --interpret "$rbc" wrap 40000
+run 0 --interpret "$rbc" classify -3
+run 1 --interpret "$rbc" classify 0
+run 2 --interpret "$rbc" classify 9
+run true --interpret "$rbc" parity 7
+run 5050 --interpret "$rbc" sum 100
+
+# bytecode: the loader rejects a file that is cut short or corrupt; a module
+# is written as the magic 'RMBC' and the version, then the number of functions
+# and for each one: its name, parameter and return types, registers, code size
+# and code (here one function 'f' of no parameters: ret r0, or broken)
+module()
+{
+    printf "RMBC$1" > "$WORK/module.rbc"
+}
+broken()
+{
+    module "$1"
+    run "$RAMSEY: error: $2" --interpret "$WORK/module.rbc" f
+}
+module '\001\001\001f\000\000\001\002\042\000'
+run 0 --interpret "$WORK/module.rbc" f
+for n in 4 5 64 $(($(wc -c < "$rbc") - 1)); do
+    head -c $n "$rbc" > "$WORK/cut.rbc"
+    run "$RAMSEY: error: bad bytecode file: unexpected end of file" --interpret "$WORK/cut.rbc" sum 3
+done
+broken '\002\001\001f\000\000\001\002\042\000' "bytecode file has an unsupported version"
+broken '\001\377\377\377\377\017' "bad bytecode file: count out of range"
+broken '\001\001\001f\000\000\377\377\377\377\377\001' "bad bytecode file: malformed integer"
+broken '\001\001\001f\000\007\001\002\042\000' "bad bytecode file: bad type in function 'f'"
+broken '\001\001\001f\000\000\001\002\143\000' "bad bytecode file: bad instruction in function 'f'"
+broken '\001\001\001f\000\000\001\002\042\200' "bad bytecode file: unexpected end of file"
+broken '\001\001\001f\000\000\001\002\042\000\000' "bad bytecode file: data after the last function"
+broken '\001\001\001f\001\000\000\000\002\042\000' "bad bytecode file: function 'f' has too few registers"
+broken '\001\001\001f\000\000\001\003\000\000\000' "bad bytecode file: function 'f' does not end with a return or a jump"
+broken '\001\001\001f\000\000\001\002\042\005' "bad bytecode file: operand out of range in function 'f'"
+broken '\001\001\001f\000\000\001\002\022\001' "bad bytecode file: operand out of range in function 'f'"
+
+# errors: every mode reports the first syntax error before any other error,
+# and fails on a semantic error
+redeclared="syntax error: line 5: expected ')' in primary expression"
+order="syntax error: line 7: unexpected token in expression: 'token_multiply'"
+semantic="semantic error: line 8: can't redeclare variable; name 'a' already in use"
+for mode in "" --flat-ast --single-pass --stream -j4 --integrated-as; do
+    fails "$TEST/parse/stream-redeclared.ram" "$redeclared" $mode
+    fails "$TEST/parse/stream-order.ram" "$order" $mode
+    fails "$TEST/semantic/redeclaration.ram" "$semantic" $mode
+done
+
+# entry points: a syntax error in a function that is not reached is still
+# reported (if the pre-parser finds it), and before a bad entry point
+unreached="syntax error: line 5: unexpected token in expression: 'token_eol'"
+for mode in "" -j4 --stream "--entry main" "--stream --entry main" "--entry mian"; do
+    fails "$TEST/parse/unreached.ram" "$unreached" $mode
+done
+fails "$TEST/../progs/gcd.ram" "error: entry point 'mian' is not a function in this program" --entry mian
+compile "$TEST/../progs/gcd.ram" --entry lcm
+
+echo "$PASSED passed, $FAILED failed"
+[ $FAILED -eq 0 ]
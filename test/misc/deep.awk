@@ -0,0 +1,47 @@
+# deep.awk - generator of deeply nested and very long Ramsey programs
+#
+#   usage: awk -v kind=KIND -v n=N -f deep.awk > FILE.ram
+#
+# KIND is one of:
+#     if          N nested if statements      (main tosses N)
+#     while       N nested while loops        (main tosses N)
+#     paren       N nested parentheses        (main tosses N)
+#     functions   N functions f0 .. fN-1      (main tosses f0() + fN-1() = N-1)
+# The nesting is deeper than a recursive parser could take on its stack; these
+# inputs are compiled by check.sh in every mode.
+BEGIN {
+    if (kind == "if") {
+        print "fun main() as in\n    in x <- 0"
+        for (i = 0;i < n;++i)
+            print "if (x >= 0)\nx <- x + 1"
+        for (i = 0;i < n;++i)
+            print "endif"
+        print "    toss x\nendfun"
+    }
+    else if (kind == "while") {
+        print "fun main() as in\n    in x <- 0"
+        for (i = 0;i < n;++i)
+            print "while (x < " n ")\nx <- x + 1"
+        for (i = 0;i < n;++i)
+            print "endwhile"
+        print "    toss x\nendfun"
+    }
+    else if (kind == "paren") {
+        printf "fun main() as in\n    toss "
+        for (i = 0;i < n;++i)
+            printf "("
+        printf "0"
+        for (i = 0;i < n;++i)
+            printf " + 1)"
+        print "\nendfun"
+    }
+    else if (kind == "functions") {
+        for (i = 0;i < n;++i)
+            print "fun f" i "() as in\n    toss " i "\nendfun"
+        print "fun main() as in\n    toss f0() + f" n-1 "()\nendfun"
+    }
+    else {
+        print "deep.awk: unknown kind '" kind "'" > "/dev/stderr"
+        exit 1
+    }
+}
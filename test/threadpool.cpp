@@ -0,0 +1,87 @@
+/* threadpool.cpp - stress check of the thread pool's batches
+
+   usage: check-threadpool [ROUNDS]
+
+   Each round runs a small batch, does some work on the calling thread (as the
+   compiler's stages do between their batches), then runs a larger batch; every
+   task must run exactly once in its batch, on a thread the pool names, and a
+   round that does not finish in time is reported as a hang. */
+#include "threadpool.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+using namespace std;
+using namespace ramsey;
+
+namespace
+{
+    const int THREADS = 4;
+    const int MAX_TASKS = 256;
+    const int TIMEOUT = 60; // seconds without progress that count as a hang
+
+    atomic<int> runs[MAX_TASKS];
+    atomic<long> progress(0);
+    atomic<unsigned> sink(0); // (keeps the work live)
+
+    void spin(int n)
+    {
+        unsigned x = 0;
+        for (int i = 0;i < n;++i)
+            x = x*31 + i;
+        sink += x;
+    }
+
+    // returns the number of tasks that did not run exactly once
+    int batch(thread_pool& pool,int count,int work)
+    {
+        for (int i = 0;i < count;++i)
+            runs[i] = 0;
+        atomic<int> badthread(0);
+        pool.run_on_threads(count,[&](int i,int t) {
+            spin(work * (i%3 + 1));
+            if (t<0 || t>=pool.size())
+                ++badthread;
+            ++runs[i];
+        });
+        int bad = badthread;
+        for (int i = 0;i < count;++i)
+            if (runs[i] != 1) {
+                cerr << "check-threadpool: task " << i << " of " << count << " ran " << runs[i] << " times\n";
+                ++bad;
+            }
+        return bad;
+    }
+
+    void watchdog()
+    {
+        long seen = -1;
+        while (true) {
+            this_thread::sleep_for(chrono::seconds(TIMEOUT));
+            if (progress == seen) {
+                cerr << "check-threadpool: a batch did not complete (hang)\n";
+                abort();
+            }
+            seen = progress;
+        }
+    }
+}
+
+int main(int argc,const char* argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    thread(watchdog).detach();
+    thread_pool pool(THREADS);
+    int bad = 0;
+    for (int r = 0;r < rounds && bad == 0;++r) {
+        bad += batch(pool,1 + r%3,r%7 * 50);
+        spin(r%5 * 20000);
+        bad += batch(pool,16 + r%(MAX_TASKS-16),r%4 * 20);
+        if (r%10 == 0)
+            this_thread::yield();
+        ++progress;
+    }
+    if (bad != 0)
+        return 1;
+    cout << "check-threadpool: " << rounds << " rounds passed\n";
+}